@@ -1,6 +1,27 @@
 #include "APIManager.h"
 #include "../Auth/TokenManager.h"
 #include "../Auth/ProtocolHandler.h"
+#include "../AudioEngine/LoudnessMeter.h"
+
+namespace {
+    var lufsToVar(double lufs) {
+        // Silence measures -inf (LUFS or dBTP), which JSON cannot carry
+        return std::isfinite(lufs) ? var(lufs) : var();
+    }
+    
+    var loudnessToVar(const LoudnessMeter::Result& result) {
+        var analysis(new DynamicObject());
+        analysis.getDynamicObject()->setProperty("integrated_lufs", lufsToVar(result.integratedLufs));
+        analysis.getDynamicObject()->setProperty("loudness_range", result.loudnessRangeLu);
+        analysis.getDynamicObject()->setProperty("max_momentary_lufs", lufsToVar(result.maxMomentaryLufs));
+        analysis.getDynamicObject()->setProperty("max_short_term_lufs", lufsToVar(result.maxShortTermLufs));
+        analysis.getDynamicObject()->setProperty("true_peak_dbtp", lufsToVar(result.truePeakDbtp));
+        analysis.getDynamicObject()->setProperty("target_lufs", APIManager::masteringTargetLufs);
+        analysis.getDynamicObject()->setProperty("deviation_lu", 
+            lufsToVar(result.integratedLufs - APIManager::masteringTargetLufs));
+        return analysis;
+    }
+}
 
 APIManager::APIManager() : authenticated(false) {
     client = std::make_unique<Base44Client>("https://signal-forge-8c2d5f19.base44.app");
@@ -133,25 +154,45 @@ void APIManager::processMastering(const String& projectId, const File& audioFile
         return;
     }
     
-    client->uploadFile(audioFile, [this, projectId, callback](bool success, String fileUrl) {
-        if (!success) {
-            callback(false, var());
-            return;
-        }
+    // Measure first so the service gets the actual loudness with the target
+    checkLoudness(audioFile, [this, projectId, audioFile, callback](bool measured, var analysis) {
+        // An unreadable file is still sent; the service measures it itself
+        ignoreUnused(measured);
         
-        client->requestMastering(projectId, fileUrl, -14, [this, projectId, callback](bool success, var response) {
-            if (success) {
-                PendingOperation op;
-                op.type = "mastering";
-                op.projectId = projectId;
-                op.startTime = Time::getCurrentTime();
-                pendingOperations.add(op);
-                
-                startPolling();
-                callback(true, response);
-            } else {
+        client->uploadFile(audioFile, [this, projectId, analysis, callback](bool success, String fileUrl) {
+            if (!success) {
                 callback(false, var());
+                return;
             }
+            
+            client->requestMastering(projectId, fileUrl, (int) masteringTargetLufs, 
+                                     [this, projectId, callback](bool success, var response) {
+                if (success) {
+                    PendingOperation op;
+                    op.type = "mastering";
+                    op.projectId = projectId;
+                    op.startTime = Time::getCurrentTime();
+                    pendingOperations.add(op);
+                    
+                    startPolling();
+                    callback(true, response);
+                } else {
+                    callback(false, var());
+                }
+            }, analysis);
+        });
+    });
+}
+
+void APIManager::checkLoudness(const File& audioFile, std::function<void(bool, var)> callback) {
+    // Offline analysis runs much faster than real time, but still off the
+    // message thread
+    Thread::launch([audioFile, callback] {
+        LoudnessMeter::Result result;
+        bool success = LoudnessMeter::analyseFile(audioFile, result);
+        
+        MessageManager::callAsync([success, result, callback] {
+            callback(success, success ? loudnessToVar(result) : var());
         });
     });
 }
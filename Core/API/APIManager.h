@@ -26,6 +26,13 @@ public:
                       std::function<void(bool, var)> callback);
     void processMastering(const String& projectId, const File& audioFile, 
                          std::function<void(bool, var)> callback);
+    
+    // Measures loudness locally (no upload); result holds integrated_lufs,
+    // loudness_range, max_momentary_lufs, max_short_term_lufs, true_peak_dbtp,
+    // target_lufs and deviation_lu
+    void checkLoudness(const File& audioFile, std::function<void(bool, var)> callback);
+    
+    static constexpr double masteringTargetLufs = -14.0;
     void processStemSeparation(const String& projectId, const File& audioFile, 
                               std::function<void(bool, var)> callback);
     
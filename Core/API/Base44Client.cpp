@@ -69,14 +69,19 @@ void Base44Client::getMixingResults(const String& projectId, std::function<void(
 }
 
 void Base44Client::requestMastering(const String& projectId, const String& fileUrl, 
-                                   int targetLufs, std::function<void(bool, var)> callback) {
-    var params;
+                                   int targetLufs, std::function<void(bool, var)> callback,
+                                   const var& loudnessAnalysis) {
+    var params(new DynamicObject());
     params.getDynamicObject()->setProperty("project_id", projectId);
     params.getDynamicObject()->setProperty("track_name", "Final Mix");
     params.getDynamicObject()->setProperty("mastering_type", "full_mix");
     params.getDynamicObject()->setProperty("target_lufs", targetLufs);
     params.getDynamicObject()->setProperty("file_url", fileUrl);
     
+    // Locally measured loudness, so the service need not measure it again
+    if (loudnessAnalysis.isObject())
+        params.getDynamicObject()->setProperty("loudness_analysis", loudnessAnalysis);
+    
     makeRequest("/functions/analyzeMastering", "POST", params, callback);
 }
 
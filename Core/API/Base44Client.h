@@ -28,7 +28,8 @@ public:
     void getMixingResults(const String& projectId, std::function<void(bool, var)> callback);
     
     void requestMastering(const String& projectId, const String& fileUrl, 
-                         int targetLufs, std::function<void(bool, var)> callback);
+                         int targetLufs, std::function<void(bool, var)> callback,
+                         const var& loudnessAnalysis = var());
     void getMasteringResults(const String& projectId, std::function<void(bool, var)> callback);
     
     void requestStemSeparation(const String& projectId, const String& fileUrl, 
@@ -0,0 +1,426 @@
+#include "AnticipativeRenderer.h"
+#include "Track.h"
+#include "Panner.h"
+
+//==============================================================================
+class AnticipativeRenderer::Worker : public juce::Thread
+{
+public:
+    Worker(AnticipativeRenderer& r, int blockSize)
+        : juce::Thread("Anticipative render"), renderer(r), scratch(Panner::maxChannels, blockSize)
+    {
+    }
+
+    ~Worker() override
+    {
+        stopThread(4000);
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit())
+            if (!renderer.service(scratch))
+                wait(2);
+    }
+
+private:
+    AnticipativeRenderer& renderer;
+    juce::AudioBuffer<float> scratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Worker)
+};
+
+//==============================================================================
+AnticipativeRenderer::AnticipativeRenderer()
+{
+    publishLaneList();
+}
+
+AnticipativeRenderer::~AnticipativeRenderer()
+{
+    release();
+    currentLaneList = nullptr;
+    releasePool.releaseAll();
+}
+
+void AnticipativeRenderer::prepare(int samplesPerBlock, double sampleRate)
+{
+    release();
+
+    blockSize = samplesPerBlock;
+    currentSampleRate = sampleRate;
+
+    {
+        const juce::ScopedWriteLock sl(lanesLock);
+        for (auto& lane : lanes)
+            allocate(*lane);
+    }
+
+    startWorkers();
+}
+
+void AnticipativeRenderer::release()
+{
+    stopWorkers();
+
+    // No callback is running, so every lane can go straight back to it
+    const juce::ScopedWriteLock sl(lanesLock);
+    for (auto& lane : lanes)
+    {
+        auto owner = lane->owner.load();
+
+        if (owner == Owner::worker || (owner == Owner::handover && lane->handoverTo == Owner::callback))
+        {
+            lane->handoverTo = Owner::callback;
+            completeHandover(*lane);
+        }
+        else if (owner == Owner::handover)
+        {
+            // The workers never got going on it
+            lane->seekPending = false;
+            lane->owner = Owner::callback;
+        }
+    }
+
+    releasePool.collectGarbage();
+}
+
+void AnticipativeRenderer::setEnabled(bool shouldRenderAhead)
+{
+    enabled = shouldRenderAhead;
+}
+
+void AnticipativeRenderer::setLookahead(double seconds)
+{
+    lookaheadSeconds = juce::jlimit(0.01, maxLookaheadSeconds, seconds);
+}
+
+void AnticipativeRenderer::insertTrack(Track& track, int index)
+{
+    auto lane = std::make_unique<Lane>(track);
+
+    if (currentSampleRate > 0.0)
+        allocate(*lane);
+
+    const juce::ScopedWriteLock sl(lanesLock);
+    index = juce::jlimit(0, static_cast<int>(lanes.size()), index);
+    lanes.insert(lanes.begin() + index, std::move(lane));
+    publishLaneList();
+}
+
+void AnticipativeRenderer::removeTrack(int index)
+{
+    std::unique_ptr<Lane> removedLane;
+
+    {
+        // Once the lock is ours no worker is rendering the lane
+        const juce::ScopedWriteLock sl(lanesLock);
+
+        if (index < 0 || index >= static_cast<int>(lanes.size()))
+            return;
+
+        removedLane = std::move(lanes[static_cast<size_t>(index)]);
+        lanes.erase(lanes.begin() + index);
+        publishLaneList();
+    }
+
+    // The callback may be reading it until the new list has been picked up
+    releasePool.retire(std::move(removedLane));
+}
+
+void AnticipativeRenderer::moveTrack(int fromIndex, int toIndex)
+{
+    const juce::ScopedWriteLock sl(lanesLock);
+
+    auto numLanes = static_cast<int>(lanes.size());
+    if (fromIndex < 0 || fromIndex >= numLanes || toIndex < 0 || toIndex >= numLanes || fromIndex == toIndex)
+        return;
+
+    if (fromIndex < toIndex)
+        std::rotate(lanes.begin() + fromIndex, lanes.begin() + fromIndex + 1, lanes.begin() + toIndex + 1);
+    else
+        std::rotate(lanes.begin() + toIndex, lanes.begin() + fromIndex, lanes.begin() + fromIndex + 1);
+
+    publishLaneList();
+}
+
+void AnticipativeRenderer::setPosition(double positionInSeconds)
+{
+    const juce::ScopedReadLock sl(lanesLock);
+
+    for (auto& lane : lanes)
+    {
+        const juce::ScopedLock laneLock(lane->lock);
+        lane->track->setPosition(positionInSeconds);
+
+        // The ring is now of the wrong place; take the lane back and refill
+        auto owner = lane->owner.load();
+        if (owner == Owner::callback)
+            continue;
+
+        if (owner == Owner::worker)
+            beginHandover(*lane, Owner::worker);
+
+        lane->seekPending = true;
+        lane->seekPlayed = lane->played.load();
+    }
+}
+
+void AnticipativeRenderer::acknowledgeHandovers()
+{
+    releasePool.beginAudioBlock();
+
+    for (auto* lane : currentLaneList.load()->lanes)
+    {
+        if (lane->owner.load() == Owner::handover && !lane->callbackIdle.load())
+        {
+            lane->idleSince = lane->played.load();
+            lane->callbackIdle = true;
+        }
+    }
+
+    releasePool.endAudioBlock();
+}
+
+bool AnticipativeRenderer::readBlock(int index, const Track& track, juce::AudioBuffer<float>& dest, int numSamples)
+{
+    releasePool.beginAudioBlock();
+    auto rendered = false;
+
+    if (auto* found = findLane(*currentLaneList.load(), index, track))
+    {
+        auto& lane = *found;
+        auto owner = lane.owner.load();
+
+        if (owner != Owner::callback)
+        {
+            readLane(lane, owner, dest, numSamples);
+            rendered = true;
+        }
+    }
+
+    releasePool.endAudioBlock();
+    return rendered;
+}
+
+void AnticipativeRenderer::readLane(Lane& lane, Owner owner, juce::AudioBuffer<float>& dest, int numSamples)
+{
+    auto played = lane.played.load();
+    auto copied = 0;
+
+    if (owner == Owner::worker)
+    {
+        auto taken = lane.taken.load();
+
+        // Drop whatever arrived too late to be played
+        if (taken < played)
+        {
+            auto stale = static_cast<int>(juce::jmin(static_cast<juce::int64>(lane.fifo.getNumReady()), played - taken));
+            lane.fifo.finishedRead(stale);
+            taken += stale;
+        }
+
+        if (taken == played)
+        {
+            int start1, size1, start2, size2;
+            lane.fifo.prepareToRead(numSamples, start1, size1, start2, size2);
+
+            for (int channel = 0; channel < juce::jmin(lane.numChannels, dest.getNumChannels()); ++channel)
+            {
+                if (size1 > 0)
+                    dest.copyFrom(channel, 0, lane.ring, channel, start1, size1);
+                if (size2 > 0)
+                    dest.copyFrom(channel, size1, lane.ring, channel, start2, size2);
+            }
+
+            copied = size1 + size2;
+            lane.fifo.finishedRead(copied);
+            taken += copied;
+        }
+
+        lane.taken = taken;
+
+        if (copied < numSamples)
+            ++underruns;
+    }
+
+    // Silence for what's missing, and throughout a handover
+    for (int channel = 0; channel < dest.getNumChannels(); ++channel)
+        if (copied < numSamples)
+            dest.clear(channel, copied, numSamples - copied);
+
+    // Let go at the first block of a handover. The silent block is already
+    // counted, so the transport resumes past it.
+    auto letGo = owner == Owner::handover && !lane.callbackIdle.load();
+
+    if (letGo)
+        lane.idleSince = played;
+
+    lane.played = played + numSamples;
+
+    if (letGo)
+        lane.callbackIdle = true;
+}
+
+void AnticipativeRenderer::publishLaneList()
+{
+    auto list = std::make_unique<LaneList>();
+    list->lanes.reserve(lanes.size());
+
+    for (auto& lane : lanes)
+        list->lanes.push_back(lane.get());
+
+    currentLaneList = list.get();
+    releasePool.retire(std::move(ownedLaneList));
+    ownedLaneList = std::move(list);
+}
+
+AnticipativeRenderer::Lane* AnticipativeRenderer::findLane(const LaneList& list, int index, const Track& track)
+{
+    if (index >= 0 && index < static_cast<int>(list.lanes.size())
+        && list.lanes[static_cast<size_t>(index)]->track == &track)
+        return list.lanes[static_cast<size_t>(index)];
+
+    for (auto* lane : list.lanes)
+        if (lane->track == &track)
+            return lane;
+
+    return nullptr;
+}
+
+void AnticipativeRenderer::allocate(Lane& lane)
+{
+    auto capacity = static_cast<int>(std::ceil(maxLookaheadSeconds * currentSampleRate)) + 2 * blockSize;
+
+    lane.numChannels = lane.track->getNumChannels();
+    lane.fifo.setTotalSize(capacity);
+    lane.ring.setSize(lane.numChannels, capacity);
+    lane.ring.clear();
+}
+
+bool AnticipativeRenderer::service(juce::AudioBuffer<float>& scratch)
+{
+    const juce::ScopedReadLock sl(lanesLock);
+    auto didWork = false;
+
+    // Workers share the lanes; one that is busy elsewhere is skipped
+    for (auto& lane : lanes)
+    {
+        const juce::ScopedTryLock laneLock(lane->lock);
+        if (laneLock.isLocked())
+            didWork = serviceLane(*lane, scratch) || didWork;
+    }
+
+    return didWork;
+}
+
+bool AnticipativeRenderer::serviceLane(Lane& lane, juce::AudioBuffer<float>& scratch)
+{
+    auto wanted = enabled.load() && !lane.track->isLive() ? Owner::worker : Owner::callback;
+
+    switch (lane.owner.load())
+    {
+        case Owner::callback:
+            if (wanted == Owner::worker)
+                beginHandover(lane, Owner::worker);
+            return false;
+
+        case Owner::handover:
+            if (!lane.callbackIdle.load())
+                return false;
+
+            completeHandover(lane);
+            return true;
+
+        case Owner::worker:
+            if (wanted == Owner::callback)
+            {
+                beginHandover(lane, Owner::callback);
+                return false;
+            }
+
+            return renderAhead(lane, scratch);
+    }
+
+    return false;
+}
+
+bool AnticipativeRenderer::renderAhead(Lane& lane, juce::AudioBuffer<float>& scratch)
+{
+    auto lookahead = static_cast<juce::int64>(lookaheadSeconds.load() * currentSampleRate);
+    auto written = lane.written.load();
+
+    if (written - lane.played.load() >= lookahead || lane.fifo.getFreeSpace() < blockSize)
+        return false;
+
+    // The worker's scratch fits any layout; the track sees its own
+    juce::AudioBuffer<float> block(scratch.getArrayOfWritePointers(), lane.numChannels, blockSize);
+    block.clear();
+    juce::AudioSourceChannelInfo info(&block, 0, blockSize);
+    lane.track->renderBlock(info);
+
+    int start1, size1, start2, size2;
+    lane.fifo.prepareToWrite(blockSize, start1, size1, start2, size2);
+
+    for (int channel = 0; channel < lane.numChannels; ++channel)
+    {
+        if (size1 > 0)
+            lane.ring.copyFrom(channel, start1, block, channel, 0, size1);
+        if (size2 > 0)
+            lane.ring.copyFrom(channel, start2, block, channel, size1, size2);
+    }
+
+    lane.fifo.finishedWrite(size1 + size2);
+    lane.written = written + size1 + size2;
+    return true;
+}
+
+void AnticipativeRenderer::beginHandover(Lane& lane, Owner to)
+{
+    lane.handoverTo = to;
+    lane.seekPending = false;
+    lane.callbackIdle = false;
+    lane.owner = Owner::handover;
+}
+
+void AnticipativeRenderer::completeHandover(Lane& lane)
+{
+    // The callback has let go and only counts time now, so the track's
+    // transport can be put where the playhead has got to
+    auto now = lane.played.load();
+    auto position = lane.track->getNextReadPosition();
+
+    if (lane.seekPending)
+        position += now - lane.seekPlayed;
+    else if (lane.handoverTo == Owner::callback)
+        position -= lane.written.load() - now;    // rendered ahead but not heard
+    else
+        position += now - lane.idleSince;         // silent while handing over
+
+    lane.track->setNextReadPosition(juce::jmax(static_cast<juce::int64>(0), position));
+    lane.seekPending = false;
+
+    lane.fifo.reset();
+    lane.taken = now;
+    lane.written = now;
+    lane.owner = lane.handoverTo;
+}
+
+void AnticipativeRenderer::startWorkers()
+{
+    auto numWorkers = juce::jlimit(1, 4, juce::SystemStats::getNumCpus() - 1);
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, blockSize));
+        workers.back()->startThread(juce::Thread::Priority::high);
+    }
+}
+
+void AnticipativeRenderer::stopWorkers()
+{
+    for (auto& worker : workers)
+        worker->signalThreadShouldExit();
+
+    workers.clear();
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include "DeferredReleasePool.h"
+
+class Track;
+
+// Renders tracks ahead of the playhead on worker threads.
+//
+// Tracks that are neither record-armed nor monitoring don't need to be
+// computed when the device asks for them. Workers run such tracks' sources,
+// effects and plugins up to the lookahead ahead of the playhead into a ring
+// buffer per track, and the audio callback only copies out what is ready.
+// The device buffer can then stay small for the live tracks however heavy
+// the rest of the session is. The price is that changes to those tracks'
+// effects are heard one lookahead late.
+//
+// Each track has one lane, parallel to the mixer's track list. The audio
+// thread sees the lanes through an immutable list that is replaced on every
+// insert, remove or move, and removed lanes are retired through a release
+// pool, so it never walks the vector the message thread edits. A lane is
+// owned either by the callback (the track is processed live) or by the
+// workers. Ownership changes through a handover state in which the callback
+// outputs silence for that track until the other side has let go, so a track
+// is never processed on two threads at once; arming a track mid-playback
+// costs it a few milliseconds of silence.
+class AnticipativeRenderer
+{
+public:
+    AnticipativeRenderer();
+    ~AnticipativeRenderer();
+
+    // Device thread, with the callback stopped
+    void prepare(int samplesPerBlock, double sampleRate);
+    void release();
+
+    // Message thread
+    void setEnabled(bool shouldRenderAhead);
+    bool isEnabled() const { return enabled.load(); }
+    void setLookahead(double seconds);
+    double getLookahead() const { return lookaheadSeconds.load(); }
+
+    void insertTrack(Track& track, int index);
+    void removeTrack(int index);
+    void moveTrack(int fromIndex, int toIndex);
+
+    // Moves every track to the position and drops what was rendered ahead
+    void setPosition(double positionInSeconds);
+
+    // Audio thread. Lets go of lanes being handed over; readBlock() does the
+    // same, so this is for callbacks that don't read (transport stopped).
+    void acknowledgeHandovers();
+
+    // Audio thread. Fills numSamples of dest with the track's pre-rendered
+    // audio and returns true, or returns false if the track runs live. The
+    // index is where the track is expected in the list; should the list not
+    // have caught up with the mixer's yet, the track is looked for by address.
+    bool readBlock(int index, const Track& track, juce::AudioBuffer<float>& dest, int numSamples);
+
+    // Blocks the callback found short of audio, across all tracks
+    int getNumUnderruns() const { return underruns.load(); }
+
+    static constexpr double maxLookaheadSeconds = 0.5;
+
+private:
+    enum class Owner
+    {
+        callback,
+        handover,
+        worker
+    };
+
+    struct Lane
+    {
+        explicit Lane(Track& t) : track(&t) {}
+
+        Track* track;
+
+        // Held by a worker while it renders the track, and by seeks
+        juce::CriticalSection lock;
+
+        juce::AbstractFifo fifo { 1 };
+        juce::AudioBuffer<float> ring;          // in the track's layout
+        int numChannels = 0;
+
+        std::atomic<Owner> owner { Owner::callback };
+        Owner handoverTo = Owner::callback;     // under lock
+        std::atomic<bool> callbackIdle { false };
+
+        // Timeline positions in samples. played is how far the callback has
+        // got, taken how far it has read the ring (behind played after an
+        // underrun) and written how far the worker has filled it.
+        std::atomic<juce::int64> played { 0 };
+        std::atomic<juce::int64> taken { 0 };
+        std::atomic<juce::int64> written { 0 };
+        juce::int64 idleSince = 0;              // played when the callback let go
+
+        // A seek during a handover: the transport is at the target, which
+        // belongs to the timeline at seekPlayed (under lock)
+        bool seekPending = false;
+        juce::int64 seekPlayed = 0;
+    };
+
+    // The lanes in track order, as the audio thread sees them
+    struct LaneList
+    {
+        std::vector<Lane*> lanes;
+    };
+
+    class Worker;
+
+    void publishLaneList();
+    static Lane* findLane(const LaneList& list, int index, const Track& track);
+    void readLane(Lane& lane, Owner owner, juce::AudioBuffer<float>& dest, int numSamples);
+
+    void allocate(Lane& lane);
+    bool service(juce::AudioBuffer<float>& scratch);
+    bool serviceLane(Lane& lane, juce::AudioBuffer<float>& scratch);
+    bool renderAhead(Lane& lane, juce::AudioBuffer<float>& scratch);
+    void beginHandover(Lane& lane, Owner to);
+    void completeHandover(Lane& lane);
+
+    void startWorkers();
+    void stopWorkers();
+
+    // Workers read the lane list, the message thread changes it
+    juce::ReadWriteLock lanesLock;
+    std::vector<std::unique_ptr<Lane>> lanes;
+
+    std::unique_ptr<LaneList> ownedLaneList;
+    std::atomic<LaneList*> currentLaneList { nullptr };
+    DeferredReleasePool releasePool;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    int blockSize = 0;
+    double currentSampleRate = 0.0;
+    std::atomic<bool> enabled { true };
+    std::atomic<double> lookaheadSeconds { 0.2 };
+    std::atomic<int> underruns { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnticipativeRenderer)
+};
@@ -2,17 +2,19 @@
 #include "Meter.h"
 #include "MultiTrackMixer.h"
 #include "MidiManager.h"
+#include "PluginScanner.h"
 
 AudioEngine::AudioEngine()
     : mixer(std::make_unique<MultiTrackMixer>()),
       meter(std::make_unique<Meter>(mixer.get())),
-      midiManager(std::make_unique<MidiManager>())
+      midiManager(std::make_unique<MidiManager>()),
+      pluginScanner(std::make_unique<PluginScanner>())
 {
     // Initialize with default devices
     deviceManager.initialiseWithDefaultDevices(2, 2);
 
-    // Set Meter as the source for the AudioSourcePlayer
-    audioSourcePlayer.setSource(meter.get());
+    // The engine plays the metered mix and measures its loudness and true peak
+    audioSourcePlayer.setSource(this);
 
     // Register AudioSourcePlayer with the AudioDeviceManager
     deviceManager.addAudioCallback(&audioSourcePlayer);
@@ -35,6 +37,10 @@ AudioEngine::~AudioEngine()
 void AudioEngine::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
     meter->prepareToPlay(samplesPerBlockExpected, sampleRate);
+    auto busLayout = mixer->getBusLayout();
+    loudnessMeter.prepare(sampleRate, busLayout);
+    truePeakDetector.prepare(sampleRate, busLayout);
+    spectrumAnalyser.prepare(sampleRate);
 }
 
 void AudioEngine::releaseResources()
@@ -45,6 +51,9 @@ void AudioEngine::releaseResources()
 void AudioEngine::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
     meter->getNextAudioBlock(bufferToFill);
+    loudnessMeter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+    truePeakDetector.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+    spectrumAnalyser.pushSamples(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
 }
 
 // New multi-track methods
@@ -53,11 +62,21 @@ int AudioEngine::addTrack(const juce::String& name)
     return mixer->addTrack(name);
 }
 
+int AudioEngine::insertTrack(const juce::String& name, int trackIndex)
+{
+    return mixer->insertTrack(name, trackIndex);
+}
+
 void AudioEngine::removeTrack(int trackIndex)
 {
     mixer->removeTrack(trackIndex);
 }
 
+void AudioEngine::moveTrack(int fromIndex, int toIndex)
+{
+    mixer->moveTrack(fromIndex, toIndex);
+}
+
 Track* AudioEngine::getTrack(int trackIndex)
 {
     return mixer->getTrack(trackIndex);
@@ -87,3 +106,83 @@ bool AudioEngine::isPlaying() const
 {
     return mixer->isPlaying();
 }
+
+void AudioEngine::setInternalBlockSize(int numSamples)
+{
+    mixer->setInternalBlockSize(numSamples);
+    restartAudioCallback();
+}
+
+int AudioEngine::getInternalBlockSize() const
+{
+    return mixer->getInternalBlockSize();
+}
+
+void AudioEngine::setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision precision)
+{
+    mixer->setProcessingPrecision(precision);
+    restartAudioCallback();
+}
+
+juce::AudioProcessor::ProcessingPrecision AudioEngine::getProcessingPrecision() const
+{
+    return mixer->getProcessingPrecision();
+}
+
+bool AudioEngine::setBusLayout(const juce::AudioChannelSet& layout)
+{
+    // Playing a wider bus on fewer outputs would drop its extra speakers
+    auto* device = deviceManager.getCurrentAudioDevice();
+    auto numOutputs = device != nullptr ? device->getOutputChannelNames().size() : 0;
+
+    if (numOutputs < layout.size())
+    {
+        juce::Logger::writeToLog("AudioEngine: " + layout.getDescription() + " needs " + juce::String(layout.size())
+                                 + " outputs, the device has " + juce::String(numOutputs));
+        return false;
+    }
+
+    auto previousLayout = mixer->getBusLayout();
+    mixer->setBusLayout(layout);
+
+    if (mixer->getBusLayout() != layout)
+        return false;
+
+    // Open as many outputs as the bus has channels
+    auto setup = deviceManager.getAudioDeviceSetup();
+    setup.useDefaultOutputChannels = false;
+    setup.outputChannels.clear();
+    setup.outputChannels.setRange(0, layout.size(), true);
+
+    auto error = deviceManager.setAudioDeviceSetup(setup, true);
+    if (error.isNotEmpty())
+    {
+        juce::Logger::writeToLog("AudioEngine: couldn't open outputs for " + layout.getDescription() + ": " + error);
+        mixer->setBusLayout(previousLayout);
+        return false;
+    }
+
+    restartAudioCallback();
+    return true;
+}
+
+juce::AudioChannelSet AudioEngine::getBusLayout() const
+{
+    return mixer->getBusLayout();
+}
+
+void AudioEngine::setTrackChannelLayout(int trackIndex, const juce::AudioChannelSet& layout)
+{
+    if (auto* track = mixer->getTrack(trackIndex))
+    {
+        track->setChannelLayout(layout);
+        restartAudioCallback();
+    }
+}
+
+void AudioEngine::restartAudioCallback()
+{
+    // Re-adding the callback stops it and prepares everything again
+    deviceManager.removeAudioCallback(&audioSourcePlayer);
+    deviceManager.addAudioCallback(&audioSourcePlayer);
+}
@@ -2,11 +2,16 @@
 
 #include <JuceHeader.h>
 #include "AudioEngine/Meter.h"
+#include "AudioEngine/LoudnessMeter.h"
+#include "AudioEngine/TruePeakDetector.h"
+#include "AudioEngine/SpectrumAnalyser.h"
+#include "AudioEngine/PluginLoader.h"
 
 // Forward declarations
 class MultiTrackMixer;
 class Track;
 class MidiManager;
+class PluginScanner;
 
 class AudioEngine final : public juce::AudioSource
 {
@@ -21,7 +26,9 @@ public:
 
     // Multi-track functionality
     int addTrack(const juce::String& name = "Track");
+    int insertTrack(const juce::String& name, int trackIndex);
     void removeTrack(int trackIndex);
+    void moveTrack(int fromIndex, int toIndex);
     Track* getTrack(int trackIndex);
     int getNumTracks() const;
 
@@ -31,19 +38,54 @@ public:
     void setPosition(double positionInSeconds);
     bool isPlaying() const;
 
+    // Block size tracks are processed in, independent of the device's; 0
+    // follows the device. Restarts the audio callback to apply it.
+    void setInternalBlockSize(int numSamples);
+    int getInternalBlockSize() const;
+
+    // Single or double precision mixing and processing, see MultiTrackMixer.
+    // Restarts the audio callback to apply it.
+    void setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision precision);
+    juce::AudioProcessor::ProcessingPrecision getProcessingPrecision() const;
+
+    // Layout of the mix bus, see MultiTrackMixer; the device is opened with
+    // as many outputs. Returns false, keeping the current layout, if the
+    // device has too few outputs or won't open them. Restarts the audio
+    // callback to apply it.
+    bool setBusLayout(const juce::AudioChannelSet& layout);
+    juce::AudioChannelSet getBusLayout() const;
+
+    // A track's own layout, see Track. Restarts the audio callback to apply it.
+    void setTrackChannelLayout(int trackIndex, const juce::AudioChannelSet& layout);
+
     // MIDI functionality
     MidiManager& getMidiManager() { return *midiManager; }
 
+    // Plugin discovery (shared by all tracks)
+    PluginScanner& getPluginScanner() { return *pluginScanner; }
+
     juce::AudioDeviceManager& getDeviceManager() { return deviceManager; }
     Meter& getMeter() { return *meter; }
+    LoudnessMeter& getLoudnessMeter() { return loudnessMeter; }
+    TruePeakDetector& getTruePeakDetector() { return truePeakDetector; }
+    SpectrumAnalyser& getSpectrumAnalyser() { return spectrumAnalyser; }
 
 private:
+    void restartAudioCallback();
+
     juce::AudioDeviceManager deviceManager;
     juce::AudioSourcePlayer audioSourcePlayer;
 
     std::unique_ptr<MultiTrackMixer> mixer;
     std::unique_ptr<Meter> meter;
+    LoudnessMeter loudnessMeter;
+    TruePeakDetector truePeakDetector;
+    SpectrumAnalyser spectrumAnalyser;
     std::unique_ptr<MidiManager> midiManager;
+    std::unique_ptr<PluginScanner> pluginScanner;
+
+    // Keeps the shared plugin loader alive while tracks come and go
+    juce::SharedResourcePointer<PluginLoader> pluginLoader;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioEngine)
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "CompensationDelay.h"
+
+CompensationDelay::CompensationDelay()
+{
+}
+
+CompensationDelay::~CompensationDelay()
+{
+}
+
+void CompensationDelay::prepare(int numChannels, int maximumDelayInSamples)
+{
+    bufferLength = juce::jmax(1, maximumDelayInSamples + 1);
+    delayBuffer.setSize(juce::jmax(1, numChannels), bufferLength);
+    delaySamples.store(juce::jmin(getDelay(), bufferLength - 1), std::memory_order_relaxed);
+    reset();
+}
+
+void CompensationDelay::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    // One value for the whole block, however often setDelay() is called meanwhile
+    auto delay = getDelay();
+
+    if (delay == 0)
+        return;
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), delayBuffer.getNumChannels());
+    auto readPosition = (writePosition - delay + bufferLength) % bufferLength;
+    int processed = 0;
+
+    while (processed < numSamples)
+    {
+        // Copy in chunks that do not wrap around either end of the ring
+        auto chunk = juce::jmin(numSamples - processed,
+                                bufferLength - writePosition,
+                                bufferLength - readPosition);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* io = buffer.getWritePointer(channel, startSample + processed);
+            auto* ring = delayBuffer.getWritePointer(channel);
+
+            // Write first so a delay shorter than the chunk still reads valid data
+            if (readPosition + chunk <= writePosition || readPosition >= writePosition + chunk)
+            {
+                juce::FloatVectorOperations::copy(ring + writePosition, io, chunk);
+                juce::FloatVectorOperations::copy(io, ring + readPosition, chunk);
+            }
+            else
+            {
+                for (int i = 0; i < chunk; ++i)
+                {
+                    ring[writePosition + i] = io[i];
+                    io[i] = ring[readPosition + i];
+                }
+            }
+        }
+
+        processed += chunk;
+        writePosition = (writePosition + chunk) % bufferLength;
+        readPosition = (readPosition + chunk) % bufferLength;
+    }
+}
+
+void CompensationDelay::reset()
+{
+    delayBuffer.clear();
+    writePosition = 0;
+}
+
+void CompensationDelay::setDelay(int newDelayInSamples)
+{
+    delaySamples.store(juce::jlimit(0, bufferLength - 1, newDelayInSamples), std::memory_order_relaxed);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+
+// Fixed-capacity integer delay used for plugin delay compensation.
+// All memory is allocated in prepare(); setDelay() may be called from any
+// thread and takes effect at the next process() block.
+class CompensationDelay
+{
+public:
+    CompensationDelay();
+    ~CompensationDelay();
+
+    void prepare(int numChannels, int maximumDelayInSamples);
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void reset();
+
+    void setDelay(int newDelayInSamples);
+    int getDelay() const { return delaySamples.load(std::memory_order_relaxed); }
+    int getMaximumDelay() const { return bufferLength - 1; }
+
+private:
+    juce::AudioBuffer<float> delayBuffer;
+    int bufferLength = 1;
+    int writePosition = 0;
+    std::atomic<int> delaySamples { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CompensationDelay)
+};
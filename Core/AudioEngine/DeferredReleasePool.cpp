@@ -0,0 +1,47 @@
+#include "DeferredReleasePool.h"
+
+DeferredReleasePool::DeferredReleasePool()
+{
+}
+
+DeferredReleasePool::~DeferredReleasePool()
+{
+    releaseAll();
+}
+
+void DeferredReleasePool::collectGarbage()
+{
+    const juce::ScopedLock sl(lock);
+
+    retiredObjects.erase(std::remove_if(retiredObjects.begin(), retiredObjects.end(),
+                                        [this](const RetiredObject& retired) { return isSafeToRelease(retired); }),
+                         retiredObjects.end());
+}
+
+void DeferredReleasePool::releaseAll()
+{
+    const juce::ScopedLock sl(lock);
+    retiredObjects.clear();
+}
+
+void DeferredReleasePool::retireObject(std::shared_ptr<void> object)
+{
+    const juce::ScopedLock sl(lock);
+    retiredObjects.push_back({ std::move(object), blockCounter.load() });
+
+    // Opportunistically free anything the audio thread has finished with
+    retiredObjects.erase(std::remove_if(retiredObjects.begin(), retiredObjects.end(),
+                                        [this](const RetiredObject& retired) { return isSafeToRelease(retired); }),
+                         retiredObjects.end());
+}
+
+bool DeferredReleasePool::isSafeToRelease(const RetiredObject& retired) const noexcept
+{
+    // Even counter: no block was running when the object was retired, so the
+    // next block will already see its replacement. Odd counter: wait until
+    // the block that was running at that moment has ended.
+    if ((retired.retiredAt & 1) == 0)
+        return true;
+
+    return blockCounter.load() > retired.retiredAt;
+}
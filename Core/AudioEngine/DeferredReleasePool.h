@@ -0,0 +1,52 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Keeps objects that the audio thread may still be reading alive until the
+// audio thread has provably moved on, so that lock-free pointer swaps never
+// delete (or free memory) on the audio thread.
+//
+// The audio thread brackets each block with beginAudioBlock()/endAudioBlock().
+// The counter is odd while a block is running, which lets non-audio threads
+// decide whether a retired object can still be referenced.
+class DeferredReleasePool
+{
+public:
+    DeferredReleasePool();
+    ~DeferredReleasePool();
+
+    // Audio thread
+    void beginAudioBlock() noexcept { blockCounter.fetch_add(1); }
+    void endAudioBlock() noexcept   { blockCounter.fetch_add(1); }
+
+    // Any non-audio thread. Call after the replacement has been published.
+    template <typename ObjectType>
+    void retire(std::unique_ptr<ObjectType> object)
+    {
+        if (object != nullptr)
+            retireObject(std::shared_ptr<void>(object.release(), std::default_delete<ObjectType>()));
+    }
+
+    void collectGarbage();
+
+    // Only safe once the audio thread has stopped calling into the owner
+    void releaseAll();
+
+private:
+    struct RetiredObject
+    {
+        std::shared_ptr<void> object;
+        juce::uint64 retiredAt = 0;
+    };
+
+    void retireObject(std::shared_ptr<void> object);
+    bool isSafeToRelease(const RetiredObject& retired) const noexcept;
+
+    std::atomic<juce::uint64> blockCounter { 0 };
+    std::vector<RetiredObject> retiredObjects;
+    juce::CriticalSection lock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeferredReleasePool)
+};
@@ -3,12 +3,11 @@
 EffectsProcessor::EffectsProcessor()
 {
     // Initialize reverb parameters
-    juce::dsp::Reverb::Parameters reverbParams;
-    reverbParams.roomSize = 0.5f;
-    reverbParams.damping = 0.5f;
-    reverbParams.wetLevel = 0.3f;
-    reverbParams.dryLevel = 0.7f;
-    reverb.setParameters(reverbParams);
+    reverbParameters.roomSize = 0.5f;
+    reverbParameters.damping = 0.5f;
+    reverbParameters.wetLevel = 0.3f;
+    reverbParameters.dryLevel = 0.7f;
+    floatChain.reverb.setParameters(reverbParameters);
 }
 
 EffectsProcessor::~EffectsProcessor()
@@ -24,65 +23,197 @@ void EffectsProcessor::prepareToPlay(double sampleRate, int samplesPerBlock, int
     spec.maximumBlockSize = static_cast<juce::uint32>(samplesPerBlock);
     spec.numChannels = static_cast<juce::uint32>(numChannels);
 
-    processorChain.prepare(spec);
-    delayLine.prepare(spec);
-    delayLine.setMaximumDelayInSamples(static_cast<int>(sampleRate * 2.0)); // 2 second max delay
+    prepareChain(floatChain, spec);
 
-    // Setup EQ filters
-    setLowGain(0.0f);   // 0 dB (no change)
-    setMidGain(0.0f);   // 0 dB (no change)
-    setHighGain(0.0f);  // 0 dB (no change)
+    if (precision == juce::AudioProcessor::doublePrecision)
+    {
+        if (doubleChain == nullptr)
+            doubleChain = std::make_unique<Chain<double>>();
+
+        prepareChain(*doubleChain, spec);
+        doubleChain->reverbBuffer.setSize(juce::jmin(numChannels, 2), samplesPerBlock);
+    }
+    else
+    {
+        doubleChain.reset();
+    }
+
+    // Re-apply the current settings; EQ coefficients and the delay length
+    // depend on the sample rate, and a restored project may already have set them
+    setLowGain(lowGainDb);
+    setMidGain(midGainDb);
+    setHighGain(highGainDb);
 
     // Setup compressor
-    setCompressorThreshold(-12.0f);
-    setCompressorRatio(4.0f);
-    setCompressorAttack(10.0f);
-    setCompressorRelease(100.0f);
+    setCompressorThreshold(compressorThreshold);
+    setCompressorRatio(compressorRatio);
+    setCompressorAttack(compressorAttack);
+    setCompressorRelease(compressorRelease);
 
     // Setup chorus
-    setChorusRate(1.0f);
-    setChorusDepth(0.25f);
-    setChorusCentreDelay(7.0f);
-    setChorusFeedback(0.0f);
-    setChorusMix(0.5f);
+    setChorusRate(chorusRate);
+    setChorusDepth(chorusDepth);
+    setChorusCentreDelay(chorusCentreDelay);
+    setChorusFeedback(chorusFeedback);
+    setChorusMix(chorusMix);
+
+    // Setup reverb and delay
+    forEachChain([this](auto& chain) { chain.reverb.setParameters(reverbParameters); });
+    setDelayTime(delayTime);
+}
+
+template <typename SampleType>
+void EffectsProcessor::prepareChain(Chain<SampleType>& chain, const juce::dsp::ProcessSpec& spec)
+{
+    chain.equaliser.prepare(spec);
+    chain.compressor.prepare(spec);
+    chain.chorus.prepare(spec);
+    chain.reverb.prepare(spec);
+    chain.delayLine.prepare(spec);
+    chain.delayLine.setMaximumDelayInSamples(static_cast<int>(spec.sampleRate * 2.0)); // 2 second max delay
+}
+
+//==============================================================================
+template <typename SampleType>
+EffectsProcessor::Equaliser<SampleType>::Equaliser()
+{
+    for (auto& bandCoefficients : coefficients)
+        bandCoefficients = new Coefficients(1, 0, 1, 0);
+}
+
+template <typename SampleType>
+void EffectsProcessor::Equaliser<SampleType>::prepare(const juce::dsp::ProcessSpec& spec)
+{
+    auto numGroups = (static_cast<int>(spec.numChannels) + lanes - 1) / lanes;
+    groups.resize(static_cast<size_t>(numGroups));
+
+    for (auto& group : groups)
+    {
+        for (int band = 0; band < numBands; ++band)
+        {
+            group[static_cast<size_t>(band)].coefficients = coefficients[static_cast<size_t>(band)];
+            group[static_cast<size_t>(band)].reset();
+        }
+    }
 
-    // Setup delay
-    setDelayTime(250.0f);
-    setDelayFeedback(0.3f);
-    setDelayMix(0.3f);
+    // Lanes without a channel are never written, so they filter silence
+    interleaved = juce::dsp::AudioBlock<Vector>(interleavedData, static_cast<size_t>(numGroups), spec.maximumBlockSize);
+    interleaved.clear();
 }
 
+template <typename SampleType>
+void EffectsProcessor::Equaliser<SampleType>::process(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto numChannels = static_cast<int>(block.getNumChannels());
+    auto numSamples = juce::jmin(block.getNumSamples(), interleaved.getNumSamples());
+
+    for (size_t group = 0; group < groups.size(); ++group)
+    {
+        auto firstChannel = static_cast<int>(group) * lanes;
+        auto channelsInGroup = juce::jmin(lanes, numChannels - firstChannel);
+        if (channelsInGroup <= 0)
+            break;
+
+        auto vectors = interleaved.getSingleChannelBlock(group).getSubBlock(0, numSamples);
+        auto* samples = reinterpret_cast<SampleType*>(vectors.getChannelPointer(0));
+
+        for (int lane = 0; lane < channelsInGroup; ++lane)
+        {
+            auto* source = block.getChannelPointer(static_cast<size_t>(firstChannel + lane));
+            for (size_t i = 0; i < numSamples; ++i)
+                samples[i * lanes + static_cast<size_t>(lane)] = source[i];
+        }
+
+        juce::dsp::ProcessContextReplacing<Vector> context(vectors);
+        for (auto& filter : groups[group])
+            filter.process(context);
+
+        for (int lane = 0; lane < channelsInGroup; ++lane)
+        {
+            auto* dest = block.getChannelPointer(static_cast<size_t>(firstChannel + lane));
+            for (size_t i = 0; i < numSamples; ++i)
+                dest[i] = samples[i * lanes + static_cast<size_t>(lane)];
+        }
+    }
+}
+
+template <typename SampleType>
+void EffectsProcessor::Equaliser<SampleType>::reset()
+{
+    for (auto& group : groups)
+        for (auto& filter : group)
+            filter.reset();
+}
+
+//==============================================================================
 void EffectsProcessor::processBlock(juce::AudioBuffer<float>& buffer)
 {
-    juce::dsp::AudioBlock<float> block(buffer);
-    juce::dsp::ProcessContextReplacing<float> context(block);
+    process(floatChain, buffer);
+}
+
+void EffectsProcessor::processBlock(juce::AudioBuffer<double>& buffer)
+{
+    // Not prepared for double precision
+    jassert(doubleChain != nullptr);
+
+    if (doubleChain != nullptr)
+        process(*doubleChain, buffer);
+}
+
+template <typename SampleType>
+void EffectsProcessor::process(Chain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer)
+{
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    juce::dsp::ProcessContextReplacing<SampleType> context(block);
 
     // Process individual effects based on enabled state
     if (eqEnabled)
     {
-        processorChain.get<0>().process(context);  // Low shelf
-        processorChain.get<1>().process(context);  // Mid peak
-        processorChain.get<2>().process(context);  // High shelf
+        chain.equaliser.process(block);
     }
     
     if (compressorEnabled)
     {
-        processorChain.get<3>().process(context);  // Compressor
+        chain.compressor.process(context);
     }
     
     if (chorusEnabled)
     {
-        processorChain.get<4>().process(context);  // Chorus
+        chain.chorus.process(context);
     }
     
     if (reverbEnabled)
     {
-        processorChain.get<5>().process(context);  // Reverb
+        auto reverbChannels = juce::jmin(buffer.getNumChannels(), 2);
+
+        if constexpr (std::is_same_v<SampleType, float>)
+        {
+            auto reverbBlock = block.getSubsetChannelBlock(0, static_cast<size_t>(reverbChannels));
+            chain.reverb.process(juce::dsp::ProcessContextReplacing<float>(reverbBlock));
+        }
+        else
+        {
+            auto numSamples = juce::jmin(buffer.getNumSamples(), chain.reverbBuffer.getNumSamples());
+            reverbChannels = juce::jmin(reverbChannels, chain.reverbBuffer.getNumChannels());
+
+            for (int channel = 0; channel < reverbChannels; ++channel)
+                std::copy_n(buffer.getReadPointer(channel), numSamples, chain.reverbBuffer.getWritePointer(channel));
+
+            juce::dsp::AudioBlock<float> floatBlock(chain.reverbBuffer.getArrayOfWritePointers(),
+                                                    static_cast<size_t>(reverbChannels), static_cast<size_t>(numSamples));
+            chain.reverb.process(juce::dsp::ProcessContextReplacing<float>(floatBlock));
+
+            for (int channel = 0; channel < reverbChannels; ++channel)
+                std::copy_n(chain.reverbBuffer.getReadPointer(channel), numSamples, buffer.getWritePointer(channel));
+        }
     }
 
     // Process delay separately (not in chain for feedback control)
     if (delayEnabled)
     {
+        auto mix = static_cast<SampleType>(delayMix);
+        auto feedback = static_cast<SampleType>(delayFeedback);
+
         for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
         {
             auto* channelData = buffer.getWritePointer(channel);
@@ -90,10 +221,10 @@ void EffectsProcessor::processBlock(juce::AudioBuffer<float>& buffer)
             for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
             {
                 auto input = channelData[sample];
-                auto delayedSample = delayLine.popSample(channel);
-                auto output = input + delayedSample * delayMix;
+                auto delayedSample = chain.delayLine.popSample(channel);
+                auto output = input + delayedSample * mix;
                 
-                delayLine.pushSample(channel, input + delayedSample * delayFeedback);
+                chain.delayLine.pushSample(channel, input + delayedSample * feedback);
                 channelData[sample] = output;
             }
         }
@@ -102,120 +233,135 @@ void EffectsProcessor::processBlock(juce::AudioBuffer<float>& buffer)
 
 void EffectsProcessor::reset()
 {
-    processorChain.reset();
+    forEachChain([](auto& chain)
+    {
+        chain.equaliser.reset();
+        chain.compressor.reset();
+        chain.chorus.reset();
+        chain.reverb.reset();
+    });
 }
 
 void EffectsProcessor::setLowGain(float gainDb)
 {
-    auto& lowShelf = processorChain.get<0>();
-    *lowShelf.state = *juce::dsp::IIR::Coefficients<float>::makeLowShelf(
-        currentSampleRate, 200.0f, 0.7f, juce::Decibels::decibelsToGain(gainDb));
+    lowGainDb = gainDb;
+    forEachChain([this, gainDb](auto& chain)
+    {
+        using Sample = typename std::decay_t<decltype(chain)>::Sample;
+        *chain.equaliser.coefficients[Equaliser<Sample>::lowShelf] = *juce::dsp::IIR::Coefficients<Sample>::makeLowShelf(
+            currentSampleRate, Sample(200), Sample(0.7), static_cast<Sample>(juce::Decibels::decibelsToGain(gainDb)));
+    });
 }
 
 void EffectsProcessor::setMidGain(float gainDb)
 {
-    auto& midPeak = processorChain.get<1>();
-    *midPeak.state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-        currentSampleRate, 1000.0f, 0.7f, juce::Decibels::decibelsToGain(gainDb));
+    midGainDb = gainDb;
+    forEachChain([this, gainDb](auto& chain)
+    {
+        using Sample = typename std::decay_t<decltype(chain)>::Sample;
+        *chain.equaliser.coefficients[Equaliser<Sample>::midPeak] = *juce::dsp::IIR::Coefficients<Sample>::makePeakFilter(
+            currentSampleRate, Sample(1000), Sample(0.7), static_cast<Sample>(juce::Decibels::decibelsToGain(gainDb)));
+    });
 }
 
 void EffectsProcessor::setHighGain(float gainDb)
 {
-    auto& highShelf = processorChain.get<2>();
-    *highShelf.state = *juce::dsp::IIR::Coefficients<float>::makeHighShelf(
-        currentSampleRate, 5000.0f, 0.7f, juce::Decibels::decibelsToGain(gainDb));
+    highGainDb = gainDb;
+    forEachChain([this, gainDb](auto& chain)
+    {
+        using Sample = typename std::decay_t<decltype(chain)>::Sample;
+        *chain.equaliser.coefficients[Equaliser<Sample>::highShelf] = *juce::dsp::IIR::Coefficients<Sample>::makeHighShelf(
+            currentSampleRate, Sample(5000), Sample(0.7), static_cast<Sample>(juce::Decibels::decibelsToGain(gainDb)));
+    });
 }
 
 void EffectsProcessor::setCompressorThreshold(float thresholdDb)
 {
-    auto& comp = processorChain.get<3>();
-    comp.setThreshold(thresholdDb);
+    compressorThreshold = thresholdDb;
+    forEachChain([thresholdDb](auto& chain) { chain.compressor.setThreshold(thresholdDb); });
 }
 
 void EffectsProcessor::setCompressorRatio(float ratio)
 {
-    auto& comp = processorChain.get<3>();
-    comp.setRatio(ratio);
+    compressorRatio = ratio;
+    forEachChain([ratio](auto& chain) { chain.compressor.setRatio(ratio); });
 }
 
 void EffectsProcessor::setCompressorAttack(float attackMs)
 {
-    auto& comp = processorChain.get<3>();
-    comp.setAttack(attackMs);
+    compressorAttack = attackMs;
+    forEachChain([attackMs](auto& chain) { chain.compressor.setAttack(attackMs); });
 }
 
 void EffectsProcessor::setCompressorRelease(float releaseMs)
 {
-    auto& comp = processorChain.get<3>();
-    comp.setRelease(releaseMs);
+    compressorRelease = releaseMs;
+    forEachChain([releaseMs](auto& chain) { chain.compressor.setRelease(releaseMs); });
 }
 
 void EffectsProcessor::setReverbRoomSize(float size)
 {
-    auto& rev = processorChain.get<5>();
-    auto params = rev.getParameters();
-    params.roomSize = size;
-    rev.setParameters(params);
+    reverbParameters.roomSize = size;
+    forEachChain([this](auto& chain) { chain.reverb.setParameters(reverbParameters); });
 }
 
 void EffectsProcessor::setReverbDamping(float damping)
 {
-    auto& rev = processorChain.get<5>();
-    auto params = rev.getParameters();
-    params.damping = damping;
-    rev.setParameters(params);
+    reverbParameters.damping = damping;
+    forEachChain([this](auto& chain) { chain.reverb.setParameters(reverbParameters); });
 }
 
 void EffectsProcessor::setReverbWetLevel(float wetLevel)
 {
-    auto& rev = processorChain.get<5>();
-    auto params = rev.getParameters();
-    params.wetLevel = wetLevel;
-    rev.setParameters(params);
+    reverbParameters.wetLevel = wetLevel;
+    forEachChain([this](auto& chain) { chain.reverb.setParameters(reverbParameters); });
 }
 
 void EffectsProcessor::setReverbDryLevel(float dryLevel)
 {
-    auto& rev = processorChain.get<5>();
-    auto params = rev.getParameters();
-    params.dryLevel = dryLevel;
-    rev.setParameters(params);
+    reverbParameters.dryLevel = dryLevel;
+    forEachChain([this](auto& chain) { chain.reverb.setParameters(reverbParameters); });
 }
 
 void EffectsProcessor::setChorusRate(float rateHz)
 {
-    auto& ch = processorChain.get<4>();
-    ch.setRate(rateHz);
+    chorusRate = rateHz;
+    forEachChain([rateHz](auto& chain) { chain.chorus.setRate(rateHz); });
 }
 
 void EffectsProcessor::setChorusDepth(float depth)
 {
-    auto& ch = processorChain.get<4>();
-    ch.setDepth(depth);
+    chorusDepth = depth;
+    forEachChain([depth](auto& chain) { chain.chorus.setDepth(depth); });
 }
 
 void EffectsProcessor::setChorusCentreDelay(float delayMs)
 {
-    auto& ch = processorChain.get<4>();
-    ch.setCentreDelay(delayMs);
+    chorusCentreDelay = delayMs;
+    forEachChain([delayMs](auto& chain) { chain.chorus.setCentreDelay(delayMs); });
 }
 
 void EffectsProcessor::setChorusFeedback(float feedback)
 {
-    auto& ch = processorChain.get<4>();
-    ch.setFeedback(feedback);
+    chorusFeedback = feedback;
+    forEachChain([feedback](auto& chain) { chain.chorus.setFeedback(feedback); });
 }
 
 void EffectsProcessor::setChorusMix(float mix)
 {
-    auto& ch = processorChain.get<4>();
-    ch.setMix(mix);
+    chorusMix = mix;
+    forEachChain([mix](auto& chain) { chain.chorus.setMix(mix); });
 }
 
 void EffectsProcessor::setDelayTime(float timeMs)
 {
     delayTime = timeMs;
-    delayLine.setDelay(timeMs * currentSampleRate / 1000.0f);
+    auto delayInSamples = timeMs * currentSampleRate / 1000.0;
+    forEachChain([delayInSamples](auto& chain)
+    {
+        using Sample = typename std::decay_t<decltype(chain)>::Sample;
+        chain.delayLine.setDelay(static_cast<Sample>(delayInSamples));
+    });
 }
 
 void EffectsProcessor::setDelayFeedback(float feedback)
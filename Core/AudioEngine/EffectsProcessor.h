@@ -1,14 +1,30 @@
 #pragma once
 #include <JuceHeader.h>
 
+// Built-in EQ, compressor, chorus, reverb and delay for a track.
+//
+// The DSP is written once for any sample type. Single precision is always
+// prepared; double precision is prepared as well when selected, and either
+// processBlock can then be used. The reverb only exists in single precision,
+// so the double chain runs it on a float copy.
+//
+// Any number of channels can be prepared. The EQ filters channels side by
+// side in SIMD registers, so a mono or stereo track costs one filter per
+// band and 7.1.4 three (floats, 4 lanes). The reverb is mono or stereo; wider
+// layouts feed it their first two channels.
 class EffectsProcessor
 {
 public:
     EffectsProcessor();
     ~EffectsProcessor();
 
+    // Takes effect from the next prepareToPlay
+    void setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision newPrecision) { precision = newPrecision; }
+    juce::AudioProcessor::ProcessingPrecision getProcessingPrecision() const { return precision; }
+
     void prepareToPlay(double sampleRate, int samplesPerBlock, int numChannels);
     void processBlock(juce::AudioBuffer<float>& buffer);
+    void processBlock(juce::AudioBuffer<double>& buffer);
     void reset();
 
     // EQ controls
@@ -48,36 +64,95 @@ public:
     void setDelayEnabled(bool enabled) { delayEnabled = enabled; }
 
 private:
-    // EQ
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> lowShelfFilter;
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> midPeakFilter;
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> highShelfFilter;
-
-    // Compressor
-    juce::dsp::Compressor<float> compressor;
-
-    // Reverb
-    juce::dsp::Reverb reverb;
-
-    // Chorus
-    juce::dsp::Chorus<float> chorus;
+    // The EQ bands over all channels. Channels are interleaved into SIMD
+    // registers and each register's worth goes through one filter per band;
+    // the bands of all registers share their coefficients.
+    template <typename SampleType>
+    struct Equaliser
+    {
+       #if JUCE_USE_SIMD
+        using Vector = juce::dsp::SIMDRegister<SampleType>;
+       #else
+        using Vector = SampleType;
+       #endif
+        using Coefficients = juce::dsp::IIR::Coefficients<SampleType>;
+
+        static constexpr int lanes = static_cast<int>(sizeof(Vector) / sizeof(SampleType));
+        enum Band { lowShelf, midPeak, highShelf, numBands };
+
+        Equaliser();
+        void prepare(const juce::dsp::ProcessSpec& spec);
+        void process(const juce::dsp::AudioBlock<SampleType>& block);
+        void reset();
+
+        std::array<typename Coefficients::Ptr, numBands> coefficients;
+        std::vector<std::array<juce::dsp::IIR::Filter<Vector>, numBands>> groups;
+
+        // One channel of interleaved registers per group
+        juce::HeapBlock<char> interleavedData;
+        juce::dsp::AudioBlock<Vector> interleaved;
+    };
+
+    template <typename SampleType>
+    struct Chain
+    {
+        using Sample = SampleType;
+
+        // EQ
+        Equaliser<SampleType> equaliser;
+
+        // Dynamics and modulation
+        juce::dsp::Compressor<SampleType> compressor;
+        juce::dsp::Chorus<SampleType> chorus;
+
+        // Reverb, with a float copy of the block for the double chain
+        juce::dsp::Reverb reverb;
+        juce::AudioBuffer<float> reverbBuffer;
+
+        // Delay (not a dsp processor, for feedback control)
+        juce::dsp::DelayLine<SampleType, juce::dsp::DelayLineInterpolationTypes::Linear> delayLine;
+    };
+
+    template <typename SampleType>
+    void prepareChain(Chain<SampleType>& chain, const juce::dsp::ProcessSpec& spec);
+
+    template <typename SampleType>
+    void process(Chain<SampleType>& chain, juce::AudioBuffer<SampleType>& buffer);
+
+    // Applies a setting to every prepared chain
+    template <typename Function>
+    void forEachChain(Function&& function)
+    {
+        function(floatChain);
+
+        if (doubleChain != nullptr)
+            function(*doubleChain);
+    }
+
+    Chain<float> floatChain;
+    std::unique_ptr<Chain<double>> doubleChain;
+    juce::AudioProcessor::ProcessingPrecision precision = juce::AudioProcessor::singlePrecision;
+
+    // Current settings, re-applied by prepareToPlay
+    float lowGainDb = 0.0f;
+    float midGainDb = 0.0f;
+    float highGainDb = 0.0f;
+    float compressorThreshold = -12.0f;
+    float compressorRatio = 4.0f;
+    float compressorAttack = 10.0f;
+    float compressorRelease = 100.0f;
+    float chorusRate = 1.0f;
+    float chorusDepth = 0.25f;
+    float chorusCentreDelay = 7.0f;
+    float chorusFeedback = 0.0f;
+    float chorusMix = 0.5f;
+    juce::dsp::Reverb::Parameters reverbParameters;
 
     // Delay
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> delayLine;
     float delayTime = 250.0f;
     float delayFeedback = 0.3f;
     float delayMix = 0.3f;
 
-    // Processing chain
-    juce::dsp::ProcessorChain<
-        decltype(lowShelfFilter),
-        decltype(midPeakFilter),
-        decltype(highShelfFilter),
-        decltype(compressor),
-        decltype(chorus),
-        decltype(reverb)
-    > processorChain;
-
     bool eqEnabled = false;
     bool compressorEnabled = false;
     bool reverbEnabled = false;
@@ -0,0 +1,365 @@
+#include "LoudnessMeter.h"
+#include "TruePeakDetector.h"
+
+namespace
+{
+    constexpr double stepSeconds = 0.1;
+    constexpr double relativeGateLu = -10.0;
+    constexpr double rangeGateLu = -20.0;
+}
+
+LoudnessMeter::LoudnessMeter()
+{
+}
+
+LoudnessMeter::~LoudnessMeter()
+{
+}
+
+void LoudnessMeter::prepare(double sampleRate, const juce::AudioChannelSet& layout)
+{
+    // K-weighting for any rate, from the analogue prototypes behind the
+    // 48 kHz coefficients in BS.1770: a +4 dB high shelf for the head...
+    {
+        const double f0 = 1681.974450955533;
+        const double gainDb = 3.999843853973347;
+        const double q = 0.7071752369554196;
+
+        auto k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        auto vh = std::pow(10.0, gainDb / 20.0);
+        auto vb = std::pow(vh, 0.4996667741545416);
+        auto a0 = 1.0 + k / q + k * k;
+
+        preFilter.b0 = (vh + vb * k / q + k * k) / a0;
+        preFilter.b1 = 2.0 * (k * k - vh) / a0;
+        preFilter.b2 = (vh - vb * k / q + k * k) / a0;
+        preFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+        preFilter.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    // ...and the revised low-frequency B-curve high-pass
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+
+        auto k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        auto a0 = 1.0 + k / q + k * k;
+
+        rlbFilter.b0 = 1.0;
+        rlbFilter.b1 = -2.0;
+        rlbFilter.b2 = 1.0;
+        rlbFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+        rlbFilter.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    channels.assign(static_cast<size_t>(juce::jmax(1, layout.size())), ChannelState());
+
+    for (int c = 0; c < layout.size(); ++c)
+        channels[static_cast<size_t>(c)].weight = weightFor(layout, c);
+
+    samplesPerStep = juce::jmax(1, juce::roundToInt(sampleRate * stepSeconds));
+    reset();
+}
+
+void LoudnessMeter::reset()
+{
+    for (auto& channel : channels)
+    {
+        auto weight = channel.weight;
+        channel = ChannelState();
+        channel.weight = weight;
+    }
+
+    samplesInStep = 0;
+    stepSum = 0.0;
+    stepEnergies.fill(0.0);
+    stepIndex = 0;
+    stepsSeen = 0;
+    momentarySum = 0.0;
+    shortTermSum = 0.0;
+
+    blockHistogram.clear();
+    shortTermHistogram.clear();
+    maxMomentary = 0.0;
+    maxShortTerm = 0.0;
+
+    auto silence = -std::numeric_limits<float>::infinity();
+    momentaryLufs = silence;
+    shortTermLufs = silence;
+    integratedLufs = silence;
+    loudnessRange = 0.0f;
+    maxMomentaryLufs = silence;
+    maxShortTermLufs = silence;
+}
+
+void LoudnessMeter::process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto numChannels = juce::jmin(buffer.getNumChannels(), static_cast<int>(channels.size()));
+
+    while (numSamples > 0)
+    {
+        auto count = juce::jmin(numSamples, samplesPerStep - samplesInStep);
+
+        for (int c = 0; c < numChannels; ++c)
+        {
+            auto& state = channels[static_cast<size_t>(c)];
+            if (state.weight == 0.0)
+                continue;
+
+            const auto* data = buffer.getReadPointer(c, startSample);
+            double z1a = state.z1[0], z2a = state.z2[0];
+            double z1b = state.z1[1], z2b = state.z2[1];
+            double sum = 0.0;
+
+            // Both stages in transposed direct form II, in double precision
+            // since the high-pass pole sits very close to the unit circle
+            for (int i = 0; i < count; ++i)
+            {
+                double x = data[i];
+
+                auto y = preFilter.b0 * x + z1a;
+                z1a = preFilter.b1 * x - preFilter.a1 * y + z2a;
+                z2a = preFilter.b2 * x - preFilter.a2 * y;
+
+                auto k = rlbFilter.b0 * y + z1b;
+                z1b = rlbFilter.b1 * y - rlbFilter.a1 * k + z2b;
+                z2b = rlbFilter.b2 * y - rlbFilter.a2 * k;
+
+                sum += k * k;
+            }
+
+            state.z1[0] = z1a;
+            state.z2[0] = z2a;
+            state.z1[1] = z1b;
+            state.z2[1] = z2b;
+            stepSum += sum * state.weight;
+        }
+
+        samplesInStep += count;
+        startSample += count;
+        numSamples -= count;
+
+        if (samplesInStep == samplesPerStep)
+            endStep();
+    }
+}
+
+void LoudnessMeter::endStep()
+{
+    auto energy = stepSum / samplesPerStep;
+    stepSum = 0.0;
+    samplesInStep = 0;
+
+    // Slide both windows by one step: add the new energy, drop the oldest
+    auto leavingMomentary = (stepIndex + stepsPerShortTerm - stepsPerMomentary) % stepsPerShortTerm;
+    momentarySum += energy - stepEnergies[static_cast<size_t>(leavingMomentary)];
+    shortTermSum += energy - stepEnergies[static_cast<size_t>(stepIndex)];
+
+    stepEnergies[static_cast<size_t>(stepIndex)] = energy;
+    stepIndex = (stepIndex + 1) % stepsPerShortTerm;
+    ++stepsSeen;
+
+    // Re-sum once per lap so rounding errors cannot build up
+    if (stepIndex == 0)
+    {
+        shortTermSum = 0.0;
+        for (auto e : stepEnergies)
+            shortTermSum += e;
+
+        momentarySum = 0.0;
+        for (int i = 1; i <= stepsPerMomentary; ++i)
+            momentarySum += stepEnergies[static_cast<size_t>(stepsPerShortTerm - i)];
+    }
+
+    auto momentary = juce::jmax(0.0, momentarySum / stepsPerMomentary);
+    auto shortTerm = juce::jmax(0.0, shortTermSum / stepsPerShortTerm);
+
+    momentaryLufs.store(static_cast<float>(toLufs(momentary)), std::memory_order_relaxed);
+    shortTermLufs.store(static_cast<float>(toLufs(shortTerm)), std::memory_order_relaxed);
+
+    // Gating blocks are 400 ms long with 75% overlap, i.e. one per step
+    if (stepsSeen >= stepsPerMomentary)
+    {
+        blockHistogram.add(momentary);
+        maxMomentary = juce::jmax(maxMomentary, momentary);
+        maxMomentaryLufs.store(static_cast<float>(toLufs(maxMomentary)), std::memory_order_relaxed);
+
+        auto relativeGate = toLufs(blockHistogram.meanSquareAbove(Histogram::minimumLufs)) + relativeGateLu;
+        integratedLufs.store(static_cast<float>(toLufs(blockHistogram.meanSquareAbove(relativeGate))),
+                             std::memory_order_relaxed);
+    }
+
+    if (stepsSeen >= stepsPerShortTerm)
+    {
+        shortTermHistogram.add(shortTerm);
+        maxShortTerm = juce::jmax(maxShortTerm, shortTerm);
+        maxShortTermLufs.store(static_cast<float>(toLufs(maxShortTerm)), std::memory_order_relaxed);
+
+        auto rangeGate = toLufs(shortTermHistogram.meanSquareAbove(Histogram::minimumLufs)) + rangeGateLu;
+        auto low = shortTermHistogram.percentileAbove(rangeGate, 0.10);
+        auto high = shortTermHistogram.percentileAbove(rangeGate, 0.95);
+        loudnessRange.store(static_cast<float>(juce::jmax(0.0, high - low)), std::memory_order_relaxed);
+    }
+}
+
+LoudnessMeter::Result LoudnessMeter::getResult() const
+{
+    Result result;
+    result.integratedLufs = getIntegratedLufs();
+    result.loudnessRangeLu = getLoudnessRange();
+    result.maxMomentaryLufs = maxMomentaryLufs.load(std::memory_order_relaxed);
+    result.maxShortTermLufs = maxShortTermLufs.load(std::memory_order_relaxed);
+    return result;
+}
+
+double LoudnessMeter::weightFor(const juce::AudioChannelSet& layout, int channel)
+{
+    // Only W carries the sound field's level; the other components would
+    // count it again, turned
+    if (layout.getAmbisonicOrder() >= 0)
+        return channel == 0 ? 1.0 : 0.0;
+
+    switch (layout.getTypeOfChannel(channel))
+    {
+        case juce::AudioChannelSet::LFE:
+        case juce::AudioChannelSet::LFE2:
+            return 0.0;
+
+        case juce::AudioChannelSet::leftSurround:
+        case juce::AudioChannelSet::rightSurround:
+        case juce::AudioChannelSet::leftSurroundSide:
+        case juce::AudioChannelSet::rightSurroundSide:
+        case juce::AudioChannelSet::leftSurroundRear:
+        case juce::AudioChannelSet::rightSurroundRear:
+            return 1.41;
+
+        default:
+            return 1.0;
+    }
+}
+
+double LoudnessMeter::toLufs(double meanSquare)
+{
+    if (meanSquare <= 0.0)
+        return -std::numeric_limits<double>::infinity();
+
+    return -0.691 + 10.0 * std::log10(meanSquare);
+}
+
+bool LoudnessMeter::analyseFile(const juce::File& file, Result& result)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr)
+    {
+        juce::Logger::writeToLog("LoudnessMeter: cannot read " + file.getFullPathName());
+        return false;
+    }
+
+    auto numChannels = static_cast<int>(reader->numChannels);
+
+    // The file's own channel mask where it has one, else the usual order
+    auto layout = reader->getChannelLayout();
+    if (layout.size() != numChannels)
+        layout = juce::AudioChannelSet::canonicalChannelSet(numChannels);
+
+    LoudnessMeter meter;
+    meter.prepare(reader->sampleRate, layout);
+
+    TruePeakDetector truePeak;
+    truePeak.prepare(reader->sampleRate, layout);
+
+    // Large reads keep this disk-bound rather than call-bound
+    constexpr int chunkSize = 1 << 16;
+    juce::AudioBuffer<float> buffer(numChannels, chunkSize);
+
+    for (juce::int64 position = 0; position < reader->lengthInSamples; position += chunkSize)
+    {
+        auto count = static_cast<int>(juce::jmin(static_cast<juce::int64>(chunkSize), reader->lengthInSamples - position));
+
+        if (!reader->read(&buffer, 0, count, position, true, true))
+        {
+            juce::Logger::writeToLog("LoudnessMeter: read failed in " + file.getFullPathName());
+            return false;
+        }
+
+        meter.process(buffer, 0, count);
+        truePeak.process(buffer, 0, count);
+    }
+
+    result = meter.getResult();
+    result.truePeakDbtp = truePeak.getMaxTruePeak() > 0.0f
+                              ? static_cast<double>(juce::Decibels::gainToDecibels(truePeak.getMaxTruePeak()))
+                              : -std::numeric_limits<double>::infinity();
+    return true;
+}
+
+//==============================================================================
+void LoudnessMeter::Histogram::clear()
+{
+    counts.fill(0);
+    energies.fill(0.0);
+}
+
+int LoudnessMeter::Histogram::binFor(double lufs)
+{
+    return juce::jlimit(0, numBins - 1, static_cast<int>((lufs - minimumLufs) * binsPerLu));
+}
+
+void LoudnessMeter::Histogram::add(double meanSquare)
+{
+    auto lufs = toLufs(meanSquare);
+    if (lufs < minimumLufs)
+        return;
+
+    auto bin = static_cast<size_t>(binFor(lufs));
+    ++counts[bin];
+    energies[bin] += meanSquare;
+}
+
+double LoudnessMeter::Histogram::meanSquareAbove(double gateLufs) const
+{
+    if (!std::isfinite(gateLufs))
+        gateLufs = minimumLufs;
+
+    juce::uint64 count = 0;
+    double energy = 0.0;
+
+    for (auto bin = binFor(gateLufs); bin < numBins; ++bin)
+    {
+        count += counts[static_cast<size_t>(bin)];
+        energy += energies[static_cast<size_t>(bin)];
+    }
+
+    return count > 0 ? energy / static_cast<double>(count) : 0.0;
+}
+
+double LoudnessMeter::Histogram::percentileAbove(double gateLufs, double fraction) const
+{
+    if (!std::isfinite(gateLufs))
+        gateLufs = minimumLufs;
+
+    auto firstBin = binFor(gateLufs);
+    juce::uint64 total = 0;
+
+    for (auto bin = firstBin; bin < numBins; ++bin)
+        total += counts[static_cast<size_t>(bin)];
+
+    if (total == 0)
+        return minimumLufs;
+
+    auto target = static_cast<juce::uint64>(fraction * static_cast<double>(total - 1));
+    juce::uint64 seen = 0;
+
+    for (auto bin = firstBin; bin < numBins; ++bin)
+    {
+        seen += counts[static_cast<size_t>(bin)];
+
+        if (seen > target)
+            return minimumLufs + (bin + 0.5) / binsPerLu;
+    }
+
+    return minimumLufs + numBins / binsPerLu;
+}
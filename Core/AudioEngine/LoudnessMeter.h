@@ -0,0 +1,116 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+
+// ITU-R BS.1770-4 / EBU R128 loudness meter.
+//
+// Input is K-weighted per channel and its weighted mean square collected in
+// 100 ms steps. Momentary (400 ms) and short-term (3 s) loudness are running
+// sums over the last 4 and 30 steps. Every 400 ms block and every short-term
+// value also goes into a 0.1 LU histogram, from which integrated loudness
+// (absolute -70 LUFS and relative -10 LU gates) and loudness range (EBU Tech
+// 3342: -20 LU relative gate, 10th to 95th percentile) are derived without
+// keeping the programme's history.
+//
+// Channels are weighted by their type: surrounds +1.5 dB, LFE not at all.
+// An ambisonic layout is metered on its omnidirectional (W) channel alone.
+//
+// process() is real-time safe once prepare() has run; the getters may be
+// called from any thread.
+class LoudnessMeter
+{
+public:
+    struct Result
+    {
+        double integratedLufs = -std::numeric_limits<double>::infinity();
+        double loudnessRangeLu = 0.0;
+        double maxMomentaryLufs = -std::numeric_limits<double>::infinity();
+        double maxShortTermLufs = -std::numeric_limits<double>::infinity();
+        double truePeakDbtp = -std::numeric_limits<double>::infinity();   // analyseFile only
+    };
+
+    LoudnessMeter();
+    ~LoudnessMeter();
+
+    void prepare(double sampleRate, const juce::AudioChannelSet& layout);
+    void reset();
+
+    // Audio thread
+    void process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    float getMomentaryLufs() const { return momentaryLufs.load(std::memory_order_relaxed); }
+    float getShortTermLufs() const { return shortTermLufs.load(std::memory_order_relaxed); }
+    float getIntegratedLufs() const { return integratedLufs.load(std::memory_order_relaxed); }
+    float getLoudnessRange() const { return loudnessRange.load(std::memory_order_relaxed); }
+
+    Result getResult() const;
+
+    // Runs a file through a meter and a true-peak detector as fast as it can
+    // be read
+    static bool analyseFile(const juce::File& file, Result& result);
+
+
+private:
+    struct Biquad
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    };
+
+    struct ChannelState
+    {
+        double z1[2] {}, z2[2] {};  // one pair per filter stage
+        double weight = 1.0;
+    };
+
+    // Block loudness from -70 to +5 LUFS in 0.1 LU bins. Blocks below -70
+    // LUFS are dropped, which is the absolute gate.
+    struct Histogram
+    {
+        static constexpr double minimumLufs = -70.0;
+        static constexpr double binsPerLu = 10.0;
+        static constexpr int numBins = 750;
+
+        void clear();
+        void add(double meanSquare);
+
+        double meanSquareAbove(double gateLufs) const;
+        double percentileAbove(double gateLufs, double fraction) const;
+
+        static int binFor(double lufs);
+
+        std::array<juce::uint32, numBins> counts {};
+        std::array<double, numBins> energies {};
+    };
+
+    void endStep();
+    static double toLufs(double meanSquare);
+    static double weightFor(const juce::AudioChannelSet& layout, int channel);
+
+    Biquad preFilter, rlbFilter;
+    std::vector<ChannelState> channels;
+
+    int samplesPerStep = 4800;
+    int samplesInStep = 0;
+    double stepSum = 0.0;
+
+    static constexpr int stepsPerMomentary = 4;
+    static constexpr int stepsPerShortTerm = 30;
+    std::array<double, stepsPerShortTerm> stepEnergies {};
+    int stepIndex = 0;
+    juce::int64 stepsSeen = 0;
+    double momentarySum = 0.0;
+    double shortTermSum = 0.0;
+
+    Histogram blockHistogram, shortTermHistogram;
+    double maxMomentary = 0.0;
+    double maxShortTerm = 0.0;
+
+    std::atomic<float> momentaryLufs { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> shortTermLufs { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> integratedLufs { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> loudnessRange { 0.0f };
+    std::atomic<float> maxMomentaryLufs { -std::numeric_limits<float>::infinity() };
+    std::atomic<float> maxShortTermLufs { -std::numeric_limits<float>::infinity() };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessMeter)
+};
@@ -0,0 +1,903 @@
+#include "MediaPool.h"
+
+namespace
+{
+    constexpr int maxMediaChannels = 32;
+}
+
+//==============================================================================
+// Decodes the blocks every playing source is about to need
+class MediaPool::ReadAheadThread : public juce::Thread
+{
+public:
+    explicit ReadAheadThread(MediaPool& owner)
+        : juce::Thread("Media read-ahead"), pool(owner)
+    {
+    }
+
+    ~ReadAheadThread() override
+    {
+        stopThread(4000);
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            pool.readAhead();
+            wait(readAheadIntervalMs);
+        }
+    }
+
+private:
+    MediaPool& pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReadAheadThread)
+};
+
+MediaPool& MediaPool::getInstance()
+{
+    static MediaPool instance;
+    return instance;
+}
+
+MediaPool::MediaPool()
+{
+    formatManager.registerBasicFormats();
+}
+
+MediaPool::~MediaPool()
+{
+    readAheadThread.reset();
+    transcodePool.removeAllJobs(true, 5000);
+}
+
+juce::File MediaPool::getCacheDirectory() const
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("SignalForge")
+        .getChildFile("MediaCache");
+}
+
+//==============================================================================
+// Decodes a compressed file once into a float WAV that can be mapped. Reads
+// through its own reader so playback keeps streaming meanwhile.
+class MediaPool::Media::TranscodeJob : public juce::ThreadPoolJob
+{
+public:
+    TranscodeJob(MediaPool& owner, Media::Ptr mediaToTranscode, const juce::File& target)
+        : juce::ThreadPoolJob("Transcode " + mediaToTranscode->getFile().getFileName()),
+          pool(owner), media(std::move(mediaToTranscode)), cacheFile(target)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        if (transcode())
+        {
+            if (auto mapped = pool.createMappedReader(cacheFile))
+            {
+                media->installMappedReader(std::move(mapped));
+                juce::Logger::writeToLog("Transcoded to media cache: " + media->getFile().getFileName());
+            }
+        }
+
+        return jobHasFinished;
+    }
+
+private:
+    bool transcode()
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(pool.formatManager.createReaderFor(media->getFile()));
+        if (reader == nullptr)
+            return false;
+
+        cacheFile.getParentDirectory().createDirectory();
+
+        // Written next to the target and moved into place, so a half-written
+        // file is never mapped
+        juce::TemporaryFile temp(cacheFile);
+        juce::WavAudioFormat wav;
+
+        {
+            std::unique_ptr<juce::OutputStream> stream(temp.getFile().createOutputStream());
+            if (stream == nullptr)
+                return false;
+
+            std::unique_ptr<juce::AudioFormatWriter> writer(
+                wav.createWriterFor(stream.get(), reader->sampleRate,
+                                    static_cast<unsigned int>(media->getNumChannels()), 32, {}, 0));
+            if (writer == nullptr)
+                return false;
+
+            stream.release(); // owned by the writer now
+
+            constexpr int chunkSize = 65536;
+            juce::AudioBuffer<float> chunk(media->getNumChannels(), chunkSize);
+
+            for (juce::int64 position = 0; position < reader->lengthInSamples; position += chunkSize)
+            {
+                if (shouldExit())
+                    return false;
+
+                auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(chunkSize),
+                                                              reader->lengthInSamples - position));
+
+                reader->read(chunk.getArrayOfWritePointers(), chunk.getNumChannels(), position, numSamples);
+
+                if (!writer->writeFromAudioSampleBuffer(chunk, 0, numSamples))
+                    return false;
+            }
+        }
+
+        return temp.overwriteTargetFileWithTemporary();
+    }
+
+    MediaPool& pool;
+    Media::Ptr media;
+    juce::File cacheFile;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TranscodeJob)
+};
+
+//==============================================================================
+// Offline pass of a Source through the sinc resampler into a float WAV
+class MediaPool::ResampleJob : public juce::ThreadPoolJob
+{
+public:
+    ResampleJob(MediaPool& owner, std::unique_ptr<Source> sourceToRender, double targetRate,
+                SincResampler::Quality qualityToUse, SourceCallback callback)
+        : juce::ThreadPoolJob("Resample " + sourceToRender->getMedia().getFile().getFileName()),
+          pool(owner), source(std::move(sourceToRender)), sampleRate(targetRate),
+          quality(qualityToUse), onReady(std::move(callback))
+    {
+        source->setNonRealtime(true);
+    }
+
+    JobStatus runJob() override
+    {
+        // Renders are kept by content, so an earlier one of the same audio
+        // is found whatever the file is called now
+        auto hash = pool.getContentHash(source->getMedia().getFile());
+        auto rendered = false;
+
+        if (hash.isNotEmpty())
+        {
+            cacheFile = pool.getCacheDirectory().getChildFile(hash + "-" + juce::String(juce::roundToInt(sampleRate))
+                                                              + "-q" + juce::String(static_cast<int>(quality)) + ".wav");
+            rendered = cacheFile.existsAsFile() || render();
+        }
+
+        auto file = cacheFile;
+        auto callback = onReady;
+        auto* owner = &pool;
+
+        juce::MessageManager::callAsync([owner, rendered, file, callback]
+        {
+            callback(rendered ? owner->createSource(file) : nullptr);
+        });
+
+        return jobHasFinished;
+    }
+
+private:
+    bool render()
+    {
+        const auto& media = source->getMedia();
+        constexpr int chunkSize = 8192;
+
+        SincResamplingSource resampled(source.get(), media.getSampleRate(), media.getNumChannels());
+        resampled.setQuality(quality);
+        resampled.prepareToPlay(chunkSize, sampleRate);
+        resampled.setNextReadPosition(0);
+
+        cacheFile.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp(cacheFile);
+        juce::WavAudioFormat wav;
+
+        {
+            std::unique_ptr<juce::OutputStream> stream(temp.getFile().createOutputStream());
+            if (stream == nullptr)
+                return false;
+
+            std::unique_ptr<juce::AudioFormatWriter> writer(
+                wav.createWriterFor(stream.get(), sampleRate,
+                                    static_cast<unsigned int>(media.getNumChannels()), 32, {}, 0));
+            if (writer == nullptr)
+                return false;
+
+            stream.release();
+
+            juce::AudioBuffer<float> chunk(media.getNumChannels(), chunkSize);
+            auto length = resampled.getTotalLength();
+
+            for (juce::int64 position = 0; position < length; position += chunkSize)
+            {
+                if (shouldExit())
+                    return false;
+
+                auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(chunkSize), length - position));
+                juce::AudioSourceChannelInfo info(&chunk, 0, numSamples);
+                resampled.getNextAudioBlock(info);
+
+                if (!writer->writeFromAudioSampleBuffer(chunk, 0, numSamples))
+                    return false;
+            }
+        }
+
+        return temp.overwriteTargetFileWithTemporary();
+    }
+
+    MediaPool& pool;
+    std::unique_ptr<Source> source;
+    double sampleRate;
+    SincResampler::Quality quality;
+    juce::File cacheFile;
+    SourceCallback onReady;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResampleJob)
+};
+
+//==============================================================================
+// Works out a file's content hash and re-keys its media once it is known
+class MediaPool::HashJob : public juce::ThreadPoolJob
+{
+public:
+    HashJob(MediaPool& owner, Media::Ptr mediaToHash)
+        : juce::ThreadPoolJob("Hash " + mediaToHash->getFile().getFileName()),
+          pool(owner), media(std::move(mediaToHash))
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        auto hash = pool.getContentHash(media->getFile());
+
+        if (hash.isNotEmpty())
+            pool.adoptContentHash(media, hash);
+
+        return jobHasFinished;
+    }
+
+private:
+    MediaPool& pool;
+    Media::Ptr media;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HashJob)
+};
+
+void MediaPool::renderResampledAsync(const juce::File& file, double sampleRate, SincResampler::Quality quality,
+                                     SourceCallback onReady)
+{
+    auto source = createSource(file);
+    if (source == nullptr || sampleRate <= 0.0)
+    {
+        juce::MessageManager::callAsync([onReady] { onReady(nullptr); });
+        return;
+    }
+
+    transcodePool.addJob(new ResampleJob(*this, std::move(source), sampleRate, quality, std::move(onReady)), true);
+}
+
+std::unique_ptr<MediaPool::Source> MediaPool::createSource(const juce::File& file)
+{
+    if (!file.existsAsFile())
+        return nullptr;
+
+    const juce::ScopedLock sl(mediaLock);
+    purgeUnusedMedia();
+
+    // Hashing reads the whole file, so one not seen before is opened under
+    // a provisional key and hashed in the background
+    auto hash = findCachedHash(file);
+    auto key = hash.isNotEmpty() ? hash : getProvisionalKey(file);
+
+    Media::Ptr media;
+    auto existing = mediaByHash.find(key);
+
+    if (existing != mediaByHash.end())
+    {
+        media = existing->second;
+    }
+    else
+    {
+        media = openMedia(file, key, hash.isNotEmpty());
+        if (media == nullptr)
+            return nullptr;
+
+        mediaByHash[key] = media;
+
+        if (hash.isEmpty())
+            transcodePool.addJob(new HashJob(*this, media), true);
+    }
+
+    if (readAheadThread == nullptr)
+    {
+        readAheadThread = std::make_unique<ReadAheadThread>(*this);
+        readAheadThread->startThread(juce::Thread::Priority::high);
+    }
+
+    return std::unique_ptr<Source>(new Source(*this, media));
+}
+
+juce::String MediaPool::getContentHash(const juce::File& file)
+{
+    {
+        const juce::ScopedLock sl(mediaLock);
+        auto cached = findCachedHash(file);
+        if (cached.isNotEmpty())
+            return cached;
+    }
+
+    auto size = file.getSize();
+    auto modified = file.getLastModificationTime();
+
+    juce::FileInputStream input(file);
+    if (!input.openedOk())
+        return {};
+
+    // Every byte counts: takes that differ anywhere must not share media.
+    // Paid once per file version thanks to the cache.
+    auto hash = juce::SHA256(input).toHexString();
+
+    {
+        const juce::ScopedLock sl(mediaLock);
+        hashesByPath[file.getFullPathName()] = { modified, size, hash };
+    }
+
+    saveHashCache();
+    return hash;
+}
+
+juce::String MediaPool::findCachedHash(const juce::File& file)
+{
+    // Called with mediaLock held
+    loadHashCache();
+
+    auto cached = hashesByPath.find(file.getFullPathName());
+    if (cached != hashesByPath.end() && cached->second.size == file.getSize()
+        && cached->second.modified == file.getLastModificationTime())
+        return cached->second.hash;
+
+    return {};
+}
+
+juce::String MediaPool::getProvisionalKey(const juce::File& file)
+{
+    return "unhashed:" + file.getFullPathName() + ":" + juce::String(file.getSize())
+           + ":" + juce::String(file.getLastModificationTime().toMilliseconds());
+}
+
+void MediaPool::adoptContentHash(Media::Ptr media, const juce::String& hash)
+{
+    {
+        const juce::ScopedLock sl(mediaLock);
+        auto provisional = mediaByHash.find(media->key);
+
+        // If the same audio was opened under its hash meanwhile, both stay
+        // open; sources created from now on find the hashed one
+        if (provisional != mediaByHash.end() && provisional->second == media
+            && mediaByHash.find(hash) == mediaByHash.end())
+        {
+            mediaByHash.erase(provisional);
+            media->key = hash;
+            mediaByHash[hash] = media;
+        }
+    }
+
+    // A compressed file streams until its transcode, which is kept by hash
+    if (!media->isMemoryMapped())
+        mapOrTranscode(media, hash);
+}
+
+juce::File MediaPool::getHashCacheFile() const
+{
+    return getCacheDirectory().getChildFile("ContentHashes.xml");
+}
+
+void MediaPool::loadHashCache()
+{
+    // Called with mediaLock held
+    if (hashCacheLoaded)
+        return;
+
+    hashCacheLoaded = true;
+
+    if (auto xml = juce::parseXML(getHashCacheFile()))
+    {
+        for (auto* entry : xml->getChildWithTagNameIterator("FILE"))
+        {
+            hashesByPath[entry->getStringAttribute("path")] = {
+                juce::Time(entry->getStringAttribute("modified").getLargeIntValue()),
+                entry->getStringAttribute("size").getLargeIntValue(),
+                entry->getStringAttribute("hash")
+            };
+        }
+    }
+}
+
+void MediaPool::saveHashCache()
+{
+    juce::XmlElement xml("CONTENTHASHES");
+
+    {
+        const juce::ScopedLock sl(mediaLock);
+
+        for (auto& [path, entry] : hashesByPath)
+        {
+            auto* element = xml.createNewChildElement("FILE");
+            element->setAttribute("path", path);
+            element->setAttribute("size", juce::String(entry.size));
+            element->setAttribute("modified", juce::String(entry.modified.toMilliseconds()));
+            element->setAttribute("hash", entry.hash);
+        }
+    }
+
+    const juce::ScopedLock sl(hashFileLock);
+    auto cacheFile = getHashCacheFile();
+    cacheFile.getParentDirectory().createDirectory();
+
+    if (!xml.writeTo(cacheFile))
+        juce::Logger::writeToLog("MediaPool: failed to write " + cacheFile.getFullPathName());
+}
+
+MediaPool::Media::Ptr MediaPool::openMedia(const juce::File& file, const juce::String& key, bool keyIsHash)
+{
+    Media::Ptr media = new Media();
+    media->reader.reset(formatManager.createReaderFor(file));
+
+    if (media->reader == nullptr)
+    {
+        juce::Logger::writeToLog("Unsupported audio file: " + file.getFullPathName());
+        return nullptr;
+    }
+
+    media->key = key;
+    media->file = file;
+    media->id = nextMediaId++;
+    media->sampleRate = media->reader->sampleRate;
+    media->numChannels = juce::jlimit(1, maxMediaChannels, static_cast<int>(media->reader->numChannels));
+    media->lengthInSamples = media->reader->lengthInSamples;
+    media->framesPerBlock = blockCapacity / media->numChannels;
+
+    // Uncompressed formats are mapped, so reads are plain memory copies that
+    // need no lock and the OS shares the pages between all users of the file.
+    // Anything else is mapped from its transcoded copy once that exists,
+    // which is looked for as soon as the hash is known.
+    if (auto mapped = createMappedReader(file))
+        media->installMappedReader(std::move(mapped));
+    else if (keyIsHash)
+        mapOrTranscode(media, key);
+
+    return media;
+}
+
+void MediaPool::mapOrTranscode(Media::Ptr media, const juce::String& hash)
+{
+    auto cacheFile = getCacheDirectory().getChildFile(hash + ".wav");
+    auto cached = cacheFile.existsAsFile() ? createMappedReader(cacheFile) : nullptr;
+
+    if (cached != nullptr && cached->lengthInSamples == media->lengthInSamples)
+        media->installMappedReader(std::move(cached));
+    else
+        transcodePool.addJob(new Media::TranscodeJob(*this, std::move(media), cacheFile), true);
+}
+
+std::unique_ptr<juce::MemoryMappedAudioFormatReader> MediaPool::createMappedReader(const juce::File& file)
+{
+    auto* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+    if (format == nullptr)
+        return nullptr;
+
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(format->createMemoryMappedReader(file));
+    if (mapped == nullptr || !mapped->mapEntireFile())
+        return nullptr;
+
+    return mapped;
+}
+
+void MediaPool::purgeUnusedMedia()
+{
+    // Called with mediaLock held
+    juce::Array<int> purgedIds;
+
+    for (auto it = mediaByHash.begin(); it != mediaByHash.end();)
+    {
+        if (it->second->getReferenceCount() == 1)
+        {
+            purgedIds.add(it->second->id);
+            it = mediaByHash.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (purgedIds.isEmpty())
+        return;
+
+    const juce::ScopedLock sl(cacheLock);
+
+    for (auto it = lru.begin(); it != lru.end();)
+    {
+        if (purgedIds.contains(static_cast<int>((*it)->key >> 40)))
+        {
+            blocksByKey.erase((*it)->key);
+            freeBlocks.splice(freeBlocks.end(), lru, it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void MediaPool::setCacheBudget(size_t maxBytes)
+{
+    std::list<Block::Ptr> released;
+
+    {
+        const juce::ScopedLock sl(cacheLock);
+        cacheBudget = juce::jmax(blockBytes, maxBytes);
+        evictToBudget(released);
+    }
+
+    // Shrinking frees memory here, on the caller's thread, outside the lock
+    released.clear();
+}
+
+size_t MediaPool::getCachedBytes() const
+{
+    const juce::ScopedLock sl(cacheLock);
+    return numBlocks * blockBytes;
+}
+
+int MediaPool::getNumMedia() const
+{
+    const juce::ScopedLock sl(mediaLock);
+    return static_cast<int>(mediaByHash.size());
+}
+
+//==============================================================================
+MediaPool::Block::Ptr MediaPool::getBlock(Media& media, juce::int64 blockIndex)
+{
+    auto key = makeKey(media.id, blockIndex);
+
+    {
+        const juce::ScopedLock sl(cacheLock);
+        auto found = blocksByKey.find(key);
+
+        if (found != blocksByKey.end())
+        {
+            lru.splice(lru.begin(), lru, found->second);
+            return *found->second;
+        }
+    }
+
+    auto block = acquireFreeBlock();
+    if (block == nullptr)
+        return nullptr;
+
+    block->key = key;
+    block->numChannels = media.numChannels;
+    block->numFrames = media.framesPerBlock;
+
+    float* channels[maxMediaChannels];
+    for (int channel = 0; channel < block->numChannels; ++channel)
+        channels[channel] = block->samples.get() + channel * block->numFrames;
+
+    media.readBlock(blockIndex, channels, block->numFrames);
+
+    // The list node is made here and spliced in, so the lock isn't held
+    // across an allocation
+    std::list<Block::Ptr> node { block };
+    const juce::ScopedLock sl(cacheLock);
+
+    // Another reader may have decoded the same block meanwhile
+    auto found = blocksByKey.find(key);
+    if (found != blocksByKey.end())
+    {
+        freeBlocks.splice(freeBlocks.end(), node);
+        lru.splice(lru.begin(), lru, found->second);
+        return *found->second;
+    }
+
+    lru.splice(lru.begin(), node);
+    blocksByKey[key] = lru.begin();
+    return block;
+}
+
+//==============================================================================
+struct MediaPool::Source::ReadAhead
+{
+    int numBlocks = 0;
+    std::array<juce::int64, readAheadBlocks> blockIndices {};
+    std::array<Block::Ptr, readAheadBlocks> blocks;
+
+    Block* find(juce::int64 blockIndex) const
+    {
+        for (int i = 0; i < numBlocks; ++i)
+            if (blockIndices[static_cast<size_t>(i)] == blockIndex)
+                return blocks[static_cast<size_t>(i)].get();
+
+        return nullptr;
+    }
+};
+
+void MediaPool::readAhead()
+{
+    // Held throughout, so that no source can go while blocks are pinned
+    // into it; a source being destroyed waits for at most one pass
+    const juce::ScopedLock sl(sourcesLock);
+
+    for (auto* source : sources)
+        if (!source->isNonRealtime())
+            pinBlocksAhead(*source);
+}
+
+void MediaPool::pinBlocksAhead(Source& source)
+{
+    auto& media = *source.media;
+    auto length = media.getLengthInSamples();
+    auto framesPerBlock = media.getFramesPerBlock();
+    auto numMediaBlocks = (length + framesPerBlock - 1) / framesPerBlock;
+    auto looping = source.isLooping();
+    auto position = source.getNextReadPosition();
+
+    if (numMediaBlocks == 0)
+        return;
+
+    if (position >= length && looping)
+        position %= length;
+
+    auto next = std::make_unique<Source::ReadAhead>();
+
+    for (int i = 0; i < readAheadBlocks; ++i)
+    {
+        auto blockIndex = position / framesPerBlock + i;
+
+        if (blockIndex >= numMediaBlocks)
+        {
+            if (!looping)
+                break;
+
+            blockIndex %= numMediaBlocks;
+        }
+
+        next->blockIndices[static_cast<size_t>(next->numBlocks++)] = blockIndex;
+    }
+
+    // Nothing to do while the source is still inside what it has pinned
+    auto* current = source.currentReadAhead.load();
+    auto unchanged = current != nullptr && current->numBlocks == next->numBlocks;
+
+    for (int i = 0; unchanged && i < next->numBlocks; ++i)
+        unchanged = current->blockIndices[static_cast<size_t>(i)] == next->blockIndices[static_cast<size_t>(i)]
+                    && current->blocks[static_cast<size_t>(i)] != nullptr;
+
+    if (unchanged)
+        return;
+
+    // Blocks pinned already are carried over; only the new ones are decoded
+    for (int i = 0; i < next->numBlocks; ++i)
+    {
+        auto blockIndex = next->blockIndices[static_cast<size_t>(i)];
+        auto& block = next->blocks[static_cast<size_t>(i)];
+
+        if (current != nullptr)
+            block = current->find(blockIndex);
+
+        if (block == nullptr)
+            block = getBlock(media, blockIndex);
+    }
+
+    source.publishReadAhead(std::move(next));
+}
+
+void MediaPool::addSource(Source& source)
+{
+    const juce::ScopedLock sl(sourcesLock);
+    sources.add(&source);
+}
+
+void MediaPool::removeSource(Source& source)
+{
+    const juce::ScopedLock sl(sourcesLock);
+    sources.removeFirstMatchingValue(&source);
+}
+
+MediaPool::Block::Ptr MediaPool::acquireFreeBlock()
+{
+    std::list<Block::Ptr> taken;
+    auto allocate = false;
+
+    {
+        const juce::ScopedLock sl(cacheLock);
+
+        if (freeBlocks.empty())
+        {
+            if ((numBlocks + 1) * blockBytes <= cacheBudget)
+            {
+                // Counted now, allocated below once the lock is released
+                ++numBlocks;
+                allocate = true;
+            }
+            else
+            {
+                // At budget: reuse the least recently used block nobody is reading
+                for (auto it = lru.rbegin(); it != lru.rend(); ++it)
+                {
+                    if ((*it)->getReferenceCount() == 1)
+                    {
+                        blocksByKey.erase((*it)->key);
+                        freeBlocks.splice(freeBlocks.end(), lru, std::next(it).base());
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Otherwise every cached block is in use by a reader
+        if (!allocate && !freeBlocks.empty())
+            taken.splice(taken.end(), freeBlocks, freeBlocks.begin());
+    }
+
+    if (allocate)
+    {
+        Block::Ptr block = new Block();
+        block->samples.malloc(blockCapacity);
+        return block;
+    }
+
+    return taken.empty() ? nullptr : taken.front();
+}
+
+void MediaPool::evictToBudget(std::list<Block::Ptr>& released)
+{
+    // Called with cacheLock held; the caller frees what ends up in released
+    // after letting go of it. Blocks still referenced by a reader stay put;
+    // they become evictable as soon as it moves on.
+    while (numBlocks * blockBytes > cacheBudget && !freeBlocks.empty())
+    {
+        released.splice(released.end(), freeBlocks, freeBlocks.begin());
+        --numBlocks;
+    }
+
+    auto it = lru.end();
+
+    while (numBlocks * blockBytes > cacheBudget && it != lru.begin())
+    {
+        --it;
+
+        if ((*it)->getReferenceCount() == 1)
+        {
+            blocksByKey.erase((*it)->key);
+            released.splice(released.end(), lru, it++);
+            --numBlocks;
+        }
+    }
+}
+
+//==============================================================================
+bool MediaPool::Media::readBlock(juce::int64 blockIndex, float* const* destChannels, int numFrames)
+{
+    auto startSample = blockIndex * framesPerBlock;
+
+    // Reads past the end of the file come back as silence
+    if (auto* mapped = mappedReader.load())
+        return mapped->read(destChannels, numChannels, startSample, numFrames);
+
+    const juce::ScopedLock sl(readerLock);
+    return reader->read(destChannels, numChannels, startSample, numFrames);
+}
+
+void MediaPool::Media::installMappedReader(std::unique_ptr<juce::MemoryMappedAudioFormatReader> newReader)
+{
+    // Installed at most once, and kept until the Media itself goes, so a
+    // reader that just loaded the pointer can never see it freed. Blocks
+    // already decoded from the stream stay valid: the data is identical.
+    jassert(mappedOwner == nullptr);
+    mappedOwner = std::move(newReader);
+    mappedReader = mappedOwner.get();
+}
+
+//==============================================================================
+MediaPool::Source::Source(MediaPool& owner, Media::Ptr mediaToPlay)
+    : pool(owner), media(std::move(mediaToPlay))
+{
+    pool.addSource(*this);
+}
+
+MediaPool::Source::~Source()
+{
+    // Once removed, the read-ahead thread can't be publishing into it
+    pool.removeSource(*this);
+    currentReadAhead = nullptr;
+    releasePool.releaseAll();
+}
+
+void MediaPool::Source::publishReadAhead(std::unique_ptr<ReadAhead> next)
+{
+    currentReadAhead = next.get();
+    releasePool.retire(std::move(ownedReadAhead));
+    ownedReadAhead = std::move(next);
+}
+
+void MediaPool::Source::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    juce::ignoreUnused(samplesPerBlockExpected, sampleRate);
+}
+
+void MediaPool::Source::releaseResources()
+{
+}
+
+void MediaPool::Source::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    auto& buffer = *bufferToFill.buffer;
+    auto length = media->getLengthInSamples();
+    auto framesPerBlock = media->getFramesPerBlock();
+    auto mediaChannels = media->getNumChannels();
+
+    auto readPosition = position.load();
+    int done = 0;
+
+    releasePool.beginAudioBlock();
+    auto* pinned = currentReadAhead.load();
+
+    while (done < bufferToFill.numSamples)
+    {
+        if (readPosition >= length)
+        {
+            if (!looping || length == 0)
+            {
+                buffer.clear(bufferToFill.startSample + done, bufferToFill.numSamples - done);
+                readPosition += bufferToFill.numSamples - done;
+                break;
+            }
+
+            readPosition %= length;
+        }
+
+        auto blockIndex = readPosition / framesPerBlock;
+        auto offset = static_cast<int>(readPosition % framesPerBlock);
+        auto numFrames = static_cast<int>(juce::jmin(static_cast<juce::int64>(bufferToFill.numSamples - done),
+                                                     static_cast<juce::int64>(framesPerBlock - offset),
+                                                     length - readPosition));
+
+        auto destStart = bufferToFill.startSample + done;
+        auto copied = false;
+
+        if (nonRealtime)
+        {
+            if (auto block = pool.getBlock(*media, blockIndex))
+            {
+                // Mono media feeds every output channel
+                for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                    buffer.copyFrom(channel, destStart, block->getChannel(channel % mediaChannels) + offset, numFrames);
+
+                copied = true;
+            }
+        }
+        else if (const auto* block = pinned != nullptr ? pinned->find(blockIndex) : nullptr)
+        {
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                buffer.copyFrom(channel, destStart, block->getChannel(channel % mediaChannels) + offset, numFrames);
+
+            copied = true;
+        }
+
+        // A miss (after a seek, or a cache too small) is heard as a gap; the
+        // read-ahead thread fills it in moments
+
+        if (!copied)
+            buffer.clear(destStart, numFrames);
+
+        done += numFrames;
+        readPosition += numFrames;
+    }
+
+    releasePool.endAudioBlock();
+    position = readPosition;
+}
@@ -0,0 +1,226 @@
+#pragma once
+#include <JuceHeader.h>
+#include "SincResampler.h"
+#include "DeferredReleasePool.h"
+
+// Project-wide store for audio media.
+//
+// Files are keyed by a hash of their contents, so the same sample referenced
+// by many tracks (or copied under a different name) is opened once: one
+// reader, memory-mapped where the format allows it. Hashes are worked out in
+// the background and remembered in the media cache between sessions; until a
+// file's is known it is opened under its path, size and modification time. Decoded audio is shared
+// through a block cache with LRU eviction under a memory budget, so memory
+// follows the amount of unique audio being played rather than the number of
+// tracks.
+//
+// A read-ahead thread decodes the blocks ahead of every playing source and
+// pins them into the source, which on the audio thread only copies from what
+// is pinned and outputs silence for anything else. It never takes the cache
+// lock, and blocks are only allocated or freed outside it.
+//
+// Compressed files (MP3, Ogg, FLAC, ...) are transcoded in the background to
+// a float WAV in the media cache, keyed by content hash, and switched over to
+// a mapped reader once ready; until then they stream through the decoder.
+class MediaPool
+{
+public:
+    class Media;
+    class Source;
+
+    static MediaPool& getInstance();
+
+    // Message thread. Returns nullptr if the file can't be read.
+    std::unique_ptr<Source> createSource(const juce::File& file);
+
+    // SHA-256 of the whole file, cached per path, size and modification time
+    // and saved in the media cache. Reads every byte when it isn't cached, so
+    // keep it off the message thread.
+    juce::String getContentHash(const juce::File& file);
+
+    // Where transcoded media is kept between sessions
+    juce::File getCacheDirectory() const;
+
+    // Sample-rate conversion ahead of time: renders the file at sampleRate
+    // into the cache in the background (or finds an earlier render) and hands
+    // a Source for it to onReady on the message thread, nullptr on failure.
+    // Playing that needs no resampling at all.
+    using SourceCallback = std::function<void(std::unique_ptr<Source>)>;
+    void renderResampledAsync(const juce::File& file, double sampleRate, SincResampler::Quality quality,
+                              SourceCallback onReady);
+    void setPreRenderResampling(bool shouldPreRender) { preRenderResampling = shouldPreRender; }
+    bool isPreRenderResampling() const { return preRenderResampling; }
+
+    void setCacheBudget(size_t maxBytes);
+    size_t getCacheBudget() const { return cacheBudget; }
+    size_t getCachedBytes() const;
+    int getNumMedia() const;
+
+    //==============================================================================
+    // One per unique content hash, shared by every Source playing it
+    class Media : public juce::ReferenceCountedObject
+    {
+    public:
+        using Ptr = juce::ReferenceCountedObjectPtr<Media>;
+
+        const juce::File& getFile() const { return file; }
+        double getSampleRate() const { return sampleRate; }
+        int getNumChannels() const { return numChannels; }
+        juce::int64 getLengthInSamples() const { return lengthInSamples; }
+        int getFramesPerBlock() const { return framesPerBlock; }
+        bool isMemoryMapped() const { return mappedReader.load() != nullptr; }
+
+    private:
+        friend class MediaPool;
+        class TranscodeJob;
+
+        void installMappedReader(std::unique_ptr<juce::MemoryMappedAudioFormatReader> newReader);
+
+        bool readBlock(juce::int64 blockIndex, float* const* destChannels, int numFrames);
+
+        juce::String key;   // content hash, or provisional until known (under mediaLock)
+        juce::File file;
+        int id = 0;
+        double sampleRate = 0.0;
+        int numChannels = 0;
+        juce::int64 lengthInSamples = 0;
+        int framesPerBlock = 0;
+
+        // Streaming reader, used under the lock until a mapping is available
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        juce::CriticalSection readerLock;
+
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedOwner;
+        std::atomic<juce::MemoryMappedAudioFormatReader*> mappedReader { nullptr };
+    };
+
+    //==============================================================================
+    // Per-track playback cursor over a shared Media
+    class Source : public juce::PositionableAudioSource
+    {
+    public:
+        ~Source() override;
+
+        const Media& getMedia() const { return *media; }
+
+        void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+        void releaseResources() override;
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+        void setNextReadPosition(juce::int64 newPosition) override { position = newPosition; }
+        juce::int64 getNextReadPosition() const override { return position; }
+        juce::int64 getTotalLength() const override { return media->getLengthInSamples(); }
+        bool isLooping() const override { return looping; }
+        void setLooping(bool shouldLoop) override { looping = shouldLoop; }
+
+        // For renders off the audio thread: missing blocks are decoded on the
+        // spot instead of coming out as silence
+        void setNonRealtime(bool isNonRealtime) { nonRealtime = isNonRealtime; }
+        bool isNonRealtime() const { return nonRealtime; }
+
+    private:
+        friend class MediaPool;
+        Source(MediaPool& owner, Media::Ptr media);
+
+        // The blocks from the read position on, published by the read-ahead
+        // thread and retired through the release pool
+        struct ReadAhead;
+        void publishReadAhead(std::unique_ptr<ReadAhead> next);
+
+        MediaPool& pool;
+        Media::Ptr media;
+        std::atomic<juce::int64> position { 0 };
+        std::atomic<bool> looping { false };
+        std::atomic<bool> nonRealtime { false };
+
+        std::unique_ptr<ReadAhead> ownedReadAhead;
+        std::atomic<ReadAhead*> currentReadAhead { nullptr };
+        DeferredReleasePool releasePool;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Source)
+    };
+
+private:
+    MediaPool();
+    ~MediaPool();
+
+    // Fixed-capacity decoded block; recycled rather than freed, and never
+    // reused while anything still holds a reference to it
+    struct Block : public juce::ReferenceCountedObject
+    {
+        using Ptr = juce::ReferenceCountedObjectPtr<Block>;
+
+        juce::HeapBlock<float> samples;
+        int numChannels = 0;
+        int numFrames = 0;
+        juce::uint64 key = 0;
+
+        const float* getChannel(int channel) const { return samples.get() + channel * numFrames; }
+    };
+
+    Block::Ptr getBlock(Media& media, juce::int64 blockIndex);
+
+    class ReadAheadThread;
+    void readAhead();
+    void pinBlocksAhead(Source& source);
+    void addSource(Source& source);
+    void removeSource(Source& source);
+
+    Block::Ptr acquireFreeBlock();
+    void evictToBudget(std::list<Block::Ptr>& released);
+    void purgeUnusedMedia();
+    Media::Ptr openMedia(const juce::File& file, const juce::String& key, bool keyIsHash);
+    void mapOrTranscode(Media::Ptr media, const juce::String& hash);
+
+    // Content hashes: looked up with mediaLock held, worked out by a HashJob
+    class HashJob;
+    juce::String findCachedHash(const juce::File& file);
+    void adoptContentHash(Media::Ptr media, const juce::String& hash);
+    static juce::String getProvisionalKey(const juce::File& file);
+    juce::File getHashCacheFile() const;
+    void loadHashCache();
+    void saveHashCache();
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> createMappedReader(const juce::File& file);
+
+    class ResampleJob;
+
+    static juce::uint64 makeKey(int mediaId, juce::int64 blockIndex)
+    {
+        return (static_cast<juce::uint64>(mediaId) << 40) | static_cast<juce::uint64>(blockIndex);
+    }
+
+    // Each block holds this many samples across all channels
+    static constexpr int blockCapacity = 64 * 1024;
+    static constexpr size_t blockBytes = blockCapacity * sizeof(float);
+
+    // Blocks kept decoded from each source's position on
+    static constexpr int readAheadBlocks = 3;
+    static constexpr int readAheadIntervalMs = 5;
+
+    juce::AudioFormatManager formatManager;
+    juce::ThreadPool transcodePool { 2 };
+    std::atomic<bool> preRenderResampling { false };
+
+    mutable juce::CriticalSection mediaLock;
+    std::map<juce::String, Media::Ptr> mediaByHash;
+    struct HashEntry { juce::Time modified; juce::int64 size; juce::String hash; };
+    std::map<juce::String, HashEntry> hashesByPath;
+    bool hashCacheLoaded = false;
+    juce::CriticalSection hashFileLock;
+    int nextMediaId = 1;
+
+    // Block cache: most recently used at the front. Blocks move between the
+    // lists by splicing, so nothing is allocated or freed under the lock.
+    mutable juce::CriticalSection cacheLock;
+    std::list<Block::Ptr> lru;
+    std::unordered_map<juce::uint64, std::list<Block::Ptr>::iterator> blocksByKey;
+    std::list<Block::Ptr> freeBlocks;
+    size_t numBlocks = 0;   // cached, free or being decoded
+    size_t cacheBudget = 256 * 1024 * 1024;
+
+    juce::CriticalSection sourcesLock;
+    juce::Array<Source*> sources;
+    std::unique_ptr<ReadAheadThread> readAheadThread;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MediaPool)
+};
@@ -1,8 +1,12 @@
 #include "Meter.h"
+#include "MeterKernels.h"
 #include <cmath> // For std::sqrt
 
+static_assert((Meter::historySize & (Meter::historySize - 1)) == 0, "historySize must be a power of two");
+
 Meter::Meter(juce::AudioSource* inputSource)
-    : input(inputSource)
+    : input(inputSource),
+      slots(std::make_unique<Slot[]>(historySize))
 {
 }
 
@@ -12,98 +16,180 @@ Meter::~Meter()
 
 void Meter::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
-    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+    if (input != nullptr)
+        input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+    currentSampleRate.store(sampleRate, std::memory_order_relaxed);
+}
+
+void Meter::releaseResources()
+{
+    if (input != nullptr)
+        input->releaseResources();
+}
+
+void Meter::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    if (input != nullptr)
+        input->getNextAudioBlock(bufferToFill);
+
+    process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+}
+
+void Meter::process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    int numChannels = juce::jmin(buffer.getNumChannels(), maxChannels);
 
-    int numChannels = 2; // Default to stereo, will adjust in getNextAudioBlock
+    const float* channelData[maxChannels];
+    MeterKernels::Levels levels[maxChannels];
 
-    peaks.clear();
-    rmsValues.clear();
-    rmsSums.clear();
-    rmsCounts.clear();
+    for (int channel = 0; channel < numChannels; ++channel)
+        channelData[channel] = buffer.getReadPointer(channel, startSample);
+
+    MeterKernels::measure(channelData, numChannels, numSamples, levels);
+
+    // Single writer: mark the slot as being written, fill it, then publish
+    auto frameIndex = framesWritten.load(std::memory_order_relaxed);
+    auto& slot = slots[static_cast<size_t>(frameIndex & (historySize - 1))];
+    auto sequence = static_cast<juce::uint64>(frameIndex) * 2;
+
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
 
-    for (int i = 0; i < numChannels; ++i)
+    slot.numChannels.store(numChannels, std::memory_order_relaxed);
+    slot.numSamples.store(numSamples, std::memory_order_relaxed);
+
+    for (int channel = 0; channel < numChannels; ++channel)
     {
-        peaks.push_back(std::make_unique<std::atomic<float>>(0.0f));
-        rmsValues.push_back(std::make_unique<std::atomic<float>>(0.0f));
-        rmsSums.push_back(0.0f);
-        rmsCounts.push_back(0);
+        slot.peak[channel].store(levels[channel].peak, std::memory_order_relaxed);
+        slot.sumOfSquares[channel].store(levels[channel].sumOfSquares, std::memory_order_relaxed);
     }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    framesWritten.store(frameIndex + 1, std::memory_order_release);
 }
 
-void Meter::releaseResources()
+bool Meter::readFrame(juce::int64 frameIndex, Frame& destination) const
+{
+    if (frameIndex < 0)
+        return false;
+
+    const auto& slot = slots[static_cast<size_t>(frameIndex & (historySize - 1))];
+    auto expected = static_cast<juce::uint64>(frameIndex) * 2 + 2;
+
+    // Not written yet, being overwritten, or already replaced
+    if (slot.sequence.load(std::memory_order_acquire) != expected)
+        return false;
+
+    destination.numChannels = slot.numChannels.load(std::memory_order_relaxed);
+    destination.numSamples = slot.numSamples.load(std::memory_order_relaxed);
+
+    for (int channel = 0; channel < destination.numChannels; ++channel)
+    {
+        destination.peak[channel] = slot.peak[channel].load(std::memory_order_relaxed);
+        destination.sumOfSquares[channel] = slot.sumOfSquares[channel].load(std::memory_order_relaxed);
+    }
+
+    // The copy only counts if the writer did not start on the slot meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+//==============================================================================
+Meter::Reader::Reader(const Meter& meterToRead)
+    : meter(meterToRead),
+      nextFrame(meterToRead.getNumFramesWritten())
 {
-    input->releaseResources();
 }
 
-void Meter::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+void Meter::Reader::update(double secondsSinceLastUpdate)
 {
-    input->getNextAudioBlock(bufferToFill);
+    auto written = meter.getNumFramesWritten();
 
-    int numChannels = bufferToFill.buffer->getNumChannels();
-    int numSamples = bufferToFill.numSamples;
+    // Frames older than the ring are gone; start from the oldest left
+    auto first = juce::jmax(nextFrame, written - historySize + 1);
+    nextFrame = written;
 
-    if (numChannels > (int)peaks.size())
+    std::array<double, maxChannels> sums {};
+    juce::int64 numSamples = 0;
+    peaks.fill(0.0f);
+
+    Frame frame;
+
+    for (auto index = first; index < written; ++index)
     {
-        size_t oldSize = peaks.size();
-        peaks.reserve(numChannels);
-        rmsValues.reserve(numChannels);
-        rmsSums.reserve(numChannels);
-        rmsCounts.reserve(numChannels);
+        if (!meter.readFrame(index, frame))
+            continue;
 
-        for (size_t i = oldSize; i < (size_t)numChannels; ++i)
+        numChannels = juce::jmax(numChannels, frame.numChannels);
+        numSamples += frame.numSamples;
+
+        for (int channel = 0; channel < frame.numChannels; ++channel)
         {
-            peaks.push_back(std::make_unique<std::atomic<float>>(0.0f));
-            rmsValues.push_back(std::make_unique<std::atomic<float>>(0.0f));
-            rmsSums.push_back(0.0f);
-            rmsCounts.push_back(0);
+            peaks[static_cast<size_t>(channel)] = juce::jmax(peaks[static_cast<size_t>(channel)], frame.peak[channel]);
+            sums[static_cast<size_t>(channel)] += frame.sumOfSquares[channel];
         }
     }
 
-    for (int channel = 0; channel < numChannels; ++channel)
-    {
-        const float* channelData = bufferToFill.buffer->getReadPointer(channel);
-        float currentPeak = 0.0f;
-        float currentRMSSum = 0.0f;
+    // Nothing new (transport idle): keep the last RMS rather than drop to 0
+    if (numSamples > 0)
+        for (int channel = 0; channel < maxChannels; ++channel)
+            rmsLevels[static_cast<size_t>(channel)] = juce::jmin(1.0f, static_cast<float>(std::sqrt(sums[static_cast<size_t>(channel)] / static_cast<double>(numSamples))));
+
+    auto release = juce::Decibels::decibelsToGain(-releaseDbPerSecond * static_cast<float>(secondsSinceLastUpdate));
 
-        for (int sample = 0; sample < numSamples; ++sample)
+    for (size_t channel = 0; channel < maxChannels; ++channel)
+    {
+        if (peaks[channel] >= heldPeaks[channel])
         {
-            float absValue = std::abs(channelData[sample]); // Use std::abs
-            if (absValue > currentPeak)
-                currentPeak = absValue;
-            currentRMSSum += (channelData[sample] * channelData[sample]);
+            heldPeaks[channel] = peaks[channel];
+            holdRemaining[channel] = holdSeconds;
         }
-
-        // Update peaks (atomic)
-        float oldPeak = peaks[channel]->load();
-        while (currentPeak > oldPeak && !peaks[channel]->compare_exchange_weak(oldPeak, currentPeak))
+        else if (holdRemaining[channel] > 0.0)
         {
-            oldPeak = peaks[channel]->load();
+            holdRemaining[channel] -= secondsSinceLastUpdate;
         }
+        else
+        {
+            heldPeaks[channel] = juce::jmax(peaks[channel], heldPeaks[channel] * release);
+        }
+    }
+}
 
-        // Accumulate RMS sums for averaging over a longer period if needed
-        rmsSums[channel] += currentRMSSum;
-        rmsCounts[channel] += numSamples;
+float Meter::Reader::getPeak(int channel) const
+{
+    return juce::isPositiveAndBelow(channel, maxChannels) ? peaks[static_cast<size_t>(channel)] : 0.0f;
+}
 
-        // For simplicity, calculate RMS for this block and store (atomic)
-        float rms = juce::jmin(1.0f, juce::jmax(0.0f, std::sqrt(currentRMSSum / (float)numSamples))); // Use std::sqrt
-        rmsValues[channel]->store(rms);
-    }
+float Meter::Reader::getRMS(int channel) const
+{
+    return juce::isPositiveAndBelow(channel, maxChannels) ? rmsLevels[static_cast<size_t>(channel)] : 0.0f;
 }
 
-float Meter::getAndResetPeak(int channelIndex)
+float Meter::Reader::getPeakHold(int channel) const
 {
-    if ((size_t)channelIndex < peaks.size())
-    {
-        return peaks[channelIndex]->exchange(0.0f); // Atomically get and reset
-    }
-    return 0.0f;
+    return juce::isPositiveAndBelow(channel, maxChannels) ? heldPeaks[static_cast<size_t>(channel)] : 0.0f;
 }
 
-float Meter::getRMS(int channelIndex) const
+void Meter::Reader::resetPeakHold()
 {
-    if ((size_t)channelIndex < rmsValues.size())
-    {
-        return rmsValues[channelIndex]->load();
-    }
-    return 0.0f;
+    heldPeaks.fill(0.0f);
+    holdRemaining.fill(0.0);
+}
+
+int Meter::Reader::readPeakHistory(int channel, float* destination, int maxFrames) const
+{
+    auto written = meter.getNumFramesWritten();
+    auto available = static_cast<int>(juce::jmin(static_cast<juce::int64>(juce::jmin(maxFrames, historySize - 1)), written));
+    auto first = written - available;
+
+    Frame frame;
+
+    for (int i = 0; i < available; ++i)
+        destination[i] = meter.readFrame(first + i, frame) && channel < frame.numChannels ? frame.peak[channel] : 0.0f;
+
+    return available;
 }
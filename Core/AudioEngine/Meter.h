@@ -2,12 +2,30 @@
 
 #include <JuceHeader.h>
 #include <atomic>
-#include <vector>
 
+// Peak/RMS meter. Either wraps a source (the master) or, constructed with no
+// input, is fed directly through process() as a tap (tracks).
+//
+// Every processed block becomes one frame in a pre-sized ring. The audio
+// thread only ever writes the next slot, guarded by a per-slot sequence
+// number, so it never waits and never allocates. Readers follow the ring at
+// their own pace and can look back over the whole ring for meter history.
 class Meter final : public juce::AudioSource
 {
 public:
-    Meter(juce::AudioSource* inputSource);
+    static constexpr int maxChannels = 16;  // 7.1.4 and 3rd-order ambisonics
+    static constexpr int historySize = 1024;   // frames; a power of two
+
+    // One block's levels, as copied out of the ring
+    struct Frame
+    {
+        int numChannels = 0;
+        int numSamples = 0;
+        float peak[maxChannels] {};
+        float sumOfSquares[maxChannels] {};
+    };
+
+    Meter(juce::AudioSource* inputSource = nullptr);
     ~Meter() override;
 
     // juce::AudioSource methods
@@ -15,15 +33,64 @@ public:
     void releaseResources() override;
     void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
 
-    float getAndResetPeak(int channelIndex);
-    float getRMS(int channelIndex) const;
+    // Audio thread: measures a block without altering it
+    void process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // Any thread. Frames are numbered from 0; a frame can be read until it
+    // is historySize frames old.
+    juce::int64 getNumFramesWritten() const { return framesWritten.load(std::memory_order_acquire); }
+    bool readFrame(juce::int64 frameIndex, Frame& destination) const;
+
+    double getSampleRate() const { return currentSampleRate.load(std::memory_order_relaxed); }
+
+    //==============================================================================
+    // Follows one Meter from another thread (normally the GUI), folding all
+    // frames written since the previous update into peak, RMS and peak hold.
+    class Reader
+    {
+    public:
+        explicit Reader(const Meter& meterToRead);
+
+        void update(double secondsSinceLastUpdate);
+
+        int getNumChannels() const { return numChannels; }
+        float getPeak(int channel) const;      // since the last update
+        float getRMS(int channel) const;       // over the frames since the last update
+        float getPeakHold(int channel) const;  // held, then released at releaseDbPerSecond
+        void resetPeakHold();
+
+        // Peaks of the most recent frames, oldest first; returns the count
+        int readPeakHistory(int channel, float* destination, int maxFrames) const;
+
+        static constexpr double holdSeconds = 1.5;
+        static constexpr float releaseDbPerSecond = 20.0f;
+
+    private:
+        const Meter& meter;
+        juce::int64 nextFrame = 0;
+        int numChannels = 0;
+
+        std::array<float, maxChannels> peaks {};
+        std::array<float, maxChannels> rmsLevels {};
+        std::array<float, maxChannels> heldPeaks {};
+        std::array<double, maxChannels> holdRemaining {};
+    };
 
 private:
+    // Cache-line aligned so neighbouring slots never share a line
+    struct alignas(64) Slot
+    {
+        std::atomic<juce::uint64> sequence { 0 };   // odd while being written
+        std::atomic<int> numChannels { 0 };
+        std::atomic<int> numSamples { 0 };
+        std::atomic<float> peak[maxChannels] {};
+        std::atomic<float> sumOfSquares[maxChannels] {};
+    };
+
     juce::AudioSource* input;
-    std::vector<std::unique_ptr<std::atomic<float>>> peaks;
-    std::vector<std::unique_ptr<std::atomic<float>>> rmsValues;
-    std::vector<float> rmsSums;
-    std::vector<int> rmsCounts;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<juce::int64> framesWritten { 0 };
+    std::atomic<double> currentSampleRate { 0.0 };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Meter)
 };
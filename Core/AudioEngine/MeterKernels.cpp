@@ -0,0 +1,79 @@
+#include "MeterKernels.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace MeterKernels
+{
+
+Levels measure(const float* data, int numSamples) noexcept
+{
+    Levels levels;
+    int i = 0;
+
+    // Two independent accumulators per quantity hide the add/max latency
+   #if JUCE_USE_SSE_INTRINSICS
+    const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    auto peak0 = _mm_setzero_ps(), peak1 = _mm_setzero_ps();
+    auto sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        auto a = _mm_loadu_ps(data + i);
+        auto b = _mm_loadu_ps(data + i + 4);
+
+        peak0 = _mm_max_ps(peak0, _mm_and_ps(a, absMask));
+        peak1 = _mm_max_ps(peak1, _mm_and_ps(b, absMask));
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(a, a));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(b, b));
+    }
+
+    alignas(16) float peaks[4], sums[4];
+    _mm_store_ps(peaks, _mm_max_ps(peak0, peak1));
+    _mm_store_ps(sums, _mm_add_ps(sum0, sum1));
+
+    levels.peak = juce::jmax(peaks[0], peaks[1], peaks[2], peaks[3]);
+    levels.sumOfSquares = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+   #elif JUCE_USE_ARM_NEON
+    auto peak0 = vdupq_n_f32(0.0f), peak1 = vdupq_n_f32(0.0f);
+    auto sum0 = vdupq_n_f32(0.0f), sum1 = vdupq_n_f32(0.0f);
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        auto a = vld1q_f32(data + i);
+        auto b = vld1q_f32(data + i + 4);
+
+        peak0 = vmaxq_f32(peak0, vabsq_f32(a));
+        peak1 = vmaxq_f32(peak1, vabsq_f32(b));
+        sum0 = vmlaq_f32(sum0, a, a);
+        sum1 = vmlaq_f32(sum1, b, b);
+    }
+
+    float peaks[4], sums[4];
+    vst1q_f32(peaks, vmaxq_f32(peak0, peak1));
+    vst1q_f32(sums, vaddq_f32(sum0, sum1));
+
+    levels.peak = juce::jmax(peaks[0], peaks[1], peaks[2], peaks[3]);
+    levels.sumOfSquares = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+   #endif
+
+    for (; i < numSamples; ++i)
+    {
+        auto sample = data[i];
+        levels.peak = juce::jmax(levels.peak, std::abs(sample));
+        levels.sumOfSquares += sample * sample;
+    }
+
+    return levels;
+}
+
+void measure(const float* const* channels, int numChannels, int numSamples, Levels* results) noexcept
+{
+    for (int channel = 0; channel < numChannels; ++channel)
+        results[channel] = measure(channels[channel], numSamples);
+}
+
+}
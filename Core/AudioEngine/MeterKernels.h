@@ -0,0 +1,19 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Fused level kernels shared by every meter in the engine (tracks, buses and
+// master). Each channel is read exactly once, producing its peak magnitude
+// and sum of squares together.
+namespace MeterKernels
+{
+    struct Levels
+    {
+        float peak = 0.0f;
+        float sumOfSquares = 0.0f;
+    };
+
+    Levels measure(const float* data, int numSamples) noexcept;
+
+    // results must hold numChannels entries
+    void measure(const float* const* channels, int numChannels, int numSamples, Levels* results) noexcept;
+}
@@ -2,44 +2,139 @@
 
 MultiTrackMixer::MultiTrackMixer()
 {
+    publishTrackList();
 }
 
 MultiTrackMixer::~MultiTrackMixer()
 {
     releaseResources();
+    currentTrackList = nullptr;
+    releasePool.releaseAll();
 }
 
 void MultiTrackMixer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
     samplesPerBlock = samplesPerBlockExpected;
     currentSampleRate = sampleRate;
+    internalBlockSize = requestedBlockSize > 0 ? requestedBlockSize : samplesPerBlockExpected;
     
-    mixBuffer.setSize(2, samplesPerBlockExpected); // Stereo output
+    busPrecision = precision;
+    busLayout = requestedBusLayout;
+    auto busChannels = busLayout.size();
+    
+    // Wide enough for any track, so layouts can differ between tracks
+    mixBuffer.setSize(Panner::maxChannels, internalBlockSize);
+    busBuffer.setSize(busPrecision == juce::AudioProcessor::singlePrecision ? busChannels : 0, internalBlockSize);
+    doubleBusBuffer.setSize(busPrecision == juce::AudioProcessor::doublePrecision ? busChannels : 0, internalBlockSize);
+    busReadPosition = internalBlockSize;     // nothing mixed yet
     
     for (auto& track : tracks)
+        prepareTrack(*track);
+
+    anticipativeRenderer.prepare(internalBlockSize, sampleRate);
+    latencyDirty = true;
+}
+
+void MultiTrackMixer::prepareTrack(Track& track)
+{
+    track.setProcessingPrecision(busPrecision);
+    track.setBusLayout(busLayout);
+    track.prepareToPlay(internalBlockSize, currentSampleRate);
+}
+
+void MultiTrackMixer::setInternalBlockSize(int numSamples)
+{
+    requestedBlockSize = juce::jmax(0, numSamples);
+}
+
+void MultiTrackMixer::setBusLayout(const juce::AudioChannelSet& newLayout)
+{
+    if (newLayout.isDisabled() || newLayout.size() > Panner::maxChannels)
     {
-        track->prepareToPlay(samplesPerBlockExpected, sampleRate);
+        juce::Logger::writeToLog("MultiTrackMixer: unsupported bus layout " + newLayout.getDescription());
+        return;
     }
+
+    requestedBusLayout = newLayout;
 }
 
 void MultiTrackMixer::releaseResources()
 {
+    anticipativeRenderer.release();
+
     for (auto& track : tracks)
     {
         track->releaseResources();
     }
+
+    releasePool.collectGarbage();
 }
 
 void MultiTrackMixer::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
     bufferToFill.clearActiveBufferRegion();
-    
-    if (!playing || tracks.empty())
-        return;
+
+    releasePool.beginAudioBlock();
+    auto* list = currentTrackList.load();
+
+    // Pick up latency changes reported by any plugin since the last block
+    bool latencyChanged = latencyDirty.exchange(false);
+    for (auto* track : list->tracks)
+        latencyChanged = track->checkAndClearLatencyChanged() || latencyChanged;
+
+    if (latencyChanged)
+        updateLatencyCompensation(*list);
+
+    if (!playing || list->tracks.empty())
+    {
+        anticipativeRenderer.acknowledgeHandovers();
+        busReadPosition = internalBlockSize;
+    }
+    else if (busPrecision == juce::AudioProcessor::doublePrecision)
+        renderFromBus(*list, doubleBusBuffer, bufferToFill);
+    else
+        renderFromBus(*list, busBuffer, bufferToFill);
+
+    releasePool.endAudioBlock();
+}
+
+template <typename SampleType>
+void MultiTrackMixer::renderFromBus(const TrackList& list, juce::AudioBuffer<SampleType>& bus,
+                                    const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    // Serve the callback from mixed blocks, mixing another as each runs out
+    auto outputChannels = juce::jmin(bufferToFill.buffer->getNumChannels(), bus.getNumChannels());
+    auto startSample = bufferToFill.startSample;
+    auto remaining = bufferToFill.numSamples;
+
+    while (remaining > 0)
+    {
+        if (busReadPosition >= internalBlockSize)
+        {
+            mixBlock(list, bus);
+            busReadPosition = 0;
+        }
+
+        auto count = juce::jmin(remaining, internalBlockSize - busReadPosition);
+
+        for (int channel = 0; channel < outputChannels; ++channel)
+            std::copy_n(bus.getReadPointer(channel, busReadPosition), count,
+                        bufferToFill.buffer->getWritePointer(channel, startSample));
+
+        busReadPosition += count;
+        startSample += count;
+        remaining -= count;
+    }
+}
+
+template <typename SampleType>
+void MultiTrackMixer::mixBlock(const TrackList& list, juce::AudioBuffer<SampleType>& bus)
+{
+    bus.clear();
 
     // Check for solo tracks
     bool hasSolo = false;
-    for (const auto& track : tracks)
+    for (auto* track : list.tracks)
     {
         if (track->isSolo())
         {
@@ -49,45 +144,96 @@ void MultiTrackMixer::getNextAudioBlock(const juce::AudioSourceChannelInfo& buff
     }
 
     // Mix all tracks
-    for (auto& track : tracks)
+    for (int i = 0; i < static_cast<int>(list.tracks.size()); ++i)
     {
-        // Skip muted tracks or non-solo tracks when solo is active
-        if (track->isMuted() || (hasSolo && !track->isSolo()))
-            continue;
+        auto* track = list.tracks[static_cast<size_t>(i)];
+        auto audible = !track->isMuted() && !(hasSolo && !track->isSolo());
 
-        // Get track audio
-        juce::AudioSourceChannelInfo trackInfo(&mixBuffer, 0, bufferToFill.numSamples);
-        track->getNextAudioBlock(trackInfo);
-        
-        // Add to output buffer
-        for (int channel = 0; channel < juce::jmin(bufferToFill.buffer->getNumChannels(), 
-                                                   mixBuffer.getNumChannels()); ++channel)
+        // The track only sees as many channels as its layout has
+        juce::AudioBuffer<float> trackBuffer(mixBuffer.getArrayOfWritePointers(), track->getNumChannels(), internalBlockSize);
+        juce::AudioSourceChannelInfo trackInfo(&trackBuffer, 0, internalBlockSize);
+
+        // Pre-rendered audio is taken even when silenced, to keep its place
+        if (anticipativeRenderer.readBlock(i, *track, trackBuffer, internalBlockSize))
         {
-            bufferToFill.buffer->addFrom(channel, bufferToFill.startSample,
-                                       mixBuffer, channel, 0, bufferToFill.numSamples);
+            if (!audible)
+                continue;
+
+            track->finishBlock(trackInfo);
+        }
+        else
+        {
+            // Skip muted tracks or non-solo tracks when solo is active
+            if (!audible)
+            {
+                track->skipBlock();
+                continue;
+            }
+
+            // Get track audio
+            track->getNextAudioBlock(trackInfo);
         }
+        
+        // Pan onto the bus, summing in its precision
+        track->getPanner().addToBus(trackBuffer, bus, internalBlockSize);
     }
 }
 
 int MultiTrackMixer::addTrack(const juce::String& name)
+{
+    return insertTrack(name, -1);
+}
+
+int MultiTrackMixer::insertTrack(const juce::String& name, int trackIndex)
 {
     auto track = std::make_unique<Track>(name);
     
     if (currentSampleRate > 0.0)
-        track->prepareToPlay(samplesPerBlock, currentSampleRate);
+        prepareTrack(*track);
+
+    if (trackIndex < 0 || trackIndex > static_cast<int>(tracks.size()))
+        trackIndex = static_cast<int>(tracks.size());
     
-    tracks.push_back(std::move(track));
-    return static_cast<int>(tracks.size() - 1);
+    anticipativeRenderer.insertTrack(*track, trackIndex);
+    tracks.insert(tracks.begin() + trackIndex, std::move(track));
+    publishTrackList();
+    latencyDirty = true;
+    return trackIndex;
 }
 
 void MultiTrackMixer::removeTrack(int trackIndex)
 {
     if (trackIndex >= 0 && trackIndex < static_cast<int>(tracks.size()))
     {
+        anticipativeRenderer.removeTrack(trackIndex);
+
+        auto removedTrack = std::move(tracks[static_cast<size_t>(trackIndex)]);
         tracks.erase(tracks.begin() + trackIndex);
+
+        // The audio thread may still be mixing the removed track until the
+        // new list has been picked up
+        publishTrackList();
+        releasePool.retire(std::move(removedTrack));
+        latencyDirty = true;
     }
 }
 
+void MultiTrackMixer::moveTrack(int fromIndex, int toIndex)
+{
+    auto numTracks = static_cast<int>(tracks.size());
+    if (fromIndex < 0 || fromIndex >= numTracks || toIndex < 0 || toIndex >= numTracks || fromIndex == toIndex)
+        return;
+
+    anticipativeRenderer.moveTrack(fromIndex, toIndex);
+
+    if (fromIndex < toIndex)
+        std::rotate(tracks.begin() + fromIndex, tracks.begin() + fromIndex + 1, tracks.begin() + toIndex + 1);
+    else
+        std::rotate(tracks.begin() + toIndex, tracks.begin() + fromIndex, tracks.begin() + fromIndex + 1);
+
+    publishTrackList();
+}
+
 Track* MultiTrackMixer::getTrack(int trackIndex)
 {
     if (trackIndex >= 0 && trackIndex < static_cast<int>(tracks.size()))
@@ -107,8 +253,34 @@ void MultiTrackMixer::stop()
 
 void MultiTrackMixer::setPosition(double positionInSeconds)
 {
+    // Also drops audio rendered ahead of the old position
+    anticipativeRenderer.setPosition(positionInSeconds);
+}
+
+void MultiTrackMixer::publishTrackList()
+{
+    auto list = std::make_unique<TrackList>();
+    list->tracks.reserve(tracks.size());
+
     for (auto& track : tracks)
-    {
-        track->setPosition(positionInSeconds);
-    }
+        list->tracks.push_back(track.get());
+
+    currentTrackList = list.get();
+    releasePool.retire(std::move(ownedTrackList));
+    ownedTrackList = std::move(list);
+}
+
+void MultiTrackMixer::updateLatencyCompensation(const TrackList& list)
+{
+    // Every track is delayed up to the latency of the slowest path so all
+    // tracks reach the mix bus sample-aligned. Only integers change here;
+    // the delay lines were sized in Track::prepareToPlay.
+    int maxLatency = 0;
+    for (auto* track : list.tracks)
+        maxLatency = juce::jmax(maxLatency, track->getLatencySamples());
+
+    for (auto* track : list.tracks)
+        track->setCompensationDelay(maxLatency - track->getLatencySamples());
+
+    totalLatencySamples = maxLatency;
 }
@@ -1,7 +1,13 @@
 #pragma once
 #include <JuceHeader.h>
 #include "Track.h"
+#include "AnticipativeRenderer.h"
+#include "DeferredReleasePool.h"
 
+// Tracks are mixed in blocks of a fixed internal size, whatever the device
+// asks for. A callback is served from the last mixed block and a new one is
+// mixed whenever that runs out, so callbacks of any length, including ones
+// longer than the device announced, need no extra buffering or latency.
 class MultiTrackMixer : public juce::AudioSource
 {
 public:
@@ -15,7 +21,9 @@ public:
 
     // Track management
     int addTrack(const juce::String& name = "Track");
+    int insertTrack(const juce::String& name, int trackIndex);
     void removeTrack(int trackIndex);
+    void moveTrack(int fromIndex, int toIndex);
     Track* getTrack(int trackIndex);
     int getNumTracks() const { return static_cast<int>(tracks.size()); }
 
@@ -25,11 +33,74 @@ public:
     void setPosition(double positionInSeconds);
     bool isPlaying() const { return playing; }
 
+    // Block size the tracks and plugins see; 0 follows the device. Takes
+    // effect from the next prepareToPlay. A fixed size larger than the
+    // device's makes some callbacks mix a whole block and others none, so
+    // the default follows the device.
+    void setInternalBlockSize(int numSamples);
+    int getInternalBlockSize() const { return internalBlockSize; }
+
+    static constexpr int defaultInternalBlockSize = 0;
+
+    // Sample type of the mix bus, the effects and the plugins that support
+    // it. Tracks still stream and meter in float. Takes effect from the
+    // next prepareToPlay.
+    void setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision newPrecision) { precision = newPrecision; }
+    juce::AudioProcessor::ProcessingPrecision getProcessingPrecision() const { return precision; }
+
+    // Layout of the mix bus, which each track is panned onto: mono, stereo,
+    // surround or ambisonic. Takes effect from the next prepareToPlay.
+    void setBusLayout(const juce::AudioChannelSet& newLayout);
+    const juce::AudioChannelSet& getBusLayout() const { return requestedBusLayout; }
+
+    // Plugin delay compensation
+    int getTotalLatencySamples() const { return totalLatencySamples.load(); }
+
+    // Tracks that aren't armed or monitoring are rendered ahead on workers
+    AnticipativeRenderer& getAnticipativeRenderer() { return anticipativeRenderer; }
+
 private:
+    // The tracks in mixing order, as the audio thread sees them. Replaced
+    // whole on every add, remove or move, and retired through the release
+    // pool with any removed track.
+    struct TrackList
+    {
+        std::vector<Track*> tracks;
+    };
+
+    void publishTrackList();
+    void updateLatencyCompensation(const TrackList& list);
+    void prepareTrack(Track& track);
+
+    template <typename SampleType>
+    void renderFromBus(const TrackList& list, juce::AudioBuffer<SampleType>& bus,
+                       const juce::AudioSourceChannelInfo& bufferToFill);
+
+    template <typename SampleType>
+    void mixBlock(const TrackList& list, juce::AudioBuffer<SampleType>& bus);
+
     std::vector<std::unique_ptr<Track>> tracks;
-    juce::AudioBuffer<float> mixBuffer;
+    std::unique_ptr<TrackList> ownedTrackList;
+    std::atomic<TrackList*> currentTrackList { nullptr };
+    DeferredReleasePool releasePool;
+    juce::AudioBuffer<float> mixBuffer;     // one track's block, in its layout
+    juce::AudioBuffer<float> busBuffer;     // the mixed block; only the one
+    juce::AudioBuffer<double> doubleBusBuffer;  // for busPrecision is allocated
+    int busReadPosition = 0;                // samples of the bus already output
+    juce::AudioProcessor::ProcessingPrecision precision = juce::AudioProcessor::singlePrecision;
+    juce::AudioProcessor::ProcessingPrecision busPrecision = juce::AudioProcessor::singlePrecision;
+    juce::AudioChannelSet requestedBusLayout = juce::AudioChannelSet::stereo();
+    juce::AudioChannelSet busLayout = juce::AudioChannelSet::stereo();     // as prepared
     bool playing = false;
     
+    int requestedBlockSize = defaultInternalBlockSize;
+    int internalBlockSize = 0;              // what the tracks were prepared for
     int samplesPerBlock = 0;
     double currentSampleRate = 0.0;
+
+    std::atomic<bool> latencyDirty { true };
+    std::atomic<int> totalLatencySamples { 0 };
+
+    // Holds pointers to the tracks, so it goes first
+    AnticipativeRenderer anticipativeRenderer;
 };
@@ -0,0 +1,353 @@
+#include "Panner.h"
+
+namespace
+{
+    using ChannelType = juce::AudioChannelSet::ChannelType;
+
+    constexpr float minusThreeDb = 0.70710678f;
+
+    // -1 for the left half of the room, 1 for the right, 0 for the middle
+    int getSide(ChannelType type)
+    {
+        switch (type)
+        {
+            case juce::AudioChannelSet::left:
+            case juce::AudioChannelSet::leftSurround:
+            case juce::AudioChannelSet::leftCentre:
+            case juce::AudioChannelSet::leftSurroundSide:
+            case juce::AudioChannelSet::leftSurroundRear:
+            case juce::AudioChannelSet::wideLeft:
+            case juce::AudioChannelSet::topFrontLeft:
+            case juce::AudioChannelSet::topRearLeft:
+            case juce::AudioChannelSet::topSideLeft:
+                return -1;
+
+            case juce::AudioChannelSet::right:
+            case juce::AudioChannelSet::rightSurround:
+            case juce::AudioChannelSet::rightCentre:
+            case juce::AudioChannelSet::rightSurroundSide:
+            case juce::AudioChannelSet::rightSurroundRear:
+            case juce::AudioChannelSet::wideRight:
+            case juce::AudioChannelSet::topFrontRight:
+            case juce::AudioChannelSet::topRearRight:
+            case juce::AudioChannelSet::topSideRight:
+                return 1;
+
+            default:
+                return 0;
+        }
+    }
+
+    // Nominal speaker direction in degrees (azimuth anticlockwise from the
+    // front, elevation up); false for LFE, which has none
+    bool getDirection(ChannelType type, float& azimuth, float& elevation)
+    {
+        azimuth = 0.0f;
+        elevation = 0.0f;
+
+        switch (type)
+        {
+            case juce::AudioChannelSet::LFE:
+            case juce::AudioChannelSet::LFE2:              return false;
+
+            case juce::AudioChannelSet::left:              azimuth = 30.0f; break;
+            case juce::AudioChannelSet::right:             azimuth = -30.0f; break;
+            case juce::AudioChannelSet::leftCentre:        azimuth = 15.0f; break;
+            case juce::AudioChannelSet::rightCentre:       azimuth = -15.0f; break;
+            case juce::AudioChannelSet::wideLeft:          azimuth = 60.0f; break;
+            case juce::AudioChannelSet::wideRight:         azimuth = -60.0f; break;
+            case juce::AudioChannelSet::leftSurroundSide:  azimuth = 90.0f; break;
+            case juce::AudioChannelSet::rightSurroundSide: azimuth = -90.0f; break;
+            case juce::AudioChannelSet::leftSurround:      azimuth = 110.0f; break;
+            case juce::AudioChannelSet::rightSurround:     azimuth = -110.0f; break;
+            case juce::AudioChannelSet::leftSurroundRear:  azimuth = 150.0f; break;
+            case juce::AudioChannelSet::rightSurroundRear: azimuth = -150.0f; break;
+            case juce::AudioChannelSet::centreSurround:    azimuth = 180.0f; break;
+
+            case juce::AudioChannelSet::topMiddle:         elevation = 90.0f; break;
+            case juce::AudioChannelSet::topFrontLeft:      azimuth = 45.0f;   elevation = 45.0f; break;
+            case juce::AudioChannelSet::topFrontCentre:    azimuth = 0.0f;    elevation = 45.0f; break;
+            case juce::AudioChannelSet::topFrontRight:     azimuth = -45.0f;  elevation = 45.0f; break;
+            case juce::AudioChannelSet::topSideLeft:       azimuth = 90.0f;   elevation = 45.0f; break;
+            case juce::AudioChannelSet::topSideRight:      azimuth = -90.0f;  elevation = 45.0f; break;
+            case juce::AudioChannelSet::topRearLeft:       azimuth = 135.0f;  elevation = 45.0f; break;
+            case juce::AudioChannelSet::topRearCentre:     azimuth = 180.0f;  elevation = 45.0f; break;
+            case juce::AudioChannelSet::topRearRight:      azimuth = -135.0f; elevation = 45.0f; break;
+
+            default: break;     // centre and anything unnamed face the front
+        }
+
+        return true;
+    }
+
+    // Real spherical harmonics up to order for a direction, in ACN order with
+    // SN3D normalisation. Associated Legendre functions by the usual
+    // recurrence in l, without the Condon-Shortley phase.
+    void computeHarmonics(float azimuthDegrees, float elevationDegrees, int order, float* result, int maxResults)
+    {
+        auto azimuth = static_cast<double>(juce::degreesToRadians(azimuthDegrees));
+        auto elevation = static_cast<double>(juce::degreesToRadians(elevationDegrees));
+        auto x = std::sin(elevation);
+        auto c = std::cos(elevation);
+
+        for (int m = 0; m <= order; ++m)
+        {
+            auto pmm = 1.0;
+            for (int k = 1; k <= m; ++k)
+                pmm *= (2 * k - 1) * c;
+
+            auto previous = 0.0;
+            auto p = pmm;
+
+            for (int l = m; l <= order; ++l)
+            {
+                if (l > m)
+                {
+                    auto next = ((2 * l - 1) * x * p - (l + m - 1) * previous) / (l - m);
+                    previous = p;
+                    p = next;
+                }
+
+                // sqrt((2 - delta_m0) (l - m)! / (l + m)!)
+                auto ratio = 1.0;
+                for (int k = l - m + 1; k <= l + m; ++k)
+                    ratio /= k;
+
+                auto value = std::sqrt((m == 0 ? 1.0 : 2.0) * ratio) * p;
+                auto centre = l * l + l;
+
+                if (m == 0)
+                {
+                    if (centre < maxResults)
+                        result[centre] = static_cast<float>(value);
+                    continue;
+                }
+
+                if (centre + m < maxResults)
+                    result[centre + m] = static_cast<float>(value * std::cos(m * azimuth));
+                if (centre - m < maxResults)
+                    result[centre - m] = static_cast<float>(value * std::sin(m * azimuth));
+            }
+        }
+    }
+
+    bool isAmbisonic(const juce::AudioChannelSet& layout)
+    {
+        return layout.getAmbisonicOrder() >= 0;
+    }
+}
+
+Panner::Panner()
+{
+    computeGains(0.0f, gains);
+    previousGains = gains;
+}
+
+void Panner::prepare(const juce::AudioChannelSet& trackLayout, const juce::AudioChannelSet& busLayout)
+{
+    input = trackLayout;
+    output = busLayout;
+    numInputs = juce::jlimit(1, maxChannels, input.size());
+    numOutputs = juce::jlimit(1, maxChannels, output.size());
+
+    computedPan = getPan();
+    computeGains(computedPan, gains);
+    previousGains = gains;
+}
+
+void Panner::addToBus(const juce::AudioBuffer<float>& source, juce::AudioBuffer<float>& bus, int numSamples)
+{
+    add(source, bus, numSamples);
+}
+
+void Panner::addToBus(const juce::AudioBuffer<float>& source, juce::AudioBuffer<double>& bus, int numSamples)
+{
+    add(source, bus, numSamples);
+}
+
+template <typename SampleType>
+void Panner::add(const juce::AudioBuffer<float>& source, juce::AudioBuffer<SampleType>& bus, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    auto currentPan = getPan();
+    if (currentPan != computedPan)
+    {
+        computeGains(currentPan, gains);
+        computedPan = currentPan;
+    }
+
+    auto inputs = juce::jmin(numInputs, source.getNumChannels());
+    auto outputs = juce::jmin(numOutputs, bus.getNumChannels());
+
+    for (int in = 0; in < inputs; ++in)
+    {
+        auto* sourceData = source.getReadPointer(in);
+
+        for (int out = 0; out < outputs; ++out)
+        {
+            auto from = previousGains[static_cast<size_t>(in)][static_cast<size_t>(out)];
+            auto to = gains[static_cast<size_t>(in)][static_cast<size_t>(out)];
+
+            if (from == 0.0f && to == 0.0f)
+                continue;
+
+            if constexpr (std::is_same_v<SampleType, float>)
+            {
+                if (from == to)
+                    bus.addFrom(out, 0, sourceData, numSamples, to);
+                else
+                    bus.addFromWithRamp(out, 0, sourceData, numSamples, from, to);
+            }
+            else
+            {
+                auto* busData = bus.getWritePointer(out);
+                auto step = (static_cast<double>(to) - from) / numSamples;
+                auto gain = static_cast<double>(from);
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    busData[i] += sourceData[i] * gain;
+                    gain += step;
+                }
+            }
+        }
+    }
+
+    previousGains = gains;
+}
+
+void Panner::computeGains(float panPosition, Matrix& result) const
+{
+    for (auto& row : result)
+        row.fill(0.0f);
+
+    auto ambisonicIn = isAmbisonic(input);
+    auto ambisonicOut = isAmbisonic(output);
+
+    if (ambisonicIn && ambisonicOut)
+    {
+        // Lower orders line up channel for channel in ACN
+        for (int channel = 0; channel < juce::jmin(numInputs, numOutputs); ++channel)
+            result[static_cast<size_t>(channel)][static_cast<size_t>(channel)] = 1.0f;
+    }
+    else if (ambisonicOut)
+    {
+        computeEncoderGains(panPosition, result);
+    }
+    else if (ambisonicIn)
+    {
+        computeDecoderGains(result);
+    }
+    else
+    {
+        computeSpeakerGains(panPosition, result);
+    }
+}
+
+void Panner::computeSpeakerGains(float panPosition, Matrix& result) const
+{
+    auto left = output.getChannelIndexForType(juce::AudioChannelSet::left);
+    auto right = output.getChannelIndexForType(juce::AudioChannelSet::right);
+    auto hasPair = left >= 0 && right >= 0 && left < maxChannels && right < maxChannels;
+
+    if (numInputs == 1)
+    {
+        if (!hasPair)
+        {
+            result[0][0] = 1.0f;
+            return;
+        }
+
+        auto angle = (panPosition + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+        result[0][static_cast<size_t>(left)] = std::cos(angle);
+        result[0][static_cast<size_t>(right)] = std::sin(angle);
+        return;
+    }
+
+    auto halfPi = juce::MathConstants<float>::halfPi;
+    auto leftBalance = panPosition > 0.0f ? std::cos(panPosition * halfPi) : 1.0f;
+    auto rightBalance = panPosition < 0.0f ? std::cos(-panPosition * halfPi) : 1.0f;
+
+    for (int in = 0; in < numInputs; ++in)
+    {
+        auto type = input.getTypeOfChannel(in);
+        auto side = getSide(type);
+        auto balance = side < 0 ? leftBalance : (side > 0 ? rightBalance : 1.0f);
+        auto& row = result[static_cast<size_t>(in)];
+
+        auto out = output.getChannelIndexForType(type);
+        if (out >= 0 && out < numOutputs)
+        {
+            row[static_cast<size_t>(out)] = balance;
+            continue;
+        }
+
+        if (type == juce::AudioChannelSet::LFE || type == juce::AudioChannelSet::LFE2)
+            continue;
+
+        // Folded down: each side onto its own speaker, the middle onto both
+        if (!hasPair)
+            row[0] = minusThreeDb;
+        else if (side < 0)
+            row[static_cast<size_t>(left)] = minusThreeDb * leftBalance;
+        else if (side > 0)
+            row[static_cast<size_t>(right)] = minusThreeDb * rightBalance;
+        else
+        {
+            row[static_cast<size_t>(left)] = minusThreeDb * leftBalance;
+            row[static_cast<size_t>(right)] = minusThreeDb * rightBalance;
+        }
+    }
+}
+
+void Panner::computeEncoderGains(float panPosition, Matrix& result) const
+{
+    auto order = output.getAmbisonicOrder();
+    auto rotation = -panPosition * 90.0f;
+
+    for (int in = 0; in < numInputs; ++in)
+    {
+        float azimuth, elevation;
+        if (!getDirection(input.getTypeOfChannel(in), azimuth, elevation))
+            continue;
+
+        // A mono track is the source itself, straight ahead until panned
+        if (numInputs == 1)
+            azimuth = 0.0f;
+
+        computeHarmonics(azimuth + rotation, elevation, order, result[static_cast<size_t>(in)].data(), numOutputs);
+    }
+}
+
+void Panner::computeDecoderGains(Matrix& result) const
+{
+    // Basic sampling decoder: each speaker takes the field in its direction,
+    // with order weights (2l + 1) and shared between the speakers
+    auto order = juce::jmin(input.getAmbisonicOrder(), 3);
+    auto numSpeakers = 0;
+
+    for (int out = 0; out < numOutputs; ++out)
+    {
+        float azimuth, elevation;
+        if (getDirection(output.getTypeOfChannel(out), azimuth, elevation))
+            ++numSpeakers;
+    }
+
+    for (int out = 0; out < numOutputs; ++out)
+    {
+        float azimuth, elevation;
+        if (!getDirection(output.getTypeOfChannel(out), azimuth, elevation))
+            continue;
+
+        std::array<float, maxChannels> harmonics {};
+        computeHarmonics(azimuth, elevation, order, harmonics.data(), maxChannels);
+
+        for (int in = 0; in < numInputs; ++in)
+        {
+            auto l = static_cast<int>(std::sqrt(static_cast<float>(in)));
+            result[static_cast<size_t>(in)][static_cast<size_t>(out)] = harmonics[static_cast<size_t>(in)] * (2 * l + 1) / static_cast<float>(numSpeakers);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+
+// Places a track's channels on the mix bus.
+//
+// The track and bus layouts give a gain matrix (track channel x bus channel)
+// for the current pan position:
+//  - onto speakers, a mono track is panned between left and right with a
+//    constant-power (-3 dB centre) law; other tracks go channel for channel,
+//    with the pan as a balance, and channels the bus lacks are folded down
+//    onto its left and right at -3 dB (LFE is dropped);
+//  - onto an ambisonic bus, every channel is encoded (ambiX: ACN, SN3D) at
+//    its speaker's direction, turned by up to 90 degrees with the pan;
+//    ambisonic tracks pass through unchanged;
+//  - an ambisonic track onto speakers is decoded by sampling each speaker's
+//    direction.
+//
+// The matrix is rebuilt on the audio thread when the pan moves, and applied
+// as one vectorised multiply-add per non-zero gain, ramped across the block
+// from the previous gains.
+class Panner
+{
+public:
+    static constexpr int maxChannels = 16;  // up to 3rd-order ambisonics
+
+    Panner();
+
+    // Not while processing
+    void prepare(const juce::AudioChannelSet& trackLayout, const juce::AudioChannelSet& busLayout);
+
+    // -1 (left) to 1 (right); any thread
+    void setPan(float newPan) { pan.store(juce::jlimit(-1.0f, 1.0f, newPan), std::memory_order_relaxed); }
+    float getPan() const { return pan.load(std::memory_order_relaxed); }
+
+    // Audio thread. Adds numSamples of source to bus.
+    void addToBus(const juce::AudioBuffer<float>& source, juce::AudioBuffer<float>& bus, int numSamples);
+    void addToBus(const juce::AudioBuffer<float>& source, juce::AudioBuffer<double>& bus, int numSamples);
+
+private:
+    using Matrix = std::array<std::array<float, maxChannels>, maxChannels>;  // [track][bus]
+
+    template <typename SampleType>
+    void add(const juce::AudioBuffer<float>& source, juce::AudioBuffer<SampleType>& bus, int numSamples);
+
+    void computeGains(float panPosition, Matrix& result) const;
+    void computeSpeakerGains(float panPosition, Matrix& result) const;
+    void computeEncoderGains(float panPosition, Matrix& result) const;
+    void computeDecoderGains(Matrix& result) const;
+
+    juce::AudioChannelSet input = juce::AudioChannelSet::stereo();
+    juce::AudioChannelSet output = juce::AudioChannelSet::stereo();
+    int numInputs = 2;
+    int numOutputs = 2;
+
+    std::atomic<float> pan { 0.0f };
+    float computedPan = 0.0f;
+    Matrix previousGains {};
+    Matrix gains {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Panner)
+};
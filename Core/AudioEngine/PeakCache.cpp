@@ -0,0 +1,422 @@
+#include "PeakCache.h"
+
+// File layout (little endian):
+//   "SFPK", int version, int numChannels, int numLevels, double sampleRate,
+//   int64 lengthInSamples, int64 mediaSize, int64 mediaModifiedMs
+//   per level: int samplesPerPeak, int reserved, int64 numPeaks, int64 offset
+//   level data, 8-byte aligned: int16 [peak][channel][min, max, rms]
+namespace
+{
+    constexpr int headerSize = 48;
+    constexpr int levelEntrySize = 24;
+    constexpr int valuesPerPeak = 3;
+    constexpr int maxPeakChannels = 32;
+
+    juce::int64 align8(juce::int64 value) { return (value + 7) & ~juce::int64(7); }
+
+    juce::int16 toInt16(float value)
+    {
+        return static_cast<juce::int16>(juce::jlimit(-32767, 32767, juce::roundToInt(value * 32767.0f)));
+    }
+
+    float fromInt16(juce::int16 value) { return static_cast<float>(value) / 32767.0f; }
+
+    struct LevelLayout
+    {
+        int samplesPerPeak;
+        juce::int64 numPeaks;
+        juce::int64 offset;
+    };
+}
+
+PeakFile::PeakFile()
+{
+}
+
+PeakFile::~PeakFile()
+{
+}
+
+bool PeakFile::open(const juce::File& peakFile, const juce::File& mediaFile)
+{
+    levels.clear();
+    mappedFile = std::make_unique<juce::MemoryMappedFile>(peakFile, juce::MemoryMappedFile::readOnly);
+
+    auto* base = static_cast<const char*>(mappedFile->getData());
+    auto size = static_cast<juce::int64>(mappedFile->getSize());
+
+    if (base == nullptr || size < headerSize || std::memcmp(base, "SFPK", 4) != 0
+        || juce::ByteOrder::littleEndianInt(base + 4) != currentVersion)
+    {
+        mappedFile.reset();
+        return false;
+    }
+
+    // Stale if the media changed since the peaks were built
+    if (static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(base + 32)) != mediaFile.getSize()
+        || static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(base + 40)) != mediaFile.getLastModificationTime().toMilliseconds())
+    {
+        mappedFile.reset();
+        return false;
+    }
+
+    numChannels = static_cast<int>(juce::ByteOrder::littleEndianInt(base + 8));
+    auto numLevels = static_cast<int>(juce::ByteOrder::littleEndianInt(base + 12));
+
+    auto rateBits = juce::ByteOrder::littleEndianInt64(base + 16);
+    std::memcpy(&sampleRate, &rateBits, sizeof(sampleRate));
+    lengthInSamples = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(base + 24));
+
+    if (numChannels <= 0 || numChannels > maxPeakChannels || numLevels <= 0 || numLevels > maxLevels
+        || size < headerSize + numLevels * levelEntrySize)
+    {
+        mappedFile.reset();
+        return false;
+    }
+
+    for (int i = 0; i < numLevels; ++i)
+    {
+        auto* entry = base + headerSize + i * levelEntrySize;
+
+        Level level;
+        level.samplesPerPeak = static_cast<int>(juce::ByteOrder::littleEndianInt(entry));
+        level.numPeaks = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(entry + 8));
+        auto offset = static_cast<juce::int64>(juce::ByteOrder::littleEndianInt64(entry + 16));
+
+        if (level.samplesPerPeak <= 0 || offset < 0
+            || offset + level.numPeaks * numChannels * valuesPerPeak * (juce::int64) sizeof(juce::int16) > size)
+        {
+            levels.clear();
+            mappedFile.reset();
+            return false;
+        }
+
+        level.data = reinterpret_cast<const juce::int16*>(base + offset);
+        levels.push_back(level);
+    }
+
+    return true;
+}
+
+void PeakFile::getPeaks(int channel, juce::int64 startSample, juce::int64 endSample,
+                        Peak* destColumns, int numColumns) const
+{
+    if (numColumns <= 0)
+        return;
+
+    if (levels.empty() || channel < 0 || channel >= numChannels || endSample <= startSample)
+    {
+        std::fill(destColumns, destColumns + numColumns, Peak());
+        return;
+    }
+
+    // Coarsest level that still has at least one peak per column, so each
+    // column reads fewer than levelFactor + 1 peaks whatever the zoom
+    auto samplesPerColumn = static_cast<double>(endSample - startSample) / numColumns;
+    const Level* level = &levels.front();
+
+    for (const auto& candidate : levels)
+        if (candidate.samplesPerPeak <= samplesPerColumn)
+            level = &candidate;
+
+    auto samplesPerPeak = static_cast<juce::int64>(level->samplesPerPeak);
+
+    for (int column = 0; column < numColumns; ++column)
+    {
+        auto columnStart = startSample + static_cast<juce::int64>(column * samplesPerColumn);
+        auto columnEnd = startSample + static_cast<juce::int64>((column + 1) * samplesPerColumn);
+
+        auto firstPeak = juce::jlimit(juce::int64(0), level->numPeaks, columnStart / samplesPerPeak);
+        auto endPeak = juce::jlimit(juce::int64(0), level->numPeaks,
+                                    juce::jmax(firstPeak + 1, (columnEnd + samplesPerPeak - 1) / samplesPerPeak));
+
+        Peak peak;
+
+        if (firstPeak < endPeak)
+        {
+            juce::int16 lowest = 32767, highest = -32767;
+            float sumOfSquares = 0.0f;
+
+            for (auto index = firstPeak; index < endPeak; ++index)
+            {
+                const auto* values = level->data + (index * numChannels + channel) * valuesPerPeak;
+                lowest = juce::jmin(lowest, values[0]);
+                highest = juce::jmax(highest, values[1]);
+
+                auto rms = fromInt16(values[2]);
+                sumOfSquares += rms * rms;
+            }
+
+            peak.min = fromInt16(lowest);
+            peak.max = fromInt16(highest);
+            peak.rms = std::sqrt(sumOfSquares / static_cast<float>(endPeak - firstPeak));
+        }
+
+        destColumns[column] = peak;
+    }
+}
+
+//==============================================================================
+class PeakCache::BuildJob : public juce::ThreadPoolJob
+{
+public:
+    BuildJob(PeakCache& owner, const juce::File& media)
+        : juce::ThreadPoolJob("Peaks " + media.getFileName()), cache(owner), mediaFile(media)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        cache.build(mediaFile);
+
+        auto* owner = &cache;
+        auto file = mediaFile;
+
+        juce::MessageManager::callAsync([owner, file]
+        {
+            auto peaks = owner->openExisting(file);
+            auto callbacks = std::move(owner->pendingBuilds[file.getFullPathName()]);
+            owner->pendingBuilds.erase(file.getFullPathName());
+
+            for (auto& callback : callbacks)
+                callback(peaks);
+        });
+
+        return jobHasFinished;
+    }
+
+private:
+    PeakCache& cache;
+    juce::File mediaFile;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BuildJob)
+};
+
+PeakCache& PeakCache::getInstance()
+{
+    static PeakCache instance;
+    return instance;
+}
+
+PeakCache::PeakCache()
+    : segmentPool(juce::jmax(2, juce::SystemStats::getNumCpus()))
+{
+    formatManager.registerBasicFormats();
+}
+
+PeakCache::~PeakCache()
+{
+    buildPool.removeAllJobs(true, 5000);
+    segmentPool.removeAllJobs(true, 5000);
+}
+
+juce::File PeakCache::getPeakFileFor(const juce::File& mediaFile) const
+{
+    auto directory = mediaFile.getParentDirectory();
+
+    if (directory.hasWriteAccess())
+        return mediaFile.getSiblingFile(mediaFile.getFileName() + ".sfpk");
+
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("SignalForge")
+        .getChildFile("PeakCache")
+        .getChildFile(juce::String::toHexString(mediaFile.getFullPathName().hashCode64()) + ".sfpk");
+}
+
+std::shared_ptr<PeakFile> PeakCache::openExisting(const juce::File& mediaFile) const
+{
+    auto peakFile = getPeakFileFor(mediaFile);
+    if (!peakFile.existsAsFile())
+        return nullptr;
+
+    auto peaks = std::make_shared<PeakFile>();
+    return peaks->open(peakFile, mediaFile) ? peaks : nullptr;
+}
+
+void PeakCache::getPeaksAsync(const juce::File& mediaFile, PeakFileCallback onReady)
+{
+    if (auto peaks = openExisting(mediaFile))
+    {
+        onReady(peaks);
+        return;
+    }
+
+    // Several views may ask for the same file while it is being built
+    auto& callbacks = pendingBuilds[mediaFile.getFullPathName()];
+    callbacks.push_back(std::move(onReady));
+
+    if (callbacks.size() == 1)
+        buildPool.addJob(new BuildJob(*this, mediaFile), true);
+}
+
+bool PeakCache::build(const juce::File& mediaFile)
+{
+    std::unique_ptr<juce::AudioFormatReader> probe(formatManager.createReaderFor(mediaFile));
+    if (probe == nullptr || probe->lengthInSamples <= 0)
+        return false;
+
+    auto numChannels = juce::jlimit(1, maxPeakChannels, static_cast<int>(probe->numChannels));
+    auto length = probe->lengthInSamples;
+    auto sampleRate = probe->sampleRate;
+    probe.reset();
+
+    // Lay the levels out back to back after the header
+    std::vector<LevelLayout> layout;
+    auto offset = align8(headerSize + PeakFile::maxLevels * levelEntrySize);
+    juce::int64 levelSamplesPerPeak = PeakFile::baseSamplesPerPeak;
+
+    for (int i = 0; i < PeakFile::maxLevels; ++i)
+    {
+        auto numPeaks = (length + levelSamplesPerPeak - 1) / levelSamplesPerPeak;
+        layout.push_back({ static_cast<int>(levelSamplesPerPeak), numPeaks, offset });
+        offset = align8(offset + numPeaks * numChannels * valuesPerPeak * (juce::int64) sizeof(juce::int16));
+        levelSamplesPerPeak *= PeakFile::levelFactor;
+    }
+
+    juce::MemoryBlock fileData(static_cast<size_t>(offset), true);
+    auto* base = static_cast<char*>(fileData.getData());
+
+    {
+        juce::MemoryOutputStream header;
+        header.write("SFPK", 4);
+        header.writeInt(PeakFile::currentVersion);
+        header.writeInt(numChannels);
+        header.writeInt(static_cast<int>(layout.size()));
+        header.writeDouble(sampleRate);
+        header.writeInt64(length);
+        header.writeInt64(mediaFile.getSize());
+        header.writeInt64(mediaFile.getLastModificationTime().toMilliseconds());
+
+        for (const auto& level : layout)
+        {
+            header.writeInt(level.samplesPerPeak);
+            header.writeInt(0);
+            header.writeInt64(level.numPeaks);
+            header.writeInt64(level.offset);
+        }
+
+        std::memcpy(base, header.getData(), header.getDataSize());
+    }
+
+    auto levelData = [&](int levelIndex)
+    {
+        return reinterpret_cast<juce::int16*>(base + layout[(size_t) levelIndex].offset);
+    };
+
+    // Segments span a whole number of top-level peaks, so every level of a
+    // segment can be derived from that segment's own level 0
+    auto segmentLength = static_cast<juce::int64>(layout.back().samplesPerPeak) * PeakFile::levelFactor;
+    auto numSegments = static_cast<int>((length + segmentLength - 1) / segmentLength);
+
+    std::atomic<int> remaining { numSegments };
+    std::atomic<bool> failed { false };
+    juce::WaitableEvent allDone;
+
+    for (int segment = 0; segment < numSegments; ++segment)
+    {
+        segmentPool.addJob([&, segment]
+        {
+            auto segmentStart = segment * segmentLength;
+            auto segmentEnd = juce::jmin(length, segmentStart + segmentLength);
+
+            // Readers aren't thread-safe, so each segment opens its own
+            std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(mediaFile));
+
+            if (reader == nullptr)
+            {
+                failed = true;
+            }
+            else
+            {
+                constexpr int samplesPerPeak = PeakFile::baseSamplesPerPeak;
+                constexpr int chunkSize = samplesPerPeak * 512;
+                juce::AudioBuffer<float> chunk(numChannels, chunkSize);
+                auto* level0 = levelData(0);
+
+                for (auto chunkStart = segmentStart; chunkStart < segmentEnd; chunkStart += chunkSize)
+                {
+                    auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(chunkSize), segmentEnd - chunkStart));
+                    reader->read(chunk.getArrayOfWritePointers(), numChannels, chunkStart, numSamples);
+
+                    for (int start = 0; start < numSamples; start += samplesPerPeak)
+                    {
+                        auto count = juce::jmin(samplesPerPeak, numSamples - start);
+                        auto peakIndex = (chunkStart + start) / samplesPerPeak;
+
+                        for (int channel = 0; channel < numChannels; ++channel)
+                        {
+                            const auto* samples = chunk.getReadPointer(channel, start);
+                            auto range = juce::FloatVectorOperations::findMinAndMax(samples, count);
+
+                            float sumOfSquares = 0.0f;
+                            for (int i = 0; i < count; ++i)
+                                sumOfSquares += samples[i] * samples[i];
+
+                            auto* values = level0 + (peakIndex * numChannels + channel) * valuesPerPeak;
+                            values[0] = toInt16(range.getStart());
+                            values[1] = toInt16(range.getEnd());
+                            values[2] = toInt16(std::sqrt(sumOfSquares / static_cast<float>(count)));
+                        }
+                    }
+                }
+
+                // Each coarser level folds levelFactor peaks of the one below
+                for (size_t levelIndex = 1; levelIndex < layout.size(); ++levelIndex)
+                {
+                    const auto& level = layout[levelIndex];
+                    const auto& below = layout[levelIndex - 1];
+                    auto* dest = levelData(static_cast<int>(levelIndex));
+                    const auto* source = levelData(static_cast<int>(levelIndex) - 1);
+
+                    auto firstPeak = segmentStart / level.samplesPerPeak;
+                    auto endPeak = juce::jmin(level.numPeaks, (segmentEnd + level.samplesPerPeak - 1) / level.samplesPerPeak);
+
+                    for (auto peak = firstPeak; peak < endPeak; ++peak)
+                    {
+                        auto firstChild = peak * PeakFile::levelFactor;
+                        auto endChild = juce::jmin(below.numPeaks, firstChild + PeakFile::levelFactor);
+
+                        for (int channel = 0; channel < numChannels; ++channel)
+                        {
+                            juce::int16 lowest = 32767, highest = -32767;
+                            float sumOfSquares = 0.0f;
+
+                            for (auto child = firstChild; child < endChild; ++child)
+                            {
+                                const auto* values = source + (child * numChannels + channel) * valuesPerPeak;
+                                lowest = juce::jmin(lowest, values[0]);
+                                highest = juce::jmax(highest, values[1]);
+
+                                auto rms = fromInt16(values[2]);
+                                sumOfSquares += rms * rms;
+                            }
+
+                            auto* values = dest + (peak * numChannels + channel) * valuesPerPeak;
+                            values[0] = lowest;
+                            values[1] = highest;
+                            values[2] = toInt16(std::sqrt(sumOfSquares / static_cast<float>(juce::jmax(juce::int64(1), endChild - firstChild))));
+                        }
+                    }
+                }
+            }
+
+            if (--remaining == 0)
+                allDone.signal();
+        });
+    }
+
+    allDone.wait();
+
+    if (failed)
+    {
+        juce::Logger::writeToLog("Failed to build peaks for " + mediaFile.getFullPathName());
+        return false;
+    }
+
+    auto peakFile = getPeakFileFor(mediaFile);
+    peakFile.getParentDirectory().createDirectory();
+
+    juce::TemporaryFile temp(peakFile);
+    return temp.getFile().replaceWithData(fileData.getData(), fileData.getSize())
+           && temp.overwriteTargetFileWithTemporary();
+}
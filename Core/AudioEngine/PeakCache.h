@@ -0,0 +1,91 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Memory-mapped min/max/RMS peak pyramid for one media file.
+//
+// Level 0 holds one peak per 128 samples and every further level summarises
+// four peaks of the level below, so any zoom can be drawn by reading at most
+// a handful of peaks per pixel column.
+class PeakFile
+{
+public:
+    struct Peak
+    {
+        float min = 0.0f;
+        float max = 0.0f;
+        float rms = 0.0f;
+    };
+
+    PeakFile();
+    ~PeakFile();
+
+    // Fails if the file is missing, malformed or older than the media
+    bool open(const juce::File& peakFile, const juce::File& mediaFile);
+
+    int getNumChannels() const { return numChannels; }
+    double getSampleRate() const { return sampleRate; }
+    juce::int64 getLengthInSamples() const { return lengthInSamples; }
+
+    // One peak per column for the sample range [startSample, endSample)
+    void getPeaks(int channel, juce::int64 startSample, juce::int64 endSample,
+                  Peak* destColumns, int numColumns) const;
+
+    static constexpr int baseSamplesPerPeak = 128;
+    static constexpr int levelFactor = 4;
+    static constexpr int maxLevels = 7;
+    static constexpr int currentVersion = 1;
+
+private:
+    struct Level
+    {
+        int samplesPerPeak = 0;
+        juce::int64 numPeaks = 0;
+        const juce::int16* data = nullptr;  // [peak][channel][min, max, rms]
+    };
+
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    std::vector<Level> levels;
+    int numChannels = 0;
+    double sampleRate = 0.0;
+    juce::int64 lengthInSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeakFile)
+};
+
+//==============================================================================
+// Finds, builds and opens peak files. A peak file lives next to its media
+// ("take.wav.sfpk") or, if that folder is read-only, in the user cache.
+// Building splits the media into segments that are analysed in parallel.
+class PeakCache
+{
+public:
+    using PeakFileCallback = std::function<void(std::shared_ptr<PeakFile>)>;
+
+    static PeakCache& getInstance();
+
+    // Message thread. Calls onReady on the message thread, straight away if
+    // an up-to-date peak file already exists, otherwise once it is built.
+    void getPeaksAsync(const juce::File& mediaFile, PeakFileCallback onReady);
+
+    // Builds the peak file, blocking until done (runs segments on the pool)
+    bool build(const juce::File& mediaFile);
+
+    juce::File getPeakFileFor(const juce::File& mediaFile) const;
+
+private:
+    PeakCache();
+    ~PeakCache();
+
+    class BuildJob;
+
+    std::shared_ptr<PeakFile> openExisting(const juce::File& mediaFile) const;
+
+    juce::AudioFormatManager formatManager;
+    juce::ThreadPool buildPool { 2 };   // one job per file being built
+    juce::ThreadPool segmentPool;       // segments of those files
+
+    // Callbacks waiting on a build, by media path (message thread only)
+    std::map<juce::String, std::vector<PeakFileCallback>> pendingBuilds;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeakCache)
+};
@@ -0,0 +1,223 @@
+#include "PluginChain.h"
+#include "PluginHost.h"
+
+PluginChain::PluginChain()
+{
+    publishSnapshot();
+}
+
+PluginChain::~PluginChain()
+{
+    currentSnapshot = nullptr;
+    releasePool.releaseAll();
+}
+
+void PluginChain::prepareToPlay(double sampleRate, int samplesPerBlock)
+{
+    currentSampleRate = sampleRate;
+    currentBlockSize = samplesPerBlock;
+    prepared = true;
+
+    int totalLatency = 0;
+
+    for (auto& slot : slots)
+    {
+        slot.host->prepareToPlay(sampleRate, samplesPerBlock);
+
+        if (!slot.bypassed && slot.host->hasPlugin())
+            totalLatency += slot.host->getLatencySamples();
+    }
+
+    latencySamples = totalLatency;
+    latencyChanged = true;
+}
+
+void PluginChain::setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision newPrecision)
+{
+    precision = newPrecision;
+
+    for (auto& slot : slots)
+        slot.host->setProcessingPrecision(newPrecision);
+}
+
+void PluginChain::setChannelLayout(const juce::AudioChannelSet& newLayout)
+{
+    channelLayout = newLayout;
+
+    for (auto& slot : slots)
+        slot.host->setChannelLayout(newLayout);
+}
+
+void PluginChain::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer)
+{
+    process(buffer, midiBuffer);
+}
+
+void PluginChain::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiBuffer)
+{
+    process(buffer, midiBuffer);
+}
+
+template <typename SampleType>
+void PluginChain::process(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiBuffer)
+{
+    releasePool.beginAudioBlock();
+
+    if (auto* snapshot = currentSnapshot.load())
+    {
+        int totalLatency = 0;
+
+        for (auto* host : snapshot->activeSlots)
+        {
+            host->processBlock(buffer, midiBuffer);
+            totalLatency += host->getLatencySamples();
+        }
+
+        // Plugins may change their latency while running; the snapshot is
+        // only safe to walk here, so the total is passed on as an integer
+        storeLatency(totalLatency);
+    }
+
+    releasePool.endAudioBlock();
+}
+
+void PluginChain::releaseResources()
+{
+    for (auto& slot : slots)
+        slot.host->releaseResources();
+
+    prepared = false;
+    releasePool.collectGarbage();
+}
+
+PluginHost* PluginChain::getSlot(int slotIndex)
+{
+    return isValidSlot(slotIndex) ? slots[(size_t) slotIndex].host.get() : nullptr;
+}
+
+int PluginChain::insertSlot(int slotIndex)
+{
+    if (!isValidSlot(slotIndex))
+        slotIndex = getNumSlots();
+
+    Slot slot;
+    slot.host = std::make_unique<PluginHost>();
+    slot.host->setProcessingPrecision(precision);
+    slot.host->setChannelLayout(channelLayout);
+
+    if (prepared)
+        slot.host->prepareToPlay(currentSampleRate, currentBlockSize);
+
+    slots.insert(slots.begin() + slotIndex, std::move(slot));
+    publishSnapshot();
+    return slotIndex;
+}
+
+void PluginChain::removeSlot(int slotIndex)
+{
+    if (!isValidSlot(slotIndex))
+        return;
+
+    auto removedHost = std::move(slots[(size_t) slotIndex].host);
+    slots.erase(slots.begin() + slotIndex);
+
+    // The audio thread may still be inside the removed host until the new
+    // snapshot has been picked up
+    publishSnapshot();
+    releasePool.retire(std::move(removedHost));
+}
+
+void PluginChain::moveSlot(int fromIndex, int toIndex)
+{
+    if (!isValidSlot(fromIndex) || !isValidSlot(toIndex) || fromIndex == toIndex)
+        return;
+
+    auto slot = std::move(slots[(size_t) fromIndex]);
+    slots.erase(slots.begin() + fromIndex);
+    slots.insert(slots.begin() + toIndex, std::move(slot));
+    publishSnapshot();
+}
+
+void PluginChain::setSlotBypassed(int slotIndex, bool shouldBeBypassed)
+{
+    if (!isValidSlot(slotIndex) || slots[(size_t) slotIndex].bypassed == shouldBeBypassed)
+        return;
+
+    slots[(size_t) slotIndex].bypassed = shouldBeBypassed;
+    publishSnapshot();
+}
+
+bool PluginChain::isSlotBypassed(int slotIndex) const
+{
+    return isValidSlot(slotIndex) && slots[(size_t) slotIndex].bypassed;
+}
+
+bool PluginChain::loadPlugin(int slotIndex, const juce::PluginDescription& description)
+{
+    if (!isValidSlot(slotIndex))
+        return false;
+
+    // PluginHost swaps the new processor in lock-free, so only the snapshot
+    // needs refreshing for a slot that was previously empty
+    auto loaded = slots[(size_t) slotIndex].host->loadPlugin(description);
+    publishSnapshot();
+    return loaded;
+}
+
+void PluginChain::loadPluginAsync(int slotIndex, const juce::PluginDescription& description,
+                                  const juce::MemoryBlock& state, std::function<void(bool)> onComplete)
+{
+    if (!isValidSlot(slotIndex))
+    {
+        if (onComplete)
+            onComplete(false);
+        return;
+    }
+
+    // The callback only runs while the host is alive, and hosts never outlive
+    // their chain
+    slots[(size_t) slotIndex].host->loadPluginAsync(description, state, [this, onComplete](bool loaded)
+    {
+        publishSnapshot();
+
+        if (onComplete)
+            onComplete(loaded);
+    });
+}
+
+void PluginChain::unloadPlugin(int slotIndex)
+{
+    if (!isValidSlot(slotIndex) || !slots[(size_t) slotIndex].host->hasPlugin())
+        return;
+
+    slots[(size_t) slotIndex].host->unloadPlugin();
+    publishSnapshot();
+}
+
+void PluginChain::storeLatency(int totalLatency)
+{
+    if (latencySamples.exchange(totalLatency) != totalLatency)
+        latencyChanged = true;
+}
+
+void PluginChain::publishSnapshot()
+{
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->activeSlots.reserve(slots.size());
+    int totalLatency = 0;
+
+    for (auto& slot : slots)
+    {
+        if (!slot.bypassed && slot.host->hasPlugin())
+        {
+            snapshot->activeSlots.push_back(slot.host.get());
+            totalLatency += slot.host->getLatencySamples();
+        }
+    }
+
+    currentSnapshot = snapshot.get();
+    releasePool.retire(std::move(ownedSnapshot));
+    ownedSnapshot = std::move(snapshot);
+    latencySamples = totalLatency;
+    latencyChanged = true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <JuceHeader.h>
+#include "DeferredReleasePool.h"
+
+class PluginHost;
+
+// Ordered chain of plugin insert slots for a track.
+//
+// Slots are edited on the message thread. Every edit publishes an immutable
+// snapshot listing only the active (loaded, non-bypassed) slots, which the
+// audio thread picks up with a single atomic load, so a bypassed slot costs
+// nothing and the audio thread never takes a lock. All slots process the
+// track buffer in place.
+class PluginChain
+{
+public:
+    PluginChain();
+    ~PluginChain();
+
+    // Passed on to every slot; take effect from the next prepareToPlay
+    void setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision newPrecision);
+    void setChannelLayout(const juce::AudioChannelSet& newLayout);
+
+    void prepareToPlay(double sampleRate, int samplesPerBlock);
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer);
+    void processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiBuffer);
+    void releaseResources();
+
+    // Slot management (message thread)
+    int getNumSlots() const { return static_cast<int>(slots.size()); }
+    PluginHost* getSlot(int slotIndex);
+    int insertSlot(int slotIndex = -1);
+    void removeSlot(int slotIndex);
+    void moveSlot(int fromIndex, int toIndex);
+    void setSlotBypassed(int slotIndex, bool shouldBeBypassed);
+    bool isSlotBypassed(int slotIndex) const;
+    bool loadPlugin(int slotIndex, const juce::PluginDescription& description);
+    void loadPluginAsync(int slotIndex, const juce::PluginDescription& description,
+                         const juce::MemoryBlock& state, std::function<void(bool)> onComplete = nullptr);
+    void unloadPlugin(int slotIndex);
+
+    // Latency of the active slots, for plugin delay compensation. Any thread;
+    // updated when the snapshot changes and after each processed block.
+    int getLatencySamples() const { return latencySamples.load(); }
+    bool checkAndClearLatencyChanged() { return latencyChanged.exchange(false); }
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<PluginHost> host;
+        bool bypassed = false;
+    };
+
+    struct Snapshot
+    {
+        std::vector<PluginHost*> activeSlots;
+    };
+
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiBuffer);
+
+    bool isValidSlot(int slotIndex) const { return slotIndex >= 0 && slotIndex < getNumSlots(); }
+    void publishSnapshot();
+    void storeLatency(int totalLatency);
+
+    std::vector<Slot> slots;
+    std::unique_ptr<Snapshot> ownedSnapshot;
+    std::atomic<Snapshot*> currentSnapshot { nullptr };
+    DeferredReleasePool releasePool;
+    std::atomic<int> latencySamples { 0 };
+    std::atomic<bool> latencyChanged { false };
+
+    double currentSampleRate = 44100.0;
+    int currentBlockSize = 512;
+    juce::AudioProcessor::ProcessingPrecision precision = juce::AudioProcessor::singlePrecision;
+    juce::AudioChannelSet channelLayout = juce::AudioChannelSet::stereo();
+    bool prepared = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginChain)
+};
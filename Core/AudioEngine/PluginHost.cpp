@@ -1,28 +1,71 @@
 #include "PluginHost.h"
+#include "PluginLoader.h"
+#include "PluginSandbox.h"
+#include "Panner.h"
 
-PluginHost::PluginHost()
+namespace
 {
-#ifdef SIGNALFORGE_PLUGINS
-    // Register plugin formats (VST3 and AU only - VST2 requires SDK)
-    formatManager.addFormat(std::make_unique<juce::VST3PluginFormat>());
-    
-#if JUCE_MAC
-    formatManager.addFormat(std::make_unique<juce::AudioUnitPluginFormat>());
-#endif
+    // Runs process on a copy of the block in the scratch buffer's sample
+    // type, widened to numChannels with silence, and copies the result back.
+    // A mono block is fed to both inputs of a stereo (or wider) plugin, and
+    // its left and right outputs are summed back at -6 dB so a plugin that
+    // passes audio through leaves the level as it was.
+    // The scratch is sized in prepareToPlay for the largest block and layout;
+    // a block that still doesn't fit passes through rather than allocate here.
+    template <typename From, typename To, typename Function>
+    void processConverted(juce::AudioBuffer<From>& buffer, juce::AudioBuffer<To>& scratch, int numChannels,
+                          Function&& process)
+    {
+        auto numBufferChannels = buffer.getNumChannels();
+        auto numSamples = buffer.getNumSamples();
+        numChannels = juce::jmax(numChannels, numBufferChannels);
 
-#if JUCE_PLUGINHOST_LV2
-    formatManager.addFormat(std::make_unique<juce::LV2PluginFormat>());
-#endif
-    
-    juce::Logger::writeToLog("Plugin host initialized with VST3/AU/LV2 format support");
-#else
-    juce::Logger::writeToLog("Plugin host initialized (placeholder mode - formats not available)");
-#endif
+        if (numChannels > scratch.getNumChannels() || numSamples > scratch.getNumSamples())
+        {
+            jassertfalse;
+            return;
+        }
+
+        juce::AudioBuffer<To> converted(scratch.getArrayOfWritePointers(), numChannels, numSamples);
+
+        auto monoIntoStereo = numBufferChannels == 1 && numChannels >= 2;
+        auto numFed = monoIntoStereo ? 2 : numBufferChannels;
+
+        for (int channel = 0; channel < numFed; ++channel)
+            std::copy_n(buffer.getReadPointer(juce::jmin(channel, numBufferChannels - 1)), numSamples,
+                        converted.getWritePointer(channel));
+
+        for (int channel = numFed; channel < numChannels; ++channel)
+            converted.clear(channel, 0, numSamples);
+
+        process(converted);
+
+        if (monoIntoStereo)
+        {
+            const auto* left = converted.getReadPointer(0);
+            const auto* right = converted.getReadPointer(1);
+            auto* mono = buffer.getWritePointer(0);
+
+            for (int i = 0; i < numSamples; ++i)
+                mono[i] = static_cast<From>((left[i] + right[i]) * To(0.5));
+
+            return;
+        }
+
+        for (int channel = 0; channel < numBufferChannels; ++channel)
+            std::copy_n(converted.getReadPointer(channel), numSamples, buffer.getWritePointer(channel));
+    }
+}
+
+PluginHost::PluginHost()
+{
+    registerPluginFormats(formatManager);
 }
 
 PluginHost::~PluginHost()
 {
     unloadPlugin();
+    releasePool.releaseAll();
 }
 
 void PluginHost::prepareToPlay(double sampleRate, int samplesPerBlock)
@@ -30,18 +73,102 @@ void PluginHost::prepareToPlay(double sampleRate, int samplesPerBlock)
     currentSampleRate = sampleRate;
     currentBlockSize = samplesPerBlock;
     
+    // Sized for the widest layout a track can have, so that a layout change
+    // or a plugin loaded later with more channels than the track still fits
+    auto numChannels = juce::jmax(channelLayout.size(), static_cast<int>(Panner::maxChannels));
+    if (plugin)
+        numChannels = juce::jmax(numChannels, plugin->getTotalNumInputChannels(), plugin->getTotalNumOutputChannels());
+
+    floatConversion.setSize(numChannels, samplesPerBlock);
+    doubleConversion.setSize(numChannels, samplesPerBlock);
+
     if (plugin)
     {
-        plugin->prepareToPlay(sampleRate, samplesPerBlock);
+        preparePlugin(*plugin);
+        updateLatency();
     }
+    else if (sandbox)
+    {
+        sandbox->prepareToPlay(sampleRate, samplesPerBlock);
+        updateLatency();
+    }
+}
+
+void PluginHost::preparePlugin(juce::AudioProcessor& processor)
+{
+    auto useDouble = precision == juce::AudioProcessor::doublePrecision
+                         && processor.supportsDoublePrecisionProcessing();
+
+    processor.setProcessingPrecision(useDouble ? juce::AudioProcessor::doublePrecision
+                                               : juce::AudioProcessor::singlePrecision);
+
+    auto wanted = getWantedLayout(processor);
+    if (wanted != processor.getBusesLayout() && !processor.setBusesLayout(wanted))
+        juce::Logger::writeToLog("PluginHost: " + processor.getName() + " doesn't support "
+                                 + channelLayout.getDescription() + ", keeping its own layout");
+
+    processor.prepareToPlay(currentSampleRate, currentBlockSize);
+}
+
+juce::AudioProcessor::BusesLayout PluginHost::getWantedLayout(const juce::AudioProcessor& processor) const
+{
+    // Only the main buses follow the track; sidechains stay as they are
+    auto layout = processor.getBusesLayout();
+
+    if (!layout.inputBuses.isEmpty())
+        layout.inputBuses.getReference(0) = channelLayout;
+    if (!layout.outputBuses.isEmpty())
+        layout.outputBuses.getReference(0) = channelLayout;
+
+    return layout;
 }
 
 void PluginHost::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer)
 {
-    if (plugin)
+    process(buffer, midiBuffer);
+}
+
+void PluginHost::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiBuffer)
+{
+    process(buffer, midiBuffer);
+}
+
+template <typename SampleType>
+void PluginHost::process(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiBuffer)
+{
+    constexpr auto isDouble = std::is_same_v<SampleType, double>;
+    releasePool.beginAudioBlock();
+
+    if (auto* activeProcessor = activePlugin.load())
+    {
+        auto runPlugin = [activeProcessor, &midiBuffer](auto& converted) { activeProcessor->processBlock(converted, midiBuffer); };
+        auto numPluginChannels = juce::jmax(activeProcessor->getTotalNumInputChannels(),
+                                            activeProcessor->getTotalNumOutputChannels());
+
+        if (activeProcessor->isUsingDoublePrecision() == isDouble && numPluginChannels <= buffer.getNumChannels())
+            activeProcessor->processBlock(buffer, midiBuffer);
+        else if (activeProcessor->isUsingDoublePrecision())
+            processConverted(buffer, doubleConversion, numPluginChannels, runPlugin);
+        else
+            processConverted(buffer, floatConversion, numPluginChannels, runPlugin);
+
+        // Plugins may change their latency while running
+        latencySamples = juce::jmax(0, activeProcessor->getLatencySamples());
+    }
+    else if (auto* activeHelper = activeSandbox.load())
     {
-        plugin->processBlock(buffer, midiBuffer);
+        // The helper process only deals in floats
+        if constexpr (isDouble)
+            processConverted(buffer, floatConversion, buffer.getNumChannels(),
+                             [activeHelper, &midiBuffer](auto& converted) { activeHelper->processBlock(converted, midiBuffer); });
+        else
+            activeHelper->processBlock(buffer, midiBuffer);
+
+        // The helper reports latency with each block
+        latencySamples = activeHelper->getLatencySamples();
     }
+
+    releasePool.endAudioBlock();
 }
 
 void PluginHost::releaseResources()
@@ -50,22 +177,40 @@ void PluginHost::releaseResources()
     {
         plugin->releaseResources();
     }
+
+    releasePool.collectGarbage();
 }
 
 bool PluginHost::loadPlugin(const juce::PluginDescription& description)
 {
     juce::Logger::writeToLog("Attempting to load plugin: " + description.name);
-    unloadPlugin();
     
 #ifdef SIGNALFORGE_PLUGINS
+    if (sandboxed && PluginSandbox::isSupported())
+    {
+        auto newSandbox = std::make_unique<PluginSandbox>();
+
+        if (newSandbox->launch(description, currentSampleRate, currentBlockSize))
+        {
+            installSandbox(std::move(newSandbox));
+            loadedDescription = description;
+            juce::Logger::writeToLog("Successfully loaded sandboxed plugin: " + description.name);
+            return true;
+        }
+
+        juce::Logger::writeToLog("Failed to load sandboxed plugin: " + description.name);
+        return false;
+    }
+
     juce::String errorMessage;
     juce::Logger::writeToLog("Creating plugin instance...");
     auto pluginInstance = formatManager.createPluginInstance(description, currentSampleRate, currentBlockSize, errorMessage);
     
     if (pluginInstance)
     {
-        plugin = std::move(pluginInstance);
-        plugin->prepareToPlay(currentSampleRate, currentBlockSize);
+        preparePlugin(*pluginInstance);
+        installPlugin(std::move(pluginInstance));
+        loadedDescription = description;
         juce::Logger::writeToLog("Successfully loaded plugin: " + description.name);
         return true;
     }
@@ -80,58 +225,91 @@ bool PluginHost::loadPlugin(const juce::PluginDescription& description)
 #endif
 }
 
-void PluginHost::unloadPlugin()
+void PluginHost::loadPluginAsync(const juce::PluginDescription& description, const juce::MemoryBlock& state,
+                                 std::function<void(bool)> onComplete)
 {
-    if (plugin)
+    juce::WeakReference<PluginHost> weakThis(this);
+    auto loadId = ++pendingLoad;
+    auto finish = [weakThis, loadId, description, onComplete](bool loaded)
     {
-        plugin->releaseResources();
-        plugin.reset();
+        auto* host = weakThis.get();
+
+        // Destroyed or superseded by a newer request while loading
+        if (host == nullptr || host->pendingLoad != loadId)
+            return;
+
+        host->pendingLoad = 0;
+        juce::Logger::writeToLog((loaded ? "Successfully loaded plugin: " : "Failed to load plugin: ") + description.name);
+
+        if (loaded)
+            host->loadedDescription = description;
+
+        if (onComplete)
+            onComplete(loaded);
+    };
+
+    if (sandboxed && PluginSandbox::isSupported())
+    {
+        loader->launchSandboxAsync(description, currentSampleRate, currentBlockSize, state,
+            [weakThis, loadId, finish](std::unique_ptr<PluginSandbox> newSandbox)
+            {
+                auto* host = weakThis.get();
+                auto loaded = newSandbox != nullptr;
+
+                if (loaded && host != nullptr && host->pendingLoad == loadId)
+                    host->installSandbox(std::move(newSandbox));
+
+                finish(loaded);
+            });
+        return;
     }
+
+    loader->loadAsync(description, currentSampleRate, currentBlockSize, state,
+        [weakThis, loadId, finish](std::unique_ptr<juce::AudioPluginInstance> instance, const juce::String& error)
+        {
+            auto* host = weakThis.get();
+            auto loaded = instance != nullptr;
+
+            if (!loaded)
+                juce::Logger::writeToLog("Plugin load error: " + error);
+
+            if (loaded && host != nullptr && host->pendingLoad == loadId)
+                host->installPlugin(std::move(instance));
+
+            finish(loaded);
+        });
 }
 
-void PluginHost::scanForPlugins()
+void PluginHost::unloadPlugin()
+{
+    activePlugin = nullptr;
+    activeSandbox = nullptr;
+    retireCurrent();
+    updateLatency();
+    loadedDescription = juce::PluginDescription();
+}
+
+void PluginHost::registerPluginFormats(juce::AudioPluginFormatManager& manager)
 {
-    knownPluginList.clear();
-    
 #ifdef SIGNALFORGE_PLUGINS
-    // Scan for plugins in default locations
-    for (int i = 0; i < formatManager.getNumFormats(); ++i)
-    {
-        auto* format = formatManager.getFormat(i);
-        auto pluginPaths = format->getDefaultLocationsToSearch();
-        
-        for (int pathIndex = 0; pathIndex < pluginPaths.getNumPaths(); ++pathIndex)
-        {
-            auto path = pluginPaths[pathIndex];
-            juce::FileSearchPath searchPath(path.getFullPathName());
-            
-            scanner = std::make_unique<juce::PluginDirectoryScanner>(
-                knownPluginList, *format, searchPath, true, juce::File{});
-            
-            juce::String pluginBeingScanned;
-            while (scanner->scanNextFile(false, pluginBeingScanned))
-            {
-                juce::Logger::writeToLog("Scanning: " + pluginBeingScanned);
-            }
-        }
-    }
+    // Register plugin formats (VST3 and AU only - VST2 requires SDK)
+    manager.addFormat(std::make_unique<juce::VST3PluginFormat>());
+    
+#if JUCE_MAC
+    manager.addFormat(std::make_unique<juce::AudioUnitPluginFormat>());
+#endif
+
+#if JUCE_PLUGINHOST_LV2
+    manager.addFormat(std::make_unique<juce::LV2PluginFormat>());
+#endif
 #else
-    // Add demo plugin for testing
-    juce::PluginDescription demoPlugin;
-    demoPlugin.name = "Demo Plugin";
-    demoPlugin.manufacturerName = "SignalForge";
-    demoPlugin.pluginFormatName = "Internal";
-    demoPlugin.category = "Effect";
-    demoPlugin.isInstrument = false;
-    knownPluginList.addType(demoPlugin);
+    juce::ignoreUnused(manager);
 #endif
-    
-    juce::Logger::writeToLog("Plugin scan complete. Found " + 
-                            juce::String(knownPluginList.getTypes().size()) + " plugins.");
 }
 
 juce::AudioProcessorEditor* PluginHost::createEditor()
 {
+    // Sandboxed plugins have no editor in this process
     if (plugin && plugin->hasEditor())
     {
         return plugin->createEditor();
@@ -153,6 +331,10 @@ void PluginHost::getStateInformation(juce::MemoryBlock& destData)
     {
         plugin->getStateInformation(destData);
     }
+    else if (sandbox)
+    {
+        sandbox->getStateInformation(destData);
+    }
 }
 
 void PluginHost::setStateInformation(const void* data, int sizeInBytes)
@@ -161,4 +343,69 @@ void PluginHost::setStateInformation(const void* data, int sizeInBytes)
     {
         plugin->setStateInformation(data, sizeInBytes);
     }
+    else if (sandbox)
+    {
+        sandbox->setStateInformation(data, sizeInBytes);
+    }
+}
+
+void PluginHost::installPlugin(std::unique_ptr<juce::AudioProcessor> newPlugin)
+{
+    // Loaders prepare in single precision and the plugin's own layout; redo
+    // it if double or another layout is wanted
+    auto wantsDouble = precision == juce::AudioProcessor::doublePrecision && newPlugin->supportsDoublePrecisionProcessing()
+                           && !newPlugin->isUsingDoublePrecision();
+    auto wanted = getWantedLayout(*newPlugin);
+    auto wantsLayout = wanted != newPlugin->getBusesLayout() && newPlugin->checkBusesLayoutSupported(wanted);
+
+    if (wantsDouble || wantsLayout)
+    {
+        newPlugin->releaseResources();
+        preparePlugin(*newPlugin);
+    }
+
+    // The conversion scratch can't grow while the audio thread may be using it
+    auto numPluginChannels = juce::jmax(newPlugin->getTotalNumInputChannels(), newPlugin->getTotalNumOutputChannels());
+    if (numPluginChannels > floatConversion.getNumChannels())
+        juce::Logger::writeToLog("PluginHost: " + newPlugin->getName() + " has more channels than the track;"
+                                 " it is bypassed until the audio device restarts");
+
+    // Publish first, then retire: the audio thread switches on its next block
+    activeSandbox = nullptr;
+    activePlugin = newPlugin.get();
+    retireCurrent();
+    plugin = std::move(newPlugin);
+    updateLatency();
+}
+
+void PluginHost::installSandbox(std::unique_ptr<PluginSandbox> newSandbox)
+{
+    activePlugin = nullptr;
+    activeSandbox = newSandbox.get();
+    retireCurrent();
+    sandbox = std::move(newSandbox);
+    updateLatency();
+}
+
+void PluginHost::retireCurrent()
+{
+    // Old instances are freed by the release pool once the audio thread is
+    // done with them, never on the audio thread itself
+    if (plugin)
+        releasePool.retire(std::move(plugin));
+
+    if (sandbox)
+        releasePool.retire(std::move(sandbox));
+}
+
+void PluginHost::updateLatency()
+{
+    auto newLatency = 0;
+
+    if (auto* activeProcessor = activePlugin.load())
+        newLatency = juce::jmax(0, activeProcessor->getLatencySamples());
+    else if (auto* activeHelper = activeSandbox.load())
+        newLatency = activeHelper->getLatencySamples();
+
+    latencySamples = newLatency;
 }
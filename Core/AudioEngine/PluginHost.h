@@ -1,5 +1,9 @@
 #pragma once
 #include <JuceHeader.h>
+#include "DeferredReleasePool.h"
+#include "PluginLoader.h"
+
+class PluginSandbox;
 
 class PluginHost
 {
@@ -7,35 +11,95 @@ public:
     PluginHost();
     ~PluginHost();
 
+    // Plugins that support it are prepared for double precision when that
+    // is selected; either processBlock converts for those that aren't.
+    // Takes effect from the next prepareToPlay or plugin load.
+    void setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision newPrecision) { precision = newPrecision; }
+    juce::AudioProcessor::ProcessingPrecision getProcessingPrecision() const { return precision; }
+
+    // The track's layout, asked of the plugin's main buses. A plugin that
+    // refuses it keeps its own and is run on a copy of the block with its
+    // channel count. Takes effect from the next prepareToPlay or plugin load.
+    void setChannelLayout(const juce::AudioChannelSet& newLayout) { channelLayout = newLayout; }
+
     void prepareToPlay(double sampleRate, int samplesPerBlock);
     void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer);
+    void processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiBuffer);
     void releaseResources();
 
     // Plugin management
     bool loadPlugin(const juce::PluginDescription& description);
     void unloadPlugin();
-    bool hasPlugin() const { return plugin != nullptr; }
+    bool hasPlugin() const { return plugin != nullptr || sandbox != nullptr; }
+    const juce::PluginDescription& getPluginDescription() const { return loadedDescription; }
+
+    // Creates, restores and prepares the plugin on a loader thread, then swaps
+    // it in without blocking the audio thread. onComplete runs on the message
+    // thread; a newer load request supersedes an older one still in flight.
+    void loadPluginAsync(const juce::PluginDescription& description, const juce::MemoryBlock& state,
+                         std::function<void(bool)> onComplete = nullptr);
+    bool isLoading() const { return pendingLoad != 0; }
+
+    // Run the next loaded plugin in a crash-isolated helper process
+    void setSandboxed(bool shouldBeSandboxed) { sandboxed = shouldBeSandboxed; }
+    bool isSandboxed() const { return sandboxed; }
+
+    // Latency reporting for plugin delay compensation, refreshed after each
+    // block; PluginChain sums it and flags changes
+    int getLatencySamples() const { return latencySamples.load(); }
 
-    // Plugin scanning
-    void scanForPlugins();
-    const juce::KnownPluginList& getPluginList() const { return knownPluginList; }
+    // Registers the formats this build can host (shared with PluginScanner)
+    static void registerPluginFormats(juce::AudioPluginFormatManager& manager);
 
     // Plugin editor
     juce::AudioProcessorEditor* createEditor();
     void closeEditor();
 
-    // Plugin state
+    // Plugin state. A sandboxed plugin's state is a request to its helper,
+    // so it may be taken from any thread while the host isn't being changed.
     void getStateInformation(juce::MemoryBlock& destData);
     void setStateInformation(const void* data, int sizeInBytes);
+    bool isRunningInSandbox() const { return plugin == nullptr && sandbox != nullptr; }
 
 private:
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiBuffer);
+
+    // Sets the plugin's precision and layout and prepares it
+    void preparePlugin(juce::AudioProcessor& processor);
+    juce::AudioProcessor::BusesLayout getWantedLayout(const juce::AudioProcessor& processor) const;
+
+    // Publish a prepared processor to the audio thread and retire the old one
+    void installPlugin(std::unique_ptr<juce::AudioProcessor> newPlugin);
+    void installSandbox(std::unique_ptr<PluginSandbox> newSandbox);
+    void retireCurrent();
+    void updateLatency();
+
+    // Owned on the message thread; the audio thread only sees the atomics
     std::unique_ptr<juce::AudioProcessor> plugin;
+    std::unique_ptr<PluginSandbox> sandbox;
+    std::atomic<juce::AudioProcessor*> activePlugin { nullptr };
+    std::atomic<PluginSandbox*> activeSandbox { nullptr };
+    DeferredReleasePool releasePool;
+
     juce::AudioPluginFormatManager formatManager;
-    juce::KnownPluginList knownPluginList;
-    std::unique_ptr<juce::PluginDirectoryScanner> scanner;
+    juce::SharedResourcePointer<PluginLoader> loader;
+    juce::PluginDescription loadedDescription;
+    bool sandboxed = false;
+    int pendingLoad = 0;
     
     double currentSampleRate = 44100.0;
     int currentBlockSize = 512;
+    juce::AudioProcessor::ProcessingPrecision precision = juce::AudioProcessor::singlePrecision;
+    juce::AudioChannelSet channelLayout = juce::AudioChannelSet::stereo();
+
+    // For blocks in the other precision than the plugin's, or with fewer
+    // channels, sized in prepareToPlay (audio thread)
+    juce::AudioBuffer<float> floatConversion;
+    juce::AudioBuffer<double> doubleConversion;
+
+    std::atomic<int> latencySamples { 0 };
     
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PluginHost)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginHost)
 };
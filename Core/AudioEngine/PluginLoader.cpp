@@ -0,0 +1,150 @@
+#include "PluginLoader.h"
+#include "PluginHost.h"
+#include "PluginSandbox.h"
+
+PluginLoader::PluginLoader()
+    : loaderPool(juce::jmax(2, juce::SystemStats::getNumCpus()))
+{
+    PluginHost::registerPluginFormats(formatManager);
+}
+
+PluginLoader::~PluginLoader()
+{
+    loaderPool.removeAllJobs(true, 10000);
+}
+
+void PluginLoader::loadAsync(const juce::PluginDescription& description, double sampleRate, int blockSize,
+                             const juce::MemoryBlock& state, InstanceCallback onLoaded)
+{
+    ++pendingLoads;
+    juce::WeakReference<PluginLoader> weakThis(this);
+
+    if (requiresMessageThread(description))
+    {
+        // Formats such as AU must be created with the message thread free;
+        // only the prepare moves to the pool
+        formatManager.createPluginInstanceAsync(description, sampleRate, blockSize,
+            [weakThis, sampleRate, blockSize, state, onLoaded](std::unique_ptr<juce::AudioPluginInstance> instance,
+                                                               const juce::String& error)
+            {
+                auto* loader = weakThis.get();
+
+                if (loader == nullptr)
+                    return;
+
+                if (instance == nullptr)
+                    loader->deliver(nullptr, error, onLoaded);
+                else
+                    loader->restoreAndPrepare(std::move(instance), sampleRate, blockSize, state, onLoaded);
+            });
+        return;
+    }
+
+    loaderPool.addJob([weakThis, description, sampleRate, blockSize, state, onLoaded]
+    {
+        // Format managers aren't safe to share between threads
+        juce::AudioPluginFormatManager jobFormatManager;
+        PluginHost::registerPluginFormats(jobFormatManager);
+
+        juce::String error;
+        auto* created = jobFormatManager.createPluginInstance(description, sampleRate, blockSize, error).release();
+
+        juce::MessageManager::callAsync([weakThis, created, error, sampleRate, blockSize, state, onLoaded]
+        {
+            std::unique_ptr<juce::AudioPluginInstance> instance(created);
+            auto* loader = weakThis.get();
+
+            if (loader == nullptr)
+                return;
+
+            if (instance == nullptr)
+                loader->deliver(nullptr, error, onLoaded);
+            else
+                loader->restoreAndPrepare(std::move(instance), sampleRate, blockSize, state, onLoaded);
+        });
+
+        return juce::ThreadPoolJob::jobHasFinished;
+    });
+}
+
+void PluginLoader::launchSandboxAsync(const juce::PluginDescription& description, double sampleRate, int blockSize,
+                                      const juce::MemoryBlock& state, SandboxCallback onLaunched)
+{
+    ++pendingLoads;
+    juce::WeakReference<PluginLoader> weakThis(this);
+
+    // The plugin lives in the helper process, so its state is restored there
+    loaderPool.addJob([weakThis, description, sampleRate, blockSize, state, onLaunched]
+    {
+        auto sandbox = std::make_unique<PluginSandbox>();
+
+        if (sandbox->launch(description, sampleRate, blockSize))
+        {
+            if (state.getSize() > 0)
+                sandbox->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+        }
+        else
+        {
+            sandbox.reset();
+        }
+
+        auto* launched = sandbox.release();
+        juce::MessageManager::callAsync([weakThis, launched, onLaunched]
+        {
+            std::unique_ptr<PluginSandbox> result(launched);
+            auto* loader = weakThis.get();
+
+            if (loader == nullptr)
+                return;
+
+            --loader->pendingLoads;
+            onLaunched(std::move(result));
+        });
+
+        return juce::ThreadPoolJob::jobHasFinished;
+    });
+}
+
+void PluginLoader::restoreAndPrepare(std::unique_ptr<juce::AudioPluginInstance> instance, double sampleRate,
+                                     int blockSize, const juce::MemoryBlock& state, InstanceCallback onLoaded)
+{
+    // Plugins expect their state on the message thread
+    if (state.getSize() > 0)
+        instance->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+
+    juce::WeakReference<PluginLoader> weakThis(this);
+    auto* restored = instance.release();
+
+    loaderPool.addJob([weakThis, restored, sampleRate, blockSize, onLoaded]
+    {
+        restored->prepareToPlay(sampleRate, blockSize);
+
+        juce::MessageManager::callAsync([weakThis, restored, onLoaded]
+        {
+            std::unique_ptr<juce::AudioPluginInstance> prepared(restored);
+
+            if (auto* loader = weakThis.get())
+                loader->deliver(std::move(prepared), {}, onLoaded);
+        });
+
+        return juce::ThreadPoolJob::jobHasFinished;
+    });
+}
+
+void PluginLoader::deliver(std::unique_ptr<juce::AudioPluginInstance> instance, const juce::String& error,
+                           InstanceCallback onLoaded)
+{
+    --pendingLoads;
+    onLoaded(std::move(instance), error);
+}
+
+bool PluginLoader::requiresMessageThread(const juce::PluginDescription& description)
+{
+    for (auto* format : formatManager.getFormats())
+    {
+        if (format->getName() == description.pluginFormatName)
+            return format->requiresUnblockedMessageThreadDuringCreation(description);
+    }
+
+    return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <JuceHeader.h>
+
+class PluginSandbox;
+
+// Instantiates plugins on background threads so that opening a session does
+// not freeze the GUI. Several plugins are created and prepared concurrently,
+// each job with its own format manager; state is restored on the message
+// thread in between, and results are delivered there, ready to be swapped
+// into a PluginHost.
+//
+// Shared through a juce::SharedResourcePointer held by the engine and every
+// PluginHost, so it is gone before JUCE shuts down.
+class PluginLoader
+{
+public:
+    using InstanceCallback = std::function<void(std::unique_ptr<juce::AudioPluginInstance>, const juce::String&)>;
+    using SandboxCallback = std::function<void(std::unique_ptr<PluginSandbox>)>;
+
+    PluginLoader();
+    ~PluginLoader();
+
+    // Call from the message thread
+    void loadAsync(const juce::PluginDescription& description, double sampleRate, int blockSize,
+                   const juce::MemoryBlock& state, InstanceCallback onLoaded);
+    void launchSandboxAsync(const juce::PluginDescription& description, double sampleRate, int blockSize,
+                            const juce::MemoryBlock& state, SandboxCallback onLaunched);
+
+    int getNumPendingLoads() const { return pendingLoads.load(); }
+
+private:
+    // Message thread; restores the state, then prepares on the pool
+    void restoreAndPrepare(std::unique_ptr<juce::AudioPluginInstance> instance, double sampleRate, int blockSize,
+                           const juce::MemoryBlock& state, InstanceCallback onLoaded);
+    void deliver(std::unique_ptr<juce::AudioPluginInstance> instance, const juce::String& error,
+                 InstanceCallback onLoaded);
+    bool requiresMessageThread(const juce::PluginDescription& description);
+
+    juce::AudioPluginFormatManager formatManager;  // message thread only
+    juce::ThreadPool loaderPool;
+    std::atomic<int> pendingLoads { 0 };
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PluginLoader)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginLoader)
+};
@@ -0,0 +1,740 @@
+#include "PluginSandbox.h"
+#include "PluginHost.h"
+#include "Panner.h"
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#if JUCE_LINUX
+ #include <fcntl.h>
+ #include <linux/futex.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+ #include <climits>
+ #include <ctime>
+#endif
+
+namespace
+{
+    const juce::String helperFlag = "--plugin-sandbox";
+
+    // Every bus layout a track can have, up to 7.1.4 and third-order ambisonics
+    constexpr int maxChannels = Panner::maxChannels;
+    constexpr int maxBlockSize = 8192;
+    constexpr size_t midiCapacity = PluginSandbox::maxMidiBytes;
+    constexpr size_t payloadCapacity = 32 * 1024 * 1024;
+
+    constexpr int helperStartTimeoutMs = 10000;
+    constexpr int controlTimeoutMs = 5000;
+    constexpr int stateSnapshotIntervalMs = 10000;
+    constexpr int spinIterations = 2000;
+
+    // Of a block period, so a late helper still leaves the rest of the
+    // callback for everything else
+    constexpr double responseBudget = 0.5;
+
+    enum ControlCommand : juce::uint32
+    {
+        commandPrepare = 1,
+        commandGetState,
+        commandSetState,
+        commandShutdown
+    };
+
+    static_assert(std::atomic<juce::uint32>::is_always_lock_free,
+                  "Shared-memory sequence counters must be lock-free");
+
+    void futexWait(std::atomic<juce::uint32>& word, juce::uint32 expectedValue, juce::int64 timeoutMicroseconds)
+    {
+#if JUCE_LINUX
+        timespec timeout;
+        timeout.tv_sec = static_cast<time_t>(timeoutMicroseconds / 1000000);
+        timeout.tv_nsec = static_cast<long>((timeoutMicroseconds % 1000000) * 1000);
+
+        // Not FUTEX_PRIVATE: the word lives in memory shared between processes
+        syscall(SYS_futex, reinterpret_cast<juce::uint32*>(&word), FUTEX_WAIT, expectedValue, &timeout, nullptr, 0);
+#else
+        juce::ignoreUnused(word, expectedValue, timeoutMicroseconds);
+        std::this_thread::yield();
+#endif
+    }
+
+    void futexWake(std::atomic<juce::uint32>& word)
+    {
+#if JUCE_LINUX
+        syscall(SYS_futex, reinterpret_cast<juce::uint32*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+        juce::ignoreUnused(word);
+#endif
+    }
+
+    size_t writeMidi(const juce::MidiBuffer& midi, juce::uint8* dest, size_t capacity)
+    {
+        size_t used = 0;
+
+        for (const auto metadata : midi)
+        {
+            // Events are framed with a 16-bit length; longer SysEx can't be
+            // sent across and is dropped rather than truncated
+            if (metadata.numBytes > std::numeric_limits<juce::uint16>::max())
+            {
+                jassertfalse;
+                continue;
+            }
+
+            auto eventSize = static_cast<juce::uint16>(metadata.numBytes);
+            auto needed = sizeof(juce::int32) + sizeof(juce::uint16) + eventSize;
+
+            if (used + needed > capacity)
+                break;
+
+            juce::int32 position = metadata.samplePosition;
+            std::memcpy(dest + used, &position, sizeof(position));
+            std::memcpy(dest + used + sizeof(position), &eventSize, sizeof(eventSize));
+            std::memcpy(dest + used + sizeof(position) + sizeof(eventSize), metadata.data, eventSize);
+            used += needed;
+        }
+
+        return used;
+    }
+
+    void readMidi(juce::MidiBuffer& midi, const juce::uint8* source, size_t numBytes)
+    {
+        midi.clear();
+        size_t used = 0;
+        constexpr auto headerSize = sizeof(juce::int32) + sizeof(juce::uint16);
+
+        while (used + headerSize <= numBytes)
+        {
+            juce::int32 position;
+            juce::uint16 eventSize;
+            std::memcpy(&position, source + used, sizeof(position));
+            std::memcpy(&eventSize, source + used + sizeof(position), sizeof(eventSize));
+
+            if (used + headerSize + eventSize > numBytes)
+                break;
+
+            midi.addEvent(source + used + headerSize, eventSize, position);
+            used += headerSize + eventSize;
+        }
+    }
+}
+
+struct PluginSandbox::SharedBlock
+{
+    // Futex words and sequence counters
+    std::atomic<juce::uint32> doorbell;
+    std::atomic<juce::uint32> audioRequest;
+    std::atomic<juce::uint32> audioResponse;
+    std::atomic<juce::uint32> controlRequest;
+    std::atomic<juce::uint32> controlResponse;
+    std::atomic<juce::uint32> helperReady;
+    std::atomic<juce::int32> latencySamples;
+
+    // Audio request, written by the host audio thread
+    juce::int32 numChannels;
+    juce::int32 numSamples;
+    juce::uint32 midiBytes;
+
+    // Control request, written by the host under its control lock
+    juce::uint32 controlCommand;
+    juce::int32 controlResult;
+    double sampleRate;
+    juce::int32 blockSize;
+    juce::uint32 descriptionBytes;
+    juce::uint32 payloadBytes;
+
+    alignas(64) float audio[maxChannels * maxBlockSize];
+    alignas(64) juce::uint8 midi[midiCapacity];
+    alignas(64) juce::uint8 payload[payloadCapacity];
+};
+
+//==============================================================================
+PluginSandbox::PluginSandbox()
+    : juce::Thread("Plugin Sandbox Watchdog")
+{
+}
+
+PluginSandbox::~PluginSandbox()
+{
+    shutdown();
+}
+
+bool PluginSandbox::isSupported()
+{
+#if JUCE_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool PluginSandbox::isHelperCommandLine(const juce::String& commandLine)
+{
+    return commandLine.trimStart().startsWith(helperFlag);
+}
+
+bool PluginSandbox::launch(const juce::PluginDescription& description, double sampleRate, int blockSize)
+{
+    shutdown();
+
+    if (!isSupported() || !createSharedMemory())
+        return false;
+
+    descriptionXml = description.createXml()->toString();
+    currentSampleRate = sampleRate;
+    currentBlockSize = blockSize;
+    lastKnownState.reset();
+
+    if (!startHelper())
+    {
+        destroySharedMemory();
+        return false;
+    }
+
+    startThread();
+    return true;
+}
+
+void PluginSandbox::shutdown()
+{
+    stopThread(2000);
+
+    if (shared == nullptr)
+        return;
+
+    if (helperReady.exchange(false))
+        sendControlRequest(commandShutdown, 1000);
+
+    {
+        const juce::ScopedLock sl(controlLock);
+        if (helper.isRunning() && !helper.waitForProcessToFinish(1000))
+            helper.kill();
+    }
+
+    destroySharedMemory();
+}
+
+void PluginSandbox::prepareToPlay(double sampleRate, int blockSize)
+{
+    currentSampleRate = sampleRate;
+    currentBlockSize = blockSize;
+
+    if (shared == nullptr || !helperReady.load())
+        return;
+
+    const juce::ScopedLock sl(controlLock);
+    shared->sampleRate = sampleRate;
+    shared->blockSize = blockSize;
+    sendControlRequest(commandPrepare, controlTimeoutMs);
+}
+
+void PluginSandbox::getStateInformation(juce::MemoryBlock& destData)
+{
+    const juce::ScopedLock sl(controlLock);
+
+    if (shared != nullptr && helperReady.load() && sendControlRequest(commandGetState, controlTimeoutMs))
+        lastKnownState.replaceAll(shared->payload, shared->payloadBytes);
+
+    // Falls back to the last state captured if the helper is unavailable
+    destData = lastKnownState;
+}
+
+void PluginSandbox::setStateInformation(const void* data, int sizeInBytes)
+{
+    const juce::ScopedLock sl(controlLock);
+    lastKnownState.replaceAll(data, static_cast<size_t>(sizeInBytes));
+
+    if (shared == nullptr || !helperReady.load() || static_cast<size_t>(sizeInBytes) > payloadCapacity)
+        return;
+
+    std::memcpy(shared->payload, data, static_cast<size_t>(sizeInBytes));
+    shared->payloadBytes = static_cast<juce::uint32>(sizeInBytes);
+    sendControlRequest(commandSetState, controlTimeoutMs);
+}
+
+void PluginSandbox::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer)
+{
+    // Any failure below leaves the block untouched (dry pass-through)
+    if (shared == nullptr || !helperReady.load())
+        return;
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), maxChannels);
+    auto numSamples = buffer.getNumSamples();
+
+    if (numSamples > maxBlockSize)
+        return;
+
+    // A previous request timed out: don't queue behind it
+    if (awaitingLateResponse)
+    {
+        if (shared->audioResponse.load(std::memory_order_acquire) != pendingAudioRequest)
+            return;
+
+        awaitingLateResponse = false;
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::copy(shared->audio + channel * maxBlockSize,
+                                          buffer.getReadPointer(channel), numSamples);
+
+    shared->numChannels = numChannels;
+    shared->numSamples = numSamples;
+    shared->midiBytes = static_cast<juce::uint32>(writeMidi(midiBuffer, shared->midi, midiCapacity));
+
+    pendingAudioRequest = shared->audioRequest.load() + 1;
+    shared->audioRequest.store(pendingAudioRequest, std::memory_order_release);
+    shared->doorbell.fetch_add(1);
+    futexWake(shared->doorbell);
+
+    // Spin briefly (the helper usually answers within microseconds), then
+    // sleep on the response word for at most half a block period
+    bool answered = false;
+    for (int i = 0; i < spinIterations && !answered; ++i)
+        answered = shared->audioResponse.load(std::memory_order_acquire) == pendingAudioRequest;
+
+    if (!answered)
+    {
+        auto budgetTicks = juce::Time::secondsToHighResolutionTicks(responseBudget * numSamples / currentSampleRate);
+        auto deadline = juce::Time::getHighResolutionTicks() + budgetTicks;
+
+        while (!answered)
+        {
+            auto observed = shared->audioResponse.load(std::memory_order_acquire);
+            answered = observed == pendingAudioRequest;
+
+            if (answered)
+                break;
+
+            auto remaining = deadline - juce::Time::getHighResolutionTicks();
+            if (remaining <= 0)
+            {
+                awaitingLateResponse = true;
+                return;
+            }
+
+            auto remainingMicroseconds = static_cast<juce::int64>(
+                juce::Time::highResolutionTicksToSeconds(remaining) * 1.0e6);
+            futexWait(shared->audioResponse, observed, juce::jmax((juce::int64) 1, remainingMicroseconds));
+        }
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        buffer.copyFrom(channel, 0, shared->audio + channel * maxBlockSize, numSamples);
+
+    // The caller's buffer has maxMidiBytes reserved, so this doesn't allocate
+    readMidi(midiBuffer, shared->midi, juce::jmin((size_t) shared->midiBytes, midiCapacity));
+}
+
+int PluginSandbox::getLatencySamples() const
+{
+    return shared != nullptr ? juce::jmax(0, static_cast<int>(shared->latencySamples.load())) : 0;
+}
+
+void PluginSandbox::run()
+{
+    auto lastSnapshot = juce::Time::getMillisecondCounter();
+
+    while (!threadShouldExit())
+    {
+        wait(250);
+
+        bool crashed = false;
+        {
+            const juce::ScopedLock sl(controlLock);
+            crashed = helperReady.load() && !helper.isRunning();
+        }
+
+        if (crashed)
+        {
+            helperReady = false;
+            juce::Logger::writeToLog("Sandboxed plugin helper exited unexpectedly, restarting");
+
+            if (!startHelper())
+                juce::Logger::writeToLog("Failed to restart sandboxed plugin helper");
+
+            continue;
+        }
+
+        // Keep a recent state so a restart loses as little as possible
+        if (juce::Time::getMillisecondCounter() - lastSnapshot > (juce::uint32) stateSnapshotIntervalMs)
+        {
+            juce::MemoryBlock state;
+            getStateInformation(state);
+            lastSnapshot = juce::Time::getMillisecondCounter();
+        }
+    }
+}
+
+bool PluginSandbox::createSharedMemory()
+{
+#if JUCE_LINUX
+    static std::atomic<int> instanceCounter { 0 };
+    sharedMemoryName = "/signalforge-sandbox-" + juce::String(static_cast<int>(getpid()))
+                       + "-" + juce::String(++instanceCounter);
+    sharedSize = sizeof(SharedBlock);
+
+    auto fd = shm_open(sharedMemoryName.toRawUTF8(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    if (ftruncate(fd, static_cast<off_t>(sharedSize)) != 0)
+    {
+        close(fd);
+        shm_unlink(sharedMemoryName.toRawUTF8());
+        return false;
+    }
+
+    // ftruncate zero-fills, which is a valid initial state for every field
+    auto* mapping = mmap(nullptr, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(sharedMemoryName.toRawUTF8());
+        return false;
+    }
+
+    shared = static_cast<SharedBlock*>(mapping);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void PluginSandbox::destroySharedMemory()
+{
+#if JUCE_LINUX
+    if (shared != nullptr)
+    {
+        munmap(shared, sharedSize);
+        shm_unlink(sharedMemoryName.toRawUTF8());
+    }
+#endif
+
+    shared = nullptr;
+    awaitingLateResponse = false;
+}
+
+bool PluginSandbox::startHelper()
+{
+    const juce::ScopedLock sl(controlLock);
+
+    if (helper.isRunning())
+        helper.kill();
+
+    auto descriptionUtf8 = descriptionXml.toUTF8();
+    auto descriptionBytes = descriptionUtf8.sizeInBytes();
+
+    if (descriptionBytes + lastKnownState.getSize() > payloadCapacity)
+        return false;
+
+    shared->helperReady.store(0);
+    shared->sampleRate = currentSampleRate;
+    shared->blockSize = currentBlockSize;
+    shared->descriptionBytes = static_cast<juce::uint32>(descriptionBytes);
+    shared->payloadBytes = static_cast<juce::uint32>(lastKnownState.getSize());
+    std::memcpy(shared->payload, descriptionUtf8.getAddress(), descriptionBytes);
+
+    if (lastKnownState.getSize() > 0)
+        std::memcpy(shared->payload + descriptionBytes, lastKnownState.getData(), lastKnownState.getSize());
+
+    juce::StringArray args;
+    args.add(juce::File::getSpecialLocation(juce::File::currentExecutableFile).getFullPathName());
+    args.add(helperFlag);
+    args.add(sharedMemoryName);
+#if JUCE_LINUX
+    args.add(juce::String(static_cast<int>(getpid())));
+#endif
+
+    if (!helper.start(args, 0))
+        return false;
+
+    auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32) helperStartTimeoutMs;
+    while (shared->helperReady.load() == 0)
+    {
+        if (!helper.isRunning() || juce::Time::getMillisecondCounter() > deadline)
+        {
+            helper.kill();
+            return false;
+        }
+
+        futexWait(shared->helperReady, 0, 50000);
+    }
+
+    // Discard any request the previous helper never answered
+    shared->audioResponse.store(shared->audioRequest.load());
+    shared->controlResponse.store(shared->controlRequest.load());
+    helperReady = true;
+    return true;
+}
+
+bool PluginSandbox::sendControlRequest(juce::uint32 command, int timeoutMs)
+{
+    const juce::ScopedLock sl(controlLock);
+
+    shared->controlCommand = command;
+    shared->controlResult = -1;
+
+    auto sequence = shared->controlRequest.load() + 1;
+    shared->controlRequest.store(sequence, std::memory_order_release);
+    shared->doorbell.fetch_add(1);
+    futexWake(shared->doorbell);
+
+    auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32) timeoutMs;
+    for (;;)
+    {
+        auto observed = shared->controlResponse.load(std::memory_order_acquire);
+        if (observed == sequence)
+            return shared->controlResult == 0;
+
+        if (juce::Time::getMillisecondCounter() > deadline)
+            return false;
+
+        futexWait(shared->controlResponse, observed, 10000);
+    }
+}
+
+//==============================================================================
+// Serves control requests beside the audio thread, so a slow state request
+// never makes an audio request miss its deadline
+class PluginSandboxHelper::ControlThread : public juce::Thread
+{
+public:
+    explicit ControlThread(PluginSandboxHelper& owner)
+        : juce::Thread("Plugin Sandbox Control"), helper(owner)
+    {
+    }
+
+    ~ControlThread() override
+    {
+        stopThread(2000);
+    }
+
+    void run() override
+    {
+        auto* shared = helper.shared;
+
+        while (!threadShouldExit())
+        {
+            auto doorbell = shared->doorbell.load();
+
+            if (shared->controlRequest.load(std::memory_order_acquire) != shared->controlResponse.load())
+            {
+                helper.handleControlRequest();
+                continue;
+            }
+
+            futexWait(shared->doorbell, doorbell, 500000);
+        }
+    }
+
+private:
+    PluginSandboxHelper& helper;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ControlThread)
+};
+
+//==============================================================================
+PluginSandboxHelper::PluginSandboxHelper()
+    : juce::Thread("Plugin Sandbox")
+{
+    PluginHost::registerPluginFormats(formatManager);
+}
+
+PluginSandboxHelper::~PluginSandboxHelper()
+{
+    controlThread.reset();
+    stopThread(2000);
+
+    if (plugin != nullptr)
+        plugin->releaseResources();
+
+    plugin.reset();
+
+#if JUCE_LINUX
+    if (mapping != nullptr)
+        munmap(mapping, mappingSize);
+#endif
+}
+
+bool PluginSandboxHelper::initialise(const juce::StringArray& args)
+{
+#if JUCE_LINUX
+    if (args.size() != 3 || args[0] != helperFlag)
+        return false;
+
+    parentProcessId = args[2].getIntValue();
+
+    auto fd = shm_open(args[1].toRawUTF8(), O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(PluginSandbox::SharedBlock))
+    {
+        close(fd);
+        return false;
+    }
+
+    mappingSize = sizeof(PluginSandbox::SharedBlock);
+    mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        return false;
+    }
+
+    shared = static_cast<PluginSandbox::SharedBlock*>(mapping);
+
+    auto descriptionText = juce::String::fromUTF8(reinterpret_cast<const char*>(shared->payload),
+                                                  static_cast<int>(shared->descriptionBytes));
+    auto descriptionXml = juce::parseXML(descriptionText);
+
+    juce::PluginDescription description;
+    if (descriptionXml == nullptr || !description.loadFromXml(*descriptionXml))
+        return false;
+
+    juce::String errorMessage;
+    plugin = formatManager.createPluginInstance(description, shared->sampleRate, shared->blockSize, errorMessage);
+
+    if (plugin == nullptr)
+    {
+        juce::Logger::writeToLog("Sandbox failed to load plugin: " + description.name + " - Error: " + errorMessage);
+        return false;
+    }
+
+    if (shared->payloadBytes > 0)
+        plugin->setStateInformation(shared->payload + shared->descriptionBytes, static_cast<int>(shared->payloadBytes));
+
+    plugin->prepareToPlay(shared->sampleRate, shared->blockSize);
+    midiBuffer.ensureSize(midiCapacity);
+    shared->latencySamples.store(plugin->getLatencySamples());
+
+    startThread(juce::Thread::Priority::highest);
+    controlThread = std::make_unique<ControlThread>(*this);
+    controlThread->startThread();
+
+    shared->helperReady.store(1);
+    futexWake(shared->helperReady);
+    return true;
+#else
+    juce::ignoreUnused(args);
+    return false;
+#endif
+}
+
+void PluginSandboxHelper::run()
+{
+    while (!threadShouldExit())
+    {
+        auto doorbell = shared->doorbell.load();
+
+        if (shared->audioRequest.load(std::memory_order_acquire) != shared->audioResponse.load())
+        {
+            handleAudioRequest();
+            continue;
+        }
+
+        futexWait(shared->doorbell, doorbell, 500000);
+
+#if JUCE_LINUX
+        // The host went away without asking us to shut down
+        if (static_cast<int>(getppid()) != parentProcessId)
+            break;
+#endif
+    }
+
+    juce::MessageManager::callAsync([] { juce::JUCEApplicationBase::quit(); });
+}
+
+void PluginSandboxHelper::handleControlRequest()
+{
+    auto sequence = shared->controlRequest.load(std::memory_order_acquire);
+    juce::int32 result = 0;
+
+    switch (shared->controlCommand)
+    {
+        case commandPrepare:
+        {
+            // Audio requests pass through dry until the plugin is ready again
+            const juce::ScopedLock sl(processLock);
+            plugin->releaseResources();
+            plugin->prepareToPlay(shared->sampleRate, shared->blockSize);
+            shared->latencySamples.store(plugin->getLatencySamples());
+            break;
+        }
+
+        case commandGetState:
+        {
+            juce::MemoryBlock state;
+            plugin->getStateInformation(state);
+
+            if (state.getSize() <= payloadCapacity)
+            {
+                std::memcpy(shared->payload, state.getData(), state.getSize());
+                shared->payloadBytes = static_cast<juce::uint32>(state.getSize());
+            }
+            else
+            {
+                result = -1;
+            }
+            break;
+        }
+
+        case commandSetState:
+            plugin->setStateInformation(shared->payload, static_cast<int>(shared->payloadBytes));
+            break;
+
+        case commandShutdown:
+        {
+            const juce::ScopedLock sl(processLock);
+            plugin->releaseResources();
+            shuttingDown = true;
+            signalThreadShouldExit();
+            controlThread->signalThreadShouldExit();
+            futexWake(shared->doorbell);
+            break;
+        }
+
+        default:
+            result = -1;
+            break;
+    }
+
+    shared->controlResult = result;
+    shared->controlResponse.store(sequence, std::memory_order_release);
+    futexWake(shared->controlResponse);
+}
+
+void PluginSandboxHelper::handleAudioRequest()
+{
+    auto sequence = shared->audioRequest.load(std::memory_order_acquire);
+    auto numChannels = juce::jlimit(0, maxChannels, static_cast<int>(shared->numChannels));
+    auto numSamples = juce::jlimit(0, maxBlockSize, static_cast<int>(shared->numSamples));
+
+    float* channels[maxChannels];
+    for (int channel = 0; channel < numChannels; ++channel)
+        channels[channel] = shared->audio + channel * maxBlockSize;
+
+    juce::AudioBuffer<float> buffer(channels, numChannels, numSamples);
+
+    // Left as it came, and so dry, while a prepare or shutdown has the plugin
+    const juce::ScopedTryLock sl(processLock);
+    if (sl.isLocked() && !shuttingDown)
+    {
+        readMidi(midiBuffer, shared->midi, juce::jmin((size_t) shared->midiBytes, midiCapacity));
+
+        plugin->processBlock(buffer, midiBuffer);
+
+        shared->midiBytes = static_cast<juce::uint32>(writeMidi(midiBuffer, shared->midi, midiCapacity));
+        shared->latencySamples.store(plugin->getLatencySamples());
+    }
+
+    shared->audioResponse.store(sequence, std::memory_order_release);
+    futexWake(shared->audioResponse);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Runs a single plugin in a helper process (this executable started with
+// --plugin-sandbox) so that a crashing plugin cannot take down the session.
+//
+// Audio, MIDI and control requests are exchanged through a shared-memory
+// block. Each direction is a single-producer/single-consumer slot guarded by
+// sequence counters, and the waiting side sleeps on a futex in that memory, so
+// a round trip costs two futex syscalls and two copies. The audio thread waits
+// at most half a block period; if the helper is late or has crashed, the
+// block passes through dry and a watchdog thread restarts the helper with the
+// last known plugin state.
+//
+// Only available where shared-memory futexes exist (Linux); elsewhere
+// isSupported() is false and PluginHost keeps the plugin in-process.
+class PluginSandbox : private juce::Thread
+{
+public:
+    PluginSandbox();
+    ~PluginSandbox() override;
+
+    static bool isSupported();
+
+    // Message thread
+    bool launch(const juce::PluginDescription& description, double sampleRate, int blockSize);
+    void shutdown();
+    void prepareToPlay(double sampleRate, int blockSize);
+    void getStateInformation(juce::MemoryBlock& destData);
+    void setStateInformation(const void* data, int sizeInBytes);
+
+    // Audio thread. Reading the helper's MIDI back never allocates if
+    // midiBuffer has had ensureSize(maxMidiBytes) beforehand.
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiBuffer);
+    static constexpr size_t maxMidiBytes = 64 * 1024;
+
+    bool isRunning() const { return helperReady.load(); }
+    int getLatencySamples() const;
+
+    // Child process entry point, see Main.cpp
+    static bool isHelperCommandLine(const juce::String& commandLine);
+
+    struct SharedBlock;
+
+private:
+    void run() override;
+
+    bool createSharedMemory();
+    void destroySharedMemory();
+    bool startHelper();
+    bool sendControlRequest(juce::uint32 command, int timeoutMs);
+
+    juce::String sharedMemoryName;
+    SharedBlock* shared = nullptr;
+    size_t sharedSize = 0;
+
+    juce::ChildProcess helper;
+    juce::CriticalSection controlLock;
+    std::atomic<bool> helperReady { false };
+
+    juce::String descriptionXml;
+    juce::MemoryBlock lastKnownState;
+    double currentSampleRate = 44100.0;
+    int currentBlockSize = 512;
+
+    juce::uint32 pendingAudioRequest = 0;
+    bool awaitingLateResponse = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginSandbox)
+};
+
+// Helper-process side: owns the plugin and serves requests from the host,
+// audio requests on this thread and control requests on a second one.
+class PluginSandboxHelper : private juce::Thread
+{
+public:
+    PluginSandboxHelper();
+    ~PluginSandboxHelper() override;
+
+    bool initialise(const juce::StringArray& args);
+
+private:
+    void run() override;
+    void handleControlRequest();
+    void handleAudioRequest();
+
+    class ControlThread;
+    std::unique_ptr<ControlThread> controlThread;
+
+    // Held by control requests that must not overlap processing
+    juce::CriticalSection processLock;
+    std::atomic<bool> shuttingDown { false };
+
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    PluginSandbox::SharedBlock* shared = nullptr;
+
+    juce::AudioPluginFormatManager formatManager;
+    std::unique_ptr<juce::AudioPluginInstance> plugin;
+    juce::MidiBuffer midiBuffer;
+    int parentProcessId = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginSandboxHelper)
+};
@@ -0,0 +1,329 @@
+#include "PluginScanner.h"
+#include "PluginHost.h"
+
+namespace
+{
+    const juce::String workerFlag = "--scan-plugin";
+
+    // Cache entries for files without plugins, alongside KnownPluginList's
+    const juce::String emptyFileTag = "EMPTYFILE";
+
+    juce::Time getFileModificationTime(const juce::String& fileOrIdentifier)
+    {
+        return juce::File::isAbsolutePath(fileOrIdentifier) ? juce::File(fileOrIdentifier).getLastModificationTime()
+                                                            : juce::Time();
+    }
+}
+
+PluginScanner::PluginScanner()
+    : juce::Thread("Plugin Scanner"),
+      workerPool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+{
+    PluginHost::registerPluginFormats(formatManager);
+    loadCache();
+}
+
+PluginScanner::~PluginScanner()
+{
+    cancelScan();
+
+    // A scan that finished just before shutdown still gets saved
+    if (isUpdatePending())
+    {
+        cancelAsyncUpdate();
+        applyScanResults();
+    }
+}
+
+void PluginScanner::startScan()
+{
+    if (isScanning())
+        return;
+
+    filesToScan = 0;
+    filesScanned = 0;
+    startThread();
+}
+
+void PluginScanner::cancelScan()
+{
+    signalThreadShouldExit();
+    workerPool.removeAllJobs(true, workerTimeoutMs);
+    stopThread(workerTimeoutMs);
+}
+
+float PluginScanner::getProgress() const
+{
+    auto total = filesToScan.load();
+    return total > 0 ? static_cast<float>(filesScanned.load()) / static_cast<float>(total) : 1.0f;
+}
+
+juce::File PluginScanner::getCacheFile() const
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("SignalForge/PluginCache.xml");
+}
+
+void PluginScanner::run()
+{
+#ifdef SIGNALFORGE_PLUGINS
+    for (int i = 0; i < formatManager.getNumFormats() && !threadShouldExit(); ++i)
+    {
+        auto* format = formatManager.getFormat(i);
+        auto formatName = format->getName();
+
+        for (const auto& fileOrIdentifier : findFilesNeedingScan(*format))
+        {
+            ++filesToScan;
+            workerPool.addJob([this, formatName, fileOrIdentifier]
+            {
+                if (!threadShouldExit())
+                    scanFileInWorkerProcess(formatName, fileOrIdentifier);
+
+                ++filesScanned;
+                return juce::ThreadPoolJob::jobHasFinished;
+            });
+        }
+    }
+
+    while (workerPool.getNumJobs() > 0)
+    {
+        if (threadShouldExit())
+        {
+            workerPool.removeAllJobs(true, workerTimeoutMs);
+            break;
+        }
+
+        wait(50);
+    }
+#else
+    // Add demo plugin for testing
+    juce::PluginDescription demoPlugin;
+    demoPlugin.name = "Demo Plugin";
+    demoPlugin.manufacturerName = "SignalForge";
+    demoPlugin.pluginFormatName = "Internal";
+    demoPlugin.category = "Effect";
+    demoPlugin.isInstrument = false;
+    knownPluginList.addType(demoPlugin);
+#endif
+
+    juce::Logger::writeToLog("Plugin scan complete. Scanned " + juce::String(filesScanned.load())
+                             + " changed files, " + juce::String(knownPluginList.getNumTypes())
+                             + " plugins known.");
+    triggerAsyncUpdate();
+}
+
+void PluginScanner::handleAsyncUpdate()
+{
+    applyScanResults();
+
+    if (onScanFinished)
+        onScanFinished();
+}
+
+void PluginScanner::applyScanResults()
+{
+    juce::StringArray failed;
+    {
+        const juce::ScopedLock sl(failedFilesLock);
+        failed.swapWith(failedFiles);
+    }
+
+    for (const auto& fileOrIdentifier : failed)
+        knownPluginList.addToBlacklist(fileOrIdentifier);
+
+    saveCache();
+}
+
+void PluginScanner::addFailedFile(const juce::String& fileOrIdentifier)
+{
+    const juce::ScopedLock sl(failedFilesLock);
+    failedFiles.addIfNotAlreadyThere(fileOrIdentifier);
+}
+
+void PluginScanner::addEmptyFile(const juce::String& fileOrIdentifier, juce::Time modificationTime)
+{
+    const juce::ScopedLock sl(emptyFilesLock);
+    emptyFiles[fileOrIdentifier] = modificationTime;
+}
+
+bool PluginScanner::isKnownEmptyFile(const juce::String& fileOrIdentifier)
+{
+    const juce::ScopedLock sl(emptyFilesLock);
+
+    auto entry = emptyFiles.find(fileOrIdentifier);
+    if (entry == emptyFiles.end())
+        return false;
+
+    // Changed or gone since: probe it again
+    if (!juce::File(fileOrIdentifier).exists() || entry->second != getFileModificationTime(fileOrIdentifier))
+    {
+        emptyFiles.erase(entry);
+        return false;
+    }
+
+    return true;
+}
+
+juce::StringArray PluginScanner::findFilesNeedingScan(juce::AudioPluginFormat& format)
+{
+    // Drop entries whose plugin has been uninstalled
+    for (const auto& type : knownPluginList.getTypesForFormat(format))
+    {
+        if (!format.doesPluginStillExist(type))
+            knownPluginList.removeType(type);
+    }
+
+    auto candidates = format.searchPathsForPlugins(format.getDefaultLocationsToSearch(), true, true);
+    const auto blacklisted = knownPluginList.getBlacklistedFiles();
+
+    juce::StringArray needingScan;
+    for (const auto& fileOrIdentifier : candidates)
+    {
+        if (blacklisted.contains(fileOrIdentifier) || isKnownEmptyFile(fileOrIdentifier))
+            continue;
+
+        if (!knownPluginList.isListingUpToDate(fileOrIdentifier, format))
+            needingScan.add(fileOrIdentifier);
+    }
+
+    return needingScan;
+}
+
+void PluginScanner::scanFileInWorkerProcess(const juce::String& formatName, const juce::String& fileOrIdentifier)
+{
+    juce::TemporaryFile resultFile(".xml");
+
+    juce::StringArray args;
+    args.add(juce::File::getSpecialLocation(juce::File::currentExecutableFile).getFullPathName());
+    args.add(workerFlag);
+    args.add(formatName);
+    args.add(fileOrIdentifier);
+    args.add(resultFile.getFile().getFullPathName());
+
+    juce::ChildProcess worker;
+    if (!worker.start(args, 0))
+    {
+        juce::Logger::writeToLog("Failed to launch plugin scan worker for: " + fileOrIdentifier);
+        return;
+    }
+
+    auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32) workerTimeoutMs;
+    while (!worker.waitForProcessToFinish(100))
+    {
+        if (threadShouldExit())
+        {
+            worker.kill();
+            return;
+        }
+
+        if (juce::Time::getMillisecondCounter() > deadline)
+        {
+            worker.kill();
+            juce::Logger::writeToLog("Plugin scan timed out, blacklisting: " + fileOrIdentifier);
+            addFailedFile(fileOrIdentifier);
+            return;
+        }
+    }
+
+    auto results = juce::parseXML(resultFile.getFile());
+    if (worker.getExitCode() != 0 || results == nullptr)
+    {
+        juce::Logger::writeToLog("Plugin crashed during scan, blacklisting: " + fileOrIdentifier);
+        addFailedFile(fileOrIdentifier);
+        return;
+    }
+
+    auto modificationTime = getFileModificationTime(fileOrIdentifier);
+    auto numFound = 0;
+
+    for (auto* element : results->getChildIterator())
+    {
+        juce::PluginDescription description;
+        if (description.loadFromXml(*element))
+        {
+            // Keyed by path and modification time for the next incremental scan
+            description.lastFileModTime = modificationTime;
+            description.lastInfoUpdateTime = juce::Time::getCurrentTime();
+            knownPluginList.addType(description);
+            ++numFound;
+        }
+    }
+
+    // Nothing in the list would mark it as scanned, so remember it here;
+    // only files on disk have a modification time to check against
+    if (numFound == 0 && juce::File::isAbsolutePath(fileOrIdentifier))
+        addEmptyFile(fileOrIdentifier, modificationTime);
+}
+
+void PluginScanner::loadCache()
+{
+    if (auto xml = juce::parseXML(getCacheFile()))
+    {
+        knownPluginList.recreateFromXml(*xml);
+
+        const juce::ScopedLock sl(emptyFilesLock);
+        for (auto* element : xml->getChildWithTagNameIterator(emptyFileTag))
+            emptyFiles[element->getStringAttribute("file")] = juce::Time(element->getStringAttribute("modified").getLargeIntValue());
+    }
+}
+
+void PluginScanner::saveCache()
+{
+    auto cacheFile = getCacheFile();
+
+    if (!cacheFile.getParentDirectory().exists())
+        cacheFile.getParentDirectory().createDirectory();
+
+    if (auto xml = knownPluginList.createXml())
+    {
+        {
+            const juce::ScopedLock sl(emptyFilesLock);
+            for (const auto& [file, modificationTime] : emptyFiles)
+            {
+                auto* element = xml->createNewChildElement(emptyFileTag);
+                element->setAttribute("file", file);
+                element->setAttribute("modified", juce::String(modificationTime.toMilliseconds()));
+            }
+        }
+
+        if (!xml->writeTo(cacheFile))
+            juce::Logger::writeToLog("Failed to write plugin cache: " + cacheFile.getFullPathName());
+    }
+}
+
+bool PluginScanner::isWorkerCommandLine(const juce::String& commandLine)
+{
+    return commandLine.trimStart().startsWith(workerFlag);
+}
+
+int PluginScanner::runWorker(const juce::StringArray& args)
+{
+    if (args.size() != 4 || args[0] != workerFlag)
+        return 1;
+
+    const auto& formatName = args[1];
+    const auto& fileOrIdentifier = args[2];
+    juce::File resultFile(args[3]);
+
+    juce::AudioPluginFormatManager workerFormats;
+    PluginHost::registerPluginFormats(workerFormats);
+
+    for (int i = 0; i < workerFormats.getNumFormats(); ++i)
+    {
+        auto* format = workerFormats.getFormat(i);
+        if (format->getName() != formatName)
+            continue;
+
+        juce::OwnedArray<juce::PluginDescription> found;
+        format->findAllTypesForFile(found, fileOrIdentifier);
+
+        juce::XmlElement results("PLUGINS");
+        for (auto* description : found)
+            results.addChildElement(description->createXml().release());
+
+        return results.writeTo(resultFile) ? 0 : 1;
+    }
+
+    return 1;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Scans installed plugins without blocking the message thread.
+//
+// Each plugin file is probed by a short-lived child process (this executable
+// started with --scan-plugin), several at a time on a thread pool, so a
+// plugin that crashes while being scanned only takes down its worker and is
+// blacklisted. Results are merged into a KnownPluginList that is persisted as
+// XML; entries carry the file's modification time, so later scans only probe
+// files that are new or have changed. Files that load but contain no plugins
+// are kept in the cache with their modification time too.
+class PluginScanner : private juce::Thread,
+                      private juce::AsyncUpdater
+{
+public:
+    PluginScanner();
+    ~PluginScanner() override;
+
+    // Scanning (message thread)
+    void startScan();
+    void cancelScan();
+    bool isScanning() const { return isThreadRunning(); }
+    float getProgress() const;
+
+    const juce::KnownPluginList& getKnownPluginList() const { return knownPluginList; }
+    juce::File getCacheFile() const;
+
+    // Called on the message thread when a scan has finished
+    std::function<void()> onScanFinished;
+
+    // Child process entry point, see Main.cpp
+    static bool isWorkerCommandLine(const juce::String& commandLine);
+    static int runWorker(const juce::StringArray& args);
+
+private:
+    void run() override;
+    void handleAsyncUpdate() override;
+
+    juce::StringArray findFilesNeedingScan(juce::AudioPluginFormat& format);
+    void scanFileInWorkerProcess(const juce::String& formatName, const juce::String& fileOrIdentifier);
+    void addFailedFile(const juce::String& fileOrIdentifier);
+    void addEmptyFile(const juce::String& fileOrIdentifier, juce::Time modificationTime);
+    bool isKnownEmptyFile(const juce::String& fileOrIdentifier);
+    void applyScanResults();
+    void loadCache();
+    void saveCache();
+
+    juce::AudioPluginFormatManager formatManager;
+    juce::KnownPluginList knownPluginList;
+    juce::ThreadPool workerPool;
+
+    // Files that crashed or hung a worker, collected from the pool and
+    // blacklisted on the message thread once the scan is over
+    juce::StringArray failedFiles;
+    juce::CriticalSection failedFilesLock;
+
+    // Files that yielded no descriptions, with the modification time they
+    // had then; skipped until they change
+    std::map<juce::String, juce::Time> emptyFiles;
+    juce::CriticalSection emptyFilesLock;
+
+    std::atomic<int> filesToScan { 0 };
+    std::atomic<int> filesScanned { 0 };
+
+    static constexpr int workerTimeoutMs = 60000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginScanner)
+};
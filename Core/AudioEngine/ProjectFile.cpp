@@ -0,0 +1,209 @@
+#include "ProjectFile.h"
+
+namespace
+{
+    const char projectMagic[4] = { 'S', 'F', 'P', 'J' };
+    constexpr size_t headerSize = 4 + 4 + 4 + 8;
+    constexpr size_t chunkAlignment = 8;
+}
+
+//==============================================================================
+ProjectFileWriter::ProjectFileWriter()
+{
+}
+
+ProjectFileWriter::~ProjectFileWriter()
+{
+}
+
+void ProjectFileWriter::addChunk(const juce::String& name, const void* data, size_t numBytes)
+{
+    addChunk(name, juce::MemoryBlock(data, numBytes));
+}
+
+void ProjectFileWriter::addChunk(const juce::String& name, const juce::MemoryBlock& data)
+{
+    for (auto& chunk : chunks)
+    {
+        if (chunk.first == name)
+        {
+            chunk.second = data;
+            return;
+        }
+    }
+
+    chunks.emplace_back(name, data);
+}
+
+bool ProjectFileWriter::hasChunk(const juce::String& name) const
+{
+    for (const auto& chunk : chunks)
+        if (chunk.first == name)
+            return true;
+
+    return false;
+}
+
+bool ProjectFileWriter::writeTo(const juce::File& file) const
+{
+    juce::TemporaryFile tempFile(file);
+
+    {
+        juce::FileOutputStream stream(tempFile.getFile());
+        if (!stream.openedOk())
+            return false;
+
+        // Header, with the index offset patched in once it is known
+        stream.write(projectMagic, sizeof(projectMagic));
+        stream.writeInt(static_cast<int>(ProjectFileReader::currentVersion));
+        stream.writeInt(static_cast<int>(chunks.size()));
+        stream.writeInt64(0);
+
+        std::vector<juce::int64> offsets;
+        offsets.reserve(chunks.size());
+
+        for (const auto& chunk : chunks)
+        {
+            // Keep chunk data aligned for in-place access from the mapping
+            while (stream.getPosition() % (juce::int64) chunkAlignment != 0)
+                stream.writeByte(0);
+
+            offsets.push_back(stream.getPosition());
+            stream.write(chunk.second.getData(), chunk.second.getSize());
+        }
+
+        auto indexOffset = stream.getPosition();
+
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            auto name = chunks[i].first.toUTF8();
+            auto nameLength = static_cast<int>(name.sizeInBytes() - 1);
+
+            stream.writeShort(static_cast<short>(nameLength));
+            stream.write(name.getAddress(), static_cast<size_t>(nameLength));
+            stream.writeInt64(offsets[i]);
+            stream.writeInt64(static_cast<juce::int64>(chunks[i].second.getSize()));
+        }
+
+        if (!stream.setPosition(12))
+            return false;
+
+        stream.writeInt64(indexOffset);
+        stream.flush();
+
+        if (stream.getStatus().failed())
+            return false;
+    }
+
+    return tempFile.overwriteTargetFileWithTemporary();
+}
+
+//==============================================================================
+ProjectFileReader::ProjectFileReader()
+{
+}
+
+ProjectFileReader::~ProjectFileReader()
+{
+}
+
+bool ProjectFileReader::open(const juce::File& file)
+{
+    mappedFile.reset();
+    index.clear();
+    projectFile = file;
+
+    auto mapping = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    auto* data = static_cast<const char*>(mapping->getData());
+    auto fileSize = mapping->getSize();
+
+    if (data == nullptr || fileSize < headerSize || std::memcmp(data, projectMagic, sizeof(projectMagic)) != 0)
+        return false;
+
+    auto version = juce::ByteOrder::littleEndianInt(data + 4);
+    if (version > currentVersion)
+    {
+        juce::Logger::writeToLog("Project was saved by a newer version: " + file.getFullPathName());
+        return false;
+    }
+
+    auto numChunks = juce::ByteOrder::littleEndianInt(data + 8);
+    auto indexOffset = static_cast<size_t>(juce::ByteOrder::littleEndianInt64(data + 12));
+    auto position = indexOffset;
+
+    for (juce::uint32 i = 0; i < numChunks; ++i)
+    {
+        if (position > fileSize || 2 > fileSize - position)
+            return false;
+
+        auto nameLength = static_cast<size_t>(juce::ByteOrder::littleEndianShort(data + position));
+        position += 2;
+
+        if (nameLength + 16 > fileSize - position)
+            return false;
+
+        auto name = juce::String::fromUTF8(data + position, static_cast<int>(nameLength));
+        position += nameLength;
+
+        ChunkLocation location;
+        location.offset = juce::ByteOrder::littleEndianInt64(data + position);
+        location.size = juce::ByteOrder::littleEndianInt64(data + position + 8);
+        position += 16;
+
+        // Written so that a corrupt offset or size can't overflow
+        if (location.offset > fileSize || location.size > fileSize - location.offset)
+            return false;
+
+        index[name] = location;
+    }
+
+    mappedFile = std::move(mapping);
+    return true;
+}
+
+bool ProjectFileReader::hasChunk(const juce::String& name) const
+{
+    return index.find(name) != index.end();
+}
+
+const void* ProjectFileReader::getChunkData(const juce::String& name, size_t& numBytes) const
+{
+    numBytes = 0;
+    auto found = index.find(name);
+
+    if (mappedFile == nullptr || found == index.end())
+        return nullptr;
+
+    numBytes = static_cast<size_t>(found->second.size);
+    return static_cast<const char*>(mappedFile->getData()) + found->second.offset;
+}
+
+bool ProjectFileReader::readChunk(const juce::String& name, juce::MemoryBlock& destData) const
+{
+    size_t numBytes = 0;
+    auto* data = getChunkData(name, numBytes);
+
+    if (data == nullptr)
+        return false;
+
+    destData.replaceAll(data, numBytes);
+    return true;
+}
+
+juce::StringArray ProjectFileReader::getChunkNames() const
+{
+    juce::StringArray names;
+    for (const auto& entry : index)
+        names.add(entry.first);
+    return names;
+}
+
+bool ProjectFileReader::isBinaryProjectFile(const juce::File& file)
+{
+    juce::FileInputStream stream(file);
+    char magic[4] = {};
+
+    return stream.openedOk()
+        && stream.read(magic, sizeof(magic)) == (int) sizeof(magic)
+        && std::memcmp(magic, projectMagic, sizeof(projectMagic)) == 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Binary project container.
+//
+// A project file is a header, a sequence of named chunks and an index at the
+// end of the file that records each chunk's name, offset and size:
+//
+//   "SFPJ" | version | chunk count | index offset | chunk data ... | index
+//
+// The reader memory-maps the file and only parses the header and index on
+// open, so opening costs O(number of chunks) regardless of how large the
+// chunks are. Callers fetch individual chunks when they need them, e.g. a
+// plugin's state only when that plugin is instantiated.
+class ProjectFileWriter
+{
+public:
+    ProjectFileWriter();
+    ~ProjectFileWriter();
+
+    void addChunk(const juce::String& name, const void* data, size_t numBytes);
+    void addChunk(const juce::String& name, const juce::MemoryBlock& data);
+    bool hasChunk(const juce::String& name) const;
+
+    // Written to a temporary file and moved into place, so a failed save
+    // never corrupts an existing project
+    bool writeTo(const juce::File& file) const;
+
+private:
+    std::vector<std::pair<juce::String, juce::MemoryBlock>> chunks;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectFileWriter)
+};
+
+class ProjectFileReader
+{
+public:
+    ProjectFileReader();
+    ~ProjectFileReader();
+
+    bool open(const juce::File& file);
+    bool isOpen() const { return mappedFile != nullptr; }
+    const juce::File& getFile() const { return projectFile; }
+
+    // Views into the mapped file; valid for the lifetime of the reader
+    bool hasChunk(const juce::String& name) const;
+    const void* getChunkData(const juce::String& name, size_t& numBytes) const;
+    bool readChunk(const juce::String& name, juce::MemoryBlock& destData) const;
+    juce::StringArray getChunkNames() const;
+
+    static bool isBinaryProjectFile(const juce::File& file);
+
+    static constexpr juce::uint32 currentVersion = 1;
+
+private:
+    struct ChunkLocation
+    {
+        juce::uint64 offset = 0;
+        juce::uint64 size = 0;
+    };
+
+    juce::File projectFile;
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    std::map<juce::String, ChunkLocation> index;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectFileReader)
+};
@@ -0,0 +1,445 @@
+#include "ProjectJournal.h"
+#include "ProjectFile.h"
+
+namespace
+{
+    const juce::String snapshotTreeChunk = "project";
+    const juce::String snapshotSequenceChunk = "journal-sequence";
+}
+
+ProjectJournal::ProjectJournal(const juce::File& autosaveDirectory)
+    : juce::Thread("Project Journal"),
+      directory(autosaveDirectory)
+{
+    startThread();
+}
+
+ProjectJournal::~ProjectJournal()
+{
+    detach();
+    stopThread(5000);
+}
+
+void ProjectJournal::attachTo(juce::ValueTree& stateToJournal)
+{
+    detach();
+    state = stateToJournal;
+    state.addListener(this);
+    resetBaseline();
+}
+
+void ProjectJournal::detach()
+{
+    state.removeListener(this);
+    state = juce::ValueTree();
+}
+
+void ProjectJournal::requestCompaction()
+{
+    {
+        const juce::ScopedLock sl(queueLock);
+        compactionRequested = true;
+    }
+    notify();
+}
+
+void ProjectJournal::setPluginStates(const juce::Array<juce::ValueTree>& newPluginSlots,
+                                     const std::map<juce::String, juce::MemoryBlock>& newStateChunks)
+{
+    // Deep copies, so the writer thread shares nothing with the caller
+    juce::Array<juce::ValueTree> slots;
+    for (const auto& plugins : newPluginSlots)
+        slots.add(plugins.createCopy());
+
+    {
+        const juce::ScopedLock sl(queueLock);
+        pendingPluginSlots.swapWith(slots);
+        pendingStateChunks = newStateChunks;
+        pluginStatesPending = true;
+        compactionRequested = true;
+    }
+
+    notify();
+}
+
+void ProjectJournal::discard()
+{
+    // The writer thread deletes the files when it picks up the new baseline.
+    // Nothing is attached while a previous session's autosave is pending.
+    if (state.isValid())
+        resetBaseline();
+}
+
+bool ProjectJournal::hasRecoveryData() const
+{
+    return getSnapshotFile().existsAsFile();
+}
+
+juce::ValueTree ProjectJournal::recover() const
+{
+    ProjectFileReader snapshot;
+    if (!snapshot.open(getSnapshotFile()))
+        return {};
+
+    size_t treeSize = 0;
+    auto* treeData = snapshot.getChunkData(snapshotTreeChunk, treeSize);
+    if (treeData == nullptr)
+        return {};
+
+    auto recovered = juce::ValueTree::readFromData(treeData, treeSize);
+
+    size_t sequenceSize = 0;
+    auto* sequenceData = snapshot.getChunkData(snapshotSequenceChunk, sequenceSize);
+    auto snapshotSequence = sequenceSize == sizeof(juce::uint64)
+                                ? juce::ByteOrder::littleEndianInt64(sequenceData) : 0;
+
+    juce::FileInputStream journal(getJournalFile());
+    if (!journal.openedOk())
+        return recovered;
+
+    juce::MemoryBlock record;
+    while (journal.getNumBytesRemaining() >= 4)
+    {
+        auto recordSize = journal.readInt();
+
+        // A torn write at the end of the journal is expected after a crash
+        if (recordSize <= 0 || journal.getNumBytesRemaining() < recordSize)
+            break;
+
+        record.setSize(static_cast<size_t>(recordSize));
+        journal.read(record.getData(), recordSize);
+
+        juce::MemoryInputStream peek(record, false);
+        if (static_cast<juce::uint64>(peek.readInt64()) <= snapshotSequence)
+            continue;
+
+        juce::uint64 sequence = 0;
+        if (!applyRecord(recovered, record.getData(), record.getSize(), sequence))
+            break;
+    }
+
+    return recovered;
+}
+
+//==============================================================================
+void ProjectJournal::valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property)
+{
+    juce::MemoryOutputStream record;
+
+    if (tree.hasProperty(property))
+    {
+        beginRecord(record, propertyChanged, tree);
+        record.writeString(property.toString());
+        tree.getProperty(property).writeToStream(record);
+    }
+    else
+    {
+        beginRecord(record, propertyRemoved, tree);
+        record.writeString(property.toString());
+    }
+
+    enqueue(record);
+}
+
+void ProjectJournal::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child)
+{
+    juce::MemoryOutputStream record;
+    beginRecord(record, childAdded, parent);
+    record.writeCompressedInt(parent.indexOf(child));
+    child.writeToStream(record);
+    enqueue(record);
+}
+
+void ProjectJournal::valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& child, int index)
+{
+    juce::ignoreUnused(child);
+
+    juce::MemoryOutputStream record;
+    beginRecord(record, childRemoved, parent);
+    record.writeCompressedInt(index);
+    enqueue(record);
+}
+
+void ProjectJournal::valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex)
+{
+    juce::MemoryOutputStream record;
+    beginRecord(record, childMoved, parent);
+    record.writeCompressedInt(oldIndex);
+    record.writeCompressedInt(newIndex);
+    enqueue(record);
+}
+
+void ProjectJournal::valueTreeRedirected(juce::ValueTree& tree)
+{
+    juce::ignoreUnused(tree);
+    resetBaseline();
+}
+
+void ProjectJournal::beginRecord(juce::MemoryOutputStream& record, RecordType type, const juce::ValueTree& tree)
+{
+    // Path of child indices from the root down to the changed node
+    juce::Array<int> path;
+    for (auto node = tree; node.isValid() && node != state; node = node.getParent())
+        path.insert(0, node.getParent().indexOf(node));
+
+    record.writeInt64(0); // sequence, filled in by enqueue()
+    record.writeByte(static_cast<char>(type));
+    record.writeCompressedInt(path.size());
+
+    for (auto index : path)
+        record.writeCompressedInt(index);
+}
+
+void ProjectJournal::enqueue(juce::MemoryOutputStream& record)
+{
+    juce::MemoryBlock block(record.getData(), record.getDataSize());
+
+    {
+        const juce::ScopedLock sl(queueLock);
+        auto sequence = juce::ByteOrder::swapIfBigEndian(static_cast<juce::uint64>(nextSequence++));
+        std::memcpy(block.getData(), &sequence, sizeof(sequence));
+        pendingRecords.push_back(std::move(block));
+    }
+
+    notify();
+}
+
+void ProjectJournal::resetBaseline()
+{
+    // The copy is the only O(project) step and happens on load, new or
+    // discard, never per edit
+    auto baseline = state.isValid() ? state.createCopy() : juce::ValueTree();
+
+    {
+        const juce::ScopedLock sl(queueLock);
+        pendingRecords.clear();
+        pendingBaseline = baseline.isValid() ? baseline : juce::ValueTree("Empty");
+        pendingBaselineSequence = nextSequence - 1;
+        pendingPluginSlots.clear();
+        pendingStateChunks.clear();
+        pluginStatesPending = false;
+    }
+
+    notify();
+}
+
+//==============================================================================
+void ProjectJournal::run()
+{
+    lastCompactionTime = juce::Time::getMillisecondCounter();
+
+    while (!threadShouldExit())
+    {
+        wait(1000);
+        writePendingRecords();
+
+        bool compactNow = false;
+        {
+            const juce::ScopedLock sl(queueLock);
+            compactNow = compactionRequested;
+            compactionRequested = false;
+        }
+
+        auto now = juce::Time::getMillisecondCounter();
+        if (recordsSinceCompaction > 0
+            && (recordsSinceCompaction >= compactionRecordThreshold || now - lastCompactionTime > compactionIntervalMs))
+            compactNow = true;
+
+        if (compactNow && snapshotWritten)
+            compact();
+    }
+
+    writePendingRecords();
+    journalStream.reset();
+}
+
+void ProjectJournal::writePendingRecords()
+{
+    std::vector<juce::MemoryBlock> records;
+    juce::ValueTree baseline;
+    juce::uint64 baselineSequence = 0;
+    bool newPluginStates = false;
+
+    {
+        const juce::ScopedLock sl(queueLock);
+        records.swap(pendingRecords);
+        baseline = pendingBaseline;
+        baselineSequence = pendingBaselineSequence;
+        pendingBaseline = juce::ValueTree();
+
+        if (pluginStatesPending)
+        {
+            pluginSlots.swapWith(pendingPluginSlots);
+            std::swap(stateChunks, pendingStateChunks);
+            pendingPluginSlots.clear();
+            pendingStateChunks.clear();
+            pluginStatesPending = false;
+            newPluginStates = true;
+        }
+    }
+
+    if (baseline.isValid())
+    {
+        // The baseline matches what is on disk, so there is nothing to recover
+        journalStream.reset();
+        getJournalFile().deleteFile();
+        getSnapshotFile().deleteFile();
+
+        replica = baseline;
+        replicaSequence = baselineSequence;
+        snapshotWritten = false;
+        recordsSinceCompaction = 0;
+
+        // They belonged to the previous baseline, unless handed over after it
+        if (!newPluginStates)
+        {
+            pluginSlots.clear();
+            stateChunks.clear();
+        }
+    }
+
+    if (records.empty())
+        return;
+
+    // The journal is only meaningful on top of a snapshot of the baseline
+    if (!snapshotWritten)
+        compact();
+
+    if (journalStream == nullptr)
+        openJournal();
+
+    for (const auto& record : records)
+    {
+        juce::uint64 sequence = 0;
+        if (!applyRecord(replica, record.getData(), record.getSize(), sequence))
+            continue;
+
+        replicaSequence = sequence;
+
+        if (journalStream != nullptr)
+        {
+            journalStream->writeInt(static_cast<int>(record.getSize()));
+            journalStream->write(record.getData(), record.getSize());
+        }
+
+        ++recordsSinceCompaction;
+    }
+
+    if (journalStream != nullptr)
+        journalStream->flush();
+}
+
+void ProjectJournal::compact()
+{
+    if (!replica.isValid())
+        return;
+
+    if (!directory.exists())
+        directory.createDirectory();
+
+    // Plugin slots go last among each track's children, so journal records,
+    // which address children by index, still land where they did live
+    auto tree = replica;
+    if (!pluginSlots.isEmpty())
+    {
+        tree = replica.createCopy();
+        auto tracks = tree.getChildWithName("Tracks");
+
+        for (int trackIndex = 0; trackIndex < juce::jmin(tracks.getNumChildren(), pluginSlots.size()); ++trackIndex)
+            tracks.getChild(trackIndex).appendChild(pluginSlots.getReference(trackIndex).createCopy(), nullptr);
+    }
+
+    juce::MemoryOutputStream treeData;
+    tree.writeToStream(treeData);
+
+    juce::MemoryOutputStream sequenceData;
+    sequenceData.writeInt64(static_cast<juce::int64>(replicaSequence));
+
+    ProjectFileWriter snapshot;
+    snapshot.addChunk(snapshotTreeChunk, treeData.getData(), treeData.getDataSize());
+    snapshot.addChunk(snapshotSequenceChunk, sequenceData.getData(), sequenceData.getDataSize());
+
+    for (const auto& chunk : stateChunks)
+        snapshot.addChunk(chunk.first, chunk.second);
+
+    if (!snapshot.writeTo(getSnapshotFile()))
+    {
+        juce::Logger::writeToLog("Autosave snapshot failed: " + getSnapshotFile().getFullPathName());
+        return;
+    }
+
+    // Everything journalled so far is now in the snapshot
+    snapshotWritten = true;
+    journalStream.reset();
+    getJournalFile().deleteFile();
+    openJournal();
+
+    recordsSinceCompaction = 0;
+    lastCompactionTime = juce::Time::getMillisecondCounter();
+}
+
+void ProjectJournal::openJournal()
+{
+    if (!directory.exists())
+        directory.createDirectory();
+
+    journalStream = std::make_unique<juce::FileOutputStream>(getJournalFile());
+
+    if (!journalStream->openedOk())
+    {
+        juce::Logger::writeToLog("Could not open autosave journal: " + getJournalFile().getFullPathName());
+        journalStream.reset();
+    }
+}
+
+bool ProjectJournal::applyRecord(juce::ValueTree& root, const void* data, size_t numBytes, juce::uint64& sequence)
+{
+    juce::MemoryInputStream input(data, numBytes, false);
+
+    sequence = static_cast<juce::uint64>(input.readInt64());
+    auto type = static_cast<RecordType>(input.readByte());
+    auto pathLength = input.readCompressedInt();
+
+    auto node = root;
+    for (int i = 0; i < pathLength && node.isValid(); ++i)
+        node = node.getChild(input.readCompressedInt());
+
+    if (!node.isValid())
+        return false;
+
+    switch (type)
+    {
+        case propertyChanged:
+        {
+            juce::Identifier property(input.readString());
+            node.setProperty(property, juce::var::readFromStream(input), nullptr);
+            return true;
+        }
+
+        case propertyRemoved:
+            node.removeProperty(juce::Identifier(input.readString()), nullptr);
+            return true;
+
+        case childAdded:
+        {
+            auto index = input.readCompressedInt();
+            node.addChild(juce::ValueTree::readFromStream(input), index, nullptr);
+            return true;
+        }
+
+        case childRemoved:
+            node.removeChild(input.readCompressedInt(), nullptr);
+            return true;
+
+        case childMoved:
+        {
+            auto oldIndex = input.readCompressedInt();
+            auto newIndex = input.readCompressedInt();
+            node.moveChild(oldIndex, newIndex, nullptr);
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Incremental autosave for the live project model.
+//
+// Every change to the attached ValueTree is encoded on the message thread as
+// a small record (a child-index path plus the changed property or child) and
+// queued; a background thread appends the records to a journal file and
+// replays them onto its own replica of the tree. Periodically the replica is
+// written out as a full snapshot and the journal restarts, so the message
+// thread only ever pays O(changes) and never touches the disk.
+//
+// Taking a new baseline (attach, load, save) deletes both files, so they only
+// exist while there are unsaved edits. After a crash, recover() loads the last
+// snapshot and replays the journal records that were written after it.
+//
+// Plugin slots are not part of the model. The owner hands over what it last
+// captured, and snapshots carry it as each track's "Plugins" child plus the
+// state chunks those refer to.
+class ProjectJournal : private juce::ValueTree::Listener,
+                       private juce::Thread
+{
+public:
+    explicit ProjectJournal(const juce::File& autosaveDirectory);
+    ~ProjectJournal() override;
+
+    // Message thread
+    void attachTo(juce::ValueTree& stateToJournal);
+    void detach();
+    void requestCompaction();
+    void discard();
+
+    // A "Plugins" tree per track, in track order, and the state chunks they
+    // name; written with a new snapshot. A new baseline drops them.
+    void setPluginStates(const juce::Array<juce::ValueTree>& pluginSlots,
+                         const std::map<juce::String, juce::MemoryBlock>& stateChunks);
+
+    bool hasRecoveryData() const;
+    juce::ValueTree recover() const;
+
+    juce::File getSnapshotFile() const { return directory.getChildFile("session.sfproj"); }
+    juce::File getJournalFile() const  { return directory.getChildFile("session.journal"); }
+
+private:
+    enum RecordType : juce::uint8
+    {
+        propertyChanged = 1,
+        propertyRemoved,
+        childAdded,
+        childRemoved,
+        childMoved
+    };
+
+    // ValueTree::Listener
+    void valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property) override;
+    void valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex) override;
+    void valueTreeRedirected(juce::ValueTree& tree) override;
+
+    void beginRecord(juce::MemoryOutputStream& record, RecordType type, const juce::ValueTree& tree);
+    void enqueue(juce::MemoryOutputStream& record);
+    void resetBaseline();
+
+    // Background thread
+    void run() override;
+    void writePendingRecords();
+    void compact();
+    void openJournal();
+
+    static bool applyRecord(juce::ValueTree& root, const void* data, size_t numBytes, juce::uint64& sequence);
+
+    juce::File directory;
+    juce::ValueTree state;
+
+    juce::CriticalSection queueLock;
+    std::vector<juce::MemoryBlock> pendingRecords;
+    juce::ValueTree pendingBaseline;
+    juce::uint64 pendingBaselineSequence = 0;
+    juce::uint64 nextSequence = 1;
+    bool compactionRequested = false;
+    juce::Array<juce::ValueTree> pendingPluginSlots;
+    std::map<juce::String, juce::MemoryBlock> pendingStateChunks;
+    bool pluginStatesPending = false;
+
+    // Owned by the background thread
+    juce::ValueTree replica;
+    juce::uint64 replicaSequence = 0;
+    bool snapshotWritten = false;
+    std::unique_ptr<juce::FileOutputStream> journalStream;
+    int recordsSinceCompaction = 0;
+    juce::uint32 lastCompactionTime = 0;
+    juce::Array<juce::ValueTree> pluginSlots;
+    std::map<juce::String, juce::MemoryBlock> stateChunks;
+
+    static constexpr int compactionRecordThreshold = 2000;
+    static constexpr juce::uint32 compactionIntervalMs = 5 * 60 * 1000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectJournal)
+};
@@ -1,13 +1,136 @@
 #include "ProjectManager.h"
 #include "AudioEngine.h"
 #include "Track.h"
+#include "EffectsProcessor.h"
+#include "PluginChain.h"
+#include "PluginHost.h"
+#include "ProjectFile.h"
+#include "ProjectJournal.h"
+#include "PeakCache.h"
+#include <limits>
 
-ProjectManager::ProjectManager(AudioEngine& engine) : audioEngine(engine)
+ProjectManager::ProjectManager(AudioEngine& engine)
+    : audioEngine(engine),
+      journal(std::make_unique<ProjectJournal>(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                                                   .getChildFile("SignalForge")
+                                                   .getChildFile("Autosave")))
 {
+    projectState.addListener(this);
+
+    // The manager never trims on its own; trimUndoHistory() decides what goes
+    undoManager.setMaxNumberOfStoredUnits(std::numeric_limits<int>::max(), 0);
+
+    // Attaching takes a fresh baseline, which deletes the previous session's
+    // autosave, so leave it in place until the user decides about recovery
+    setState(createProjectXML());
+    if (!journal->hasRecoveryData())
+        journal->attachTo(projectState);
+
+    startTimer(pluginAutosaveIntervalMs);
 }
 
 ProjectManager::~ProjectManager()
 {
+    stopTimer();
+
+    // Quitting with unsaved changes keeps the autosave for the next launch
+    if (!unsavedChanges)
+        journal->discard();
+
+    journal.reset();
+    projectState.removeListener(this);
+}
+
+namespace
+{
+    const juce::String projectChunkName = "project";
+    const juce::String pluginStateChunkPrefix = "plugin/";
+
+    // Model property -> EffectsProcessor setter
+    struct EffectParameterSetter
+    {
+        const char* id;
+        void (EffectsProcessor::*setter)(float);
+    };
+
+    const EffectParameterSetter effectParameterSetters[] =
+    {
+        { "lowGain",             &EffectsProcessor::setLowGain },
+        { "midGain",             &EffectsProcessor::setMidGain },
+        { "highGain",            &EffectsProcessor::setHighGain },
+        { "compressorThreshold", &EffectsProcessor::setCompressorThreshold },
+        { "compressorRatio",     &EffectsProcessor::setCompressorRatio },
+        { "compressorAttack",    &EffectsProcessor::setCompressorAttack },
+        { "compressorRelease",   &EffectsProcessor::setCompressorRelease },
+        { "reverbRoomSize",      &EffectsProcessor::setReverbRoomSize },
+        { "reverbDamping",       &EffectsProcessor::setReverbDamping },
+        { "reverbWetLevel",      &EffectsProcessor::setReverbWetLevel },
+        { "reverbDryLevel",      &EffectsProcessor::setReverbDryLevel },
+        { "chorusRate",          &EffectsProcessor::setChorusRate },
+        { "chorusDepth",         &EffectsProcessor::setChorusDepth },
+        { "chorusCentreDelay",   &EffectsProcessor::setChorusCentreDelay },
+        { "chorusFeedback",      &EffectsProcessor::setChorusFeedback },
+        { "chorusMix",           &EffectsProcessor::setChorusMix },
+        { "delayTime",           &EffectsProcessor::setDelayTime },
+        { "delayFeedback",       &EffectsProcessor::setDelayFeedback },
+        { "delayMix",            &EffectsProcessor::setDelayMix }
+    };
+
+    struct EffectEnableSetter
+    {
+        const char* id;
+        void (EffectsProcessor::*setter)(bool);
+    };
+
+    const EffectEnableSetter effectEnableSetters[] =
+    {
+        { "eqEnabled",         &EffectsProcessor::setEQEnabled },
+        { "compressorEnabled", &EffectsProcessor::setCompressorEnabled },
+        { "reverbEnabled",     &EffectsProcessor::setReverbEnabled },
+        { "chorusEnabled",     &EffectsProcessor::setChorusEnabled },
+        { "delayEnabled",      &EffectsProcessor::setDelayEnabled }
+    };
+
+    // Rough cost of one undo action object, on top of the data it keeps
+    constexpr juce::int64 undoActionBytes = 64;
+
+    juce::int64 estimateBytes(const juce::var& value)
+    {
+        juce::int64 bytes = sizeof(juce::var);
+
+        if (value.isString())
+            bytes += value.toString().getNumBytesAsUTF8();
+        else if (auto* block = value.getBinaryData())
+            bytes += static_cast<juce::int64>(block->getSize());
+        else if (auto* array = value.getArray())
+            for (auto& element : *array)
+                bytes += estimateBytes(element);
+
+        return bytes;
+    }
+
+    juce::int64 estimateBytes(const juce::ValueTree& tree)
+    {
+        juce::int64 bytes = undoActionBytes;
+
+        for (int i = 0; i < tree.getNumProperties(); ++i)
+            bytes += estimateBytes(tree.getProperty(tree.getPropertyName(i)));
+
+        for (const auto& child : tree)
+            bytes += estimateBytes(child);
+
+        return bytes;
+    }
+
+    // A coalesced change keeps the gesture's first old value and drops the
+    // previous new one, so only the new value's size changes
+    juce::int64 estimatePropertyChange(const juce::var& oldValue, const juce::var& newValue, bool coalesced)
+    {
+        if (coalesced)
+            return estimateBytes(newValue) - estimateBytes(oldValue);
+
+        return undoActionBytes + estimateBytes(oldValue) + estimateBytes(newValue);
+    }
 }
 
 bool ProjectManager::saveProject(const juce::File& file)
@@ -17,12 +140,47 @@ bool ProjectManager::saveProject(const juce::File& file)
     if (!file.getParentDirectory().exists())
         file.getParentDirectory().createDirectory();
 
-    auto xmlString = projectXML.toXmlString();
+    // The tree holds structure only; plugin state blobs are written as their
+    // own chunks, one per distinct blob
+    juce::Array<juce::ValueTree> pluginSlots;
+    std::map<juce::String, juce::MemoryBlock> stateChunks;
+    capturePluginStates(pluginSlots, stateChunks);
+
+    auto tracks = projectXML.getChildWithName("Tracks");
+    for (int trackIndex = 0; trackIndex < pluginSlots.size(); ++trackIndex)
+    {
+        auto trackState = tracks.getChild(trackIndex);
+        if (!trackState.isValid())
+            break;
+
+        trackState.removeChild(trackState.getChildWithName("Plugins"), nullptr);
+        trackState.appendChild(pluginSlots.getReference(trackIndex), nullptr);
+    }
+
+    ProjectFileWriter writer;
+    for (const auto& chunk : stateChunks)
+        writer.addChunk(chunk.first, chunk.second);
+
+    juce::MemoryOutputStream treeData;
+    projectXML.writeToStream(treeData);
+    writer.addChunk(projectChunkName, treeData.getData(), treeData.getDataSize());
+
+    // Everything needed from the old file was read at load time; drop the
+    // mapping so the file can be replaced (required on Windows)
+    projectReader.reset();
     
-    if (file.replaceWithText(xmlString))
+    if (writer.writeTo(file))
     {
         currentProjectFile = file;
         markAsSaved();
+        journal->discard();
+        journal->setPluginStates(pluginSlots, stateChunks);
+
+        // Keep serving lazy loads from the file we just wrote
+        projectReader = std::make_unique<ProjectFileReader>();
+        if (!projectReader->open(file))
+            projectReader.reset();
+
         juce::Logger::writeToLog("Project saved: " + file.getFullPathName());
         return true;
     }
@@ -31,6 +189,150 @@ bool ProjectManager::saveProject(const juce::File& file)
     return false;
 }
 
+void ProjectManager::capturePluginStates(juce::Array<juce::ValueTree>& pluginSlots,
+                                         std::map<juce::String, juce::MemoryBlock>& stateChunks)
+{
+    // In-process plugins expect state calls on the message thread (the VST3
+    // wrapper takes the MessageManagerLock), so they are captured here, one
+    // after another. A sandboxed plugin's state is a round trip to its helper
+    // process, so those requests are sent from the pool and overlap.
+    struct SandboxCapture
+    {
+        PluginHost* host;
+        juce::ValueTree slot;
+        juce::MemoryBlock state;
+    };
+
+    std::vector<SandboxCapture> sandboxCaptures;
+
+    auto addStateChunk = [&stateChunks](juce::ValueTree& slot, juce::MemoryBlock& state)
+    {
+        // Identical blobs (e.g. the same preset on many tracks) share one chunk
+        if (!state.isEmpty())
+        {
+            auto hash = juce::SHA256(state).toHexString();
+            stateChunks.emplace(pluginStateChunkPrefix + hash, std::move(state));
+            slot.setProperty("state", hash, nullptr);
+        }
+    };
+
+    for (int trackIndex = 0; trackIndex < audioEngine.getNumTracks(); ++trackIndex)
+    {
+        juce::ValueTree plugins("Plugins");
+
+        if (auto* track = audioEngine.getTrack(trackIndex))
+        {
+            auto& chain = track->getPluginChain();
+
+            for (int slotIndex = 0; slotIndex < chain.getNumSlots(); ++slotIndex)
+            {
+                juce::ValueTree slot("Slot");
+                slot.setProperty("bypassed", chain.isSlotBypassed(slotIndex), nullptr);
+
+                auto* host = chain.getSlot(slotIndex);
+                if (host != nullptr && host->hasPlugin())
+                {
+                    if (auto description = host->getPluginDescription().createXml())
+                        slot.appendChild(juce::ValueTree::fromXml(*description), nullptr);
+
+                    if (host->isRunningInSandbox())
+                    {
+                        sandboxCaptures.push_back({ host, slot, {} });
+                    }
+                    else
+                    {
+                        juce::MemoryBlock state;
+                        host->getStateInformation(state);
+                        addStateChunk(slot, state);
+                    }
+                }
+
+                plugins.appendChild(slot, nullptr);
+            }
+        }
+
+        pluginSlots.add(plugins);
+    }
+
+    if (sandboxCaptures.empty())
+        return;
+
+    // The message thread waits here, so no host can be swapped or removed
+    // while its request is in flight; each request has its own timeout
+    std::atomic<int> remaining { static_cast<int>(sandboxCaptures.size()) };
+    juce::WaitableEvent allDone;
+
+    for (auto& capture : sandboxCaptures)
+    {
+        stateCapturePool.addJob([&capture, &remaining, &allDone]
+        {
+            capture.host->getStateInformation(capture.state);
+
+            if (--remaining == 0)
+                allDone.signal();
+        });
+    }
+
+    allDone.wait();
+
+    for (auto& capture : sandboxCaptures)
+        addStateChunk(capture.slot, capture.state);
+}
+
+void ProjectManager::restorePlugins(const juce::Array<juce::ValueTree>& pluginStates)
+{
+    for (int trackIndex = 0; trackIndex < pluginStates.size(); ++trackIndex)
+    {
+        auto* track = audioEngine.getTrack(trackIndex);
+        auto& plugins = pluginStates.getReference(trackIndex);
+        if (track == nullptr || !plugins.isValid())
+            continue;
+
+        auto& chain = track->getPluginChain();
+
+        for (const auto& slot : plugins)
+        {
+            auto slotIndex = chain.insertSlot();
+            chain.setSlotBypassed(slotIndex, slot.getProperty("bypassed", false));
+
+            juce::PluginDescription description;
+            auto descriptionState = slot.getChild(0);
+            if (!descriptionState.isValid())
+                continue;
+
+            auto xml = descriptionState.createXml();
+            if (xml == nullptr || !description.loadFromXml(*xml))
+                continue;
+
+            // Read now rather than when the loader runs; the mapping may be
+            // released by a save in between
+            juce::MemoryBlock state;
+            auto hash = slot.getProperty("state").toString();
+            if (hash.isNotEmpty() && !readProjectChunk(pluginStateChunkPrefix + hash, state))
+                juce::Logger::writeToLog("Missing plugin state for " + description.name);
+
+            chain.loadPluginAsync(slotIndex, description, state);
+        }
+    }
+}
+
+bool ProjectManager::exportProjectXML(const juce::File& file)
+{
+    auto projectXML = createProjectXML();
+
+    if (!file.getParentDirectory().exists())
+        file.getParentDirectory().createDirectory();
+
+    if (file.replaceWithText(projectXML.toXmlString()))
+    {
+        juce::Logger::writeToLog("Project exported as XML: " + file.getFullPathName());
+        return true;
+    }
+
+    juce::Logger::writeToLog("Failed to export project: " + file.getFullPathName());
+    return false;
+}
+
 bool ProjectManager::loadProject(const juce::File& file)
 {
     if (!file.exists())
@@ -39,13 +341,14 @@ bool ProjectManager::loadProject(const juce::File& file)
         return false;
     }
 
-    auto xmlString = file.loadFileAsString();
-    auto xml = juce::ValueTree::fromXml(xmlString);
+    auto loaded = ProjectFileReader::isBinaryProjectFile(file) ? loadBinaryProject(file)
+                                                               : loadXMLProject(file);
     
-    if (xml.isValid() && parseProjectXML(xml))
+    if (loaded)
     {
         currentProjectFile = file;
         markAsSaved();
+        journal->attachTo(projectState);
         juce::Logger::writeToLog("Project loaded: " + file.getFullPathName());
         return true;
     }
@@ -54,28 +357,484 @@ bool ProjectManager::loadProject(const juce::File& file)
     return false;
 }
 
+bool ProjectManager::loadBinaryProject(const juce::File& file)
+{
+    auto reader = std::make_unique<ProjectFileReader>();
+    if (!reader->open(file))
+        return false;
+
+    size_t treeSize = 0;
+    auto* treeData = reader->getChunkData(projectChunkName, treeSize);
+    if (treeData == nullptr)
+        return false;
+
+    auto projectXML = juce::ValueTree::readFromData(treeData, treeSize);
+
+    // Later chunk reads come from this mapping
+    projectReader = std::move(reader);
+    return projectXML.isValid() && parseProjectXML(projectXML);
+}
+
+bool ProjectManager::loadXMLProject(const juce::File& file)
+{
+    projectReader.reset();
+
+    auto xmlString = file.loadFileAsString();
+    auto xml = juce::ValueTree::fromXml(xmlString);
+
+    return xml.isValid() && parseProjectXML(xml);
+}
+
+bool ProjectManager::readProjectChunk(const juce::String& chunkName, juce::MemoryBlock& destData) const
+{
+    return projectReader != nullptr && projectReader->readChunk(chunkName, destData);
+}
+
 bool ProjectManager::newProject()
 {
-    // Clear all tracks
-    while (audioEngine.getNumTracks() > 0)
-        audioEngine.removeTrack(0);
-    
+    juce::ValueTree project("SignalForgeProject");
+    project.setProperty("version", "1.0", nullptr);
+    project.setProperty("name", "Untitled Project", nullptr);
+    project.appendChild(juce::ValueTree("Tracks"), nullptr);
+
+    setState(project);
+
     // Reset project state
     currentProjectFile = juce::File{};
-    projectName = "Untitled Project";
+    projectReader.reset();
     markAsSaved();
+    journal->attachTo(projectState);
     
     juce::Logger::writeToLog("New project created");
     return true;
 }
 
+bool ProjectManager::hasRecoveryData() const
+{
+    return journal->hasRecoveryData();
+}
+
+bool ProjectManager::recoverAutosave()
+{
+    auto recovered = journal->recover();
+
+    // Plugin state is restored from the snapshot's chunks
+    projectReader = std::make_unique<ProjectFileReader>();
+    projectReader->open(journal->getSnapshotFile());
+
+    if (!recovered.isValid() || !parseProjectXML(recovered))
+    {
+        juce::Logger::writeToLog("No recoverable autosave found");
+        projectReader.reset();
+        journal->attachTo(projectState);
+        return false;
+    }
+
+    // The recovered edits were never saved to a project file
+    currentProjectFile = juce::File{};
+    projectReader.reset();
+    journal->attachTo(projectState);
+    markAsChanged();
+
+    juce::Logger::writeToLog("Project recovered from autosave");
+    return true;
+}
+
+void ProjectManager::discardRecoveryData()
+{
+    journal->attachTo(projectState);
+}
+
+void ProjectManager::timerCallback()
+{
+    if (unsavedChanges)
+        autosavePluginStates();
+}
+
+void ProjectManager::autosavePluginStates()
+{
+    juce::Array<juce::ValueTree> pluginSlots;
+    std::map<juce::String, juce::MemoryBlock> stateChunks;
+    capturePluginStates(pluginSlots, stateChunks);
+    journal->setPluginStates(pluginSlots, stateChunks);
+}
+
+//==============================================================================
+int ProjectManager::addTrack(const juce::String& name)
+{
+    beginNewTransaction("Add Track");
+
+    auto tracks = getTracksState();
+    if (!tracks.isValid())
+    {
+        tracks = juce::ValueTree("Tracks");
+        projectState.appendChild(tracks, &undoManager);
+        recordUndoBytes(estimateBytes(tracks));
+    }
+
+    juce::ValueTree track("Track");
+    track.setProperty("name", name, nullptr);
+    track.setProperty("gain", 1.0f, nullptr);
+    track.setProperty("pan", 0.0f, nullptr);
+    track.setProperty("layout", juce::AudioChannelSet::stereo().getSpeakerArrangementAsString(), nullptr);
+    track.setProperty("muted", false, nullptr);
+    track.setProperty("solo", false, nullptr);
+    track.setProperty("frozen", false, nullptr);
+    track.setProperty("armed", false, nullptr);
+    track.setProperty("monitoring", false, nullptr);
+
+    tracks.appendChild(track, &undoManager);
+    recordUndoBytes(estimateBytes(track));
+    return tracks.getNumChildren() - 1;
+}
+
+void ProjectManager::removeTrack(int trackIndex)
+{
+    // The history keeps the removed subtree alive
+    auto track = getTracksState().getChild(trackIndex);
+    if (!track.isValid())
+        return;
+
+    beginNewTransaction("Remove Track");
+    getTracksState().removeChild(track, &undoManager);
+    recordUndoBytes(estimateBytes(track));
+}
+
+void ProjectManager::moveTrack(int fromIndex, int toIndex)
+{
+    beginNewTransaction("Move Track");
+    getTracksState().moveChild(fromIndex, toIndex, &undoManager);
+    recordUndoBytes(undoActionBytes);
+}
+
+void ProjectManager::setTrackProperty(int trackIndex, const juce::Identifier& property, const juce::var& value)
+{
+    auto track = getTracksState().getChild(trackIndex);
+    if (!track.isValid())
+        return;
+
+    auto oldValue = track[property];
+    auto coalesced = beginGesture(track, property, "Change Track " + property.toString());
+    track.setProperty(property, value, &undoManager);
+    recordUndoBytes(estimatePropertyChange(oldValue, value, coalesced));
+}
+
+void ProjectManager::setTrackPropertyInTransaction(int trackIndex, const juce::Identifier& property, const juce::var& value)
+{
+    auto track = getTracksState().getChild(trackIndex);
+    if (!track.isValid())
+        return;
+
+    auto oldValue = track[property];
+    track.setProperty(property, value, &undoManager);
+    recordUndoBytes(estimatePropertyChange(oldValue, value, false));
+}
+
+void ProjectManager::setTrackAudioFile(int trackIndex, const juce::File& file)
+{
+    beginNewTransaction("Load Audio File");
+    setTrackPropertyInTransaction(trackIndex, "file", file.getFullPathName());
+
+    // Start on the waveform peaks now so they are ready when the track is drawn
+    PeakCache::getInstance().getPeaksAsync(file, [](std::shared_ptr<PeakFile>) {});
+}
+
+void ProjectManager::setEffectParameter(int trackIndex, const juce::Identifier& parameter, const juce::var& value)
+{
+    auto track = getTracksState().getChild(trackIndex);
+    if (!track.isValid())
+        return;
+
+    // The Effects node is created inside the first step that needs it
+    auto effects = track.getChildWithName("Effects");
+    auto coalesced = beginGesture(effects.isValid() ? effects : track, parameter, "Change " + parameter.toString());
+
+    if (!effects.isValid())
+    {
+        effects = track.getOrCreateChildWithName("Effects", &undoManager);
+        recordUndoBytes(estimateBytes(effects));
+    }
+
+    auto oldValue = effects[parameter];
+    effects.setProperty(parameter, value, &undoManager);
+    recordUndoBytes(estimatePropertyChange(oldValue, value, coalesced));
+}
+
+void ProjectManager::setProjectName(const juce::String& name)
+{
+    beginNewTransaction("Rename Project");
+
+    juce::var oldValue = projectState["name"];
+    projectState.setProperty("name", name, &undoManager);
+    recordUndoBytes(estimatePropertyChange(oldValue, name, false));
+}
+
+void ProjectManager::beginNewTransaction(const juce::String& actionName)
+{
+    endGesture();
+    undoManager.beginNewTransaction(actionName);
+    undoStepPending = true;
+}
+
+bool ProjectManager::undo()
+{
+    endGesture();
+    if (!undoManager.undo())
+        return false;
+
+    nextUndoStep = juce::jmax(0, nextUndoStep - 1);
+    return true;
+}
+
+bool ProjectManager::redo()
+{
+    endGesture();
+    if (!undoManager.redo())
+        return false;
+
+    nextUndoStep = juce::jmin(static_cast<int>(undoStepBytes.size()), nextUndoStep + 1);
+    return true;
+}
+
+bool ProjectManager::beginGesture(const juce::ValueTree& target, const juce::Identifier& property,
+                                  const juce::String& actionName)
+{
+    auto now = juce::Time::getMillisecondCounter();
+    auto continues = target == gestureTarget && property == gestureProperty
+                         && now - lastGestureTime < gestureTimeoutMs;
+
+    if (!continues)
+    {
+        undoManager.beginNewTransaction(actionName);
+        undoStepPending = true;
+        gestureTarget = target;
+        gestureProperty = property;
+    }
+
+    lastGestureTime = now;
+    return continues;
+}
+
+void ProjectManager::recordUndoBytes(juce::int64 bytes)
+{
+    // An edit that changed nothing leaves the manager without a new step
+    if (undoManager.getNumActionsInCurrentTransaction() == 0)
+        return;
+
+    if (undoStepPending)
+    {
+        // Performing a new step discards everything that could be redone
+        while (static_cast<int>(undoStepBytes.size()) > nextUndoStep)
+        {
+            undoHistoryBytes -= undoStepBytes.back();
+            undoStepBytes.pop_back();
+        }
+
+        undoStepBytes.push_back(0);
+        nextUndoStep = static_cast<int>(undoStepBytes.size());
+        undoStepPending = false;
+    }
+
+    if (undoStepBytes.empty())
+        return;
+
+    bytes = juce::jmax(-undoStepBytes.back(), bytes);
+    undoStepBytes.back() += bytes;
+    undoHistoryBytes += bytes;
+
+    trimUndoHistory();
+}
+
+void ProjectManager::trimUndoHistory()
+{
+    // Oldest steps go first; the newest one stays however large it is
+    int numDropped = 0;
+    while (undoHistoryBytes > undoBudgetBytes && nextUndoStep > 1)
+    {
+        undoHistoryBytes -= undoStepBytes.front();
+        undoStepBytes.pop_front();
+        --nextUndoStep;
+        ++numDropped;
+    }
+
+    if (numDropped == 0)
+        return;
+
+    // With a one-unit ceiling the manager drops its oldest steps down to the
+    // minimum it keeps, which is how many are left here
+    undoManager.setMaxNumberOfStoredUnits(1, static_cast<int>(undoStepBytes.size()));
+    undoManager.setMaxNumberOfStoredUnits(std::numeric_limits<int>::max(), 0);
+}
+
+void ProjectManager::valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property)
+{
+    if (tree.hasType("Track") && tree.getParent() == getTracksState())
+    {
+        if (auto* track = audioEngine.getTrack(getTracksState().indexOf(tree)))
+            applyTrackProperties(*track, tree);
+    }
+    else if (tree.hasType("Effects") && tree.getParent().getParent() == getTracksState())
+    {
+        // Only the one parameter changed; re-applying them all would reset
+        // filter coefficients on every slider move
+        if (auto* track = audioEngine.getTrack(getTracksState().indexOf(tree.getParent())))
+            applyEffectParameter(track->getEffectsProcessor(), property, tree.getProperty(property));
+    }
+
+    markAsChanged();
+}
+
+void ProjectManager::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child)
+{
+    if (child.hasType("Effects") && parent.getParent() == getTracksState())
+    {
+        if (auto* track = audioEngine.getTrack(getTracksState().indexOf(parent)))
+            applyTrackState(*track, parent);
+    }
+    else if (parent == getTracksState() && child.hasType("Track"))
+    {
+        auto trackIndex = audioEngine.insertTrack(child.getProperty("name", "Track"), parent.indexOf(child));
+        if (auto* track = audioEngine.getTrack(trackIndex))
+            applyTrackState(*track, child);
+    }
+
+    markAsChanged();
+}
+
+void ProjectManager::valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& child, int index)
+{
+    if (parent == getTracksState() && child.hasType("Track"))
+        audioEngine.removeTrack(index);
+
+    markAsChanged();
+}
+
+void ProjectManager::valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex)
+{
+    if (parent == getTracksState())
+        audioEngine.moveTrack(oldIndex, newIndex);
+
+    markAsChanged();
+}
+
+void ProjectManager::applyTrackState(Track& track, const juce::ValueTree& trackState)
+{
+    applyTrackProperties(track, trackState);
+
+    auto effects = trackState.getChildWithName("Effects");
+    for (int i = 0; i < effects.getNumProperties(); ++i)
+    {
+        auto parameter = effects.getPropertyName(i);
+        applyEffectParameter(track.getEffectsProcessor(), parameter, effects.getProperty(parameter));
+    }
+}
+
+void ProjectManager::applyTrackProperties(Track& track, const juce::ValueTree& trackState)
+{
+    track.setName(trackState.getProperty("name", "Track"));
+    track.setGain(trackState.getProperty("gain", 1.0f));
+    track.getPanner().setPan(trackState.getProperty("pan", 0.0f));
+    track.setMuted(trackState.getProperty("muted", false));
+    track.setSolo(trackState.getProperty("solo", false));
+    track.setRecordArmed(trackState.getProperty("armed", false));
+    track.setMonitoring(trackState.getProperty("monitoring", false));
+
+    // A new layout has the engine prepare the track again
+    auto layout = juce::AudioChannelSet::fromAbbreviatedString(trackState.getProperty("layout").toString());
+    if (!layout.isDisabled() && layout != track.getChannelLayout())
+    {
+        for (int i = 0; i < audioEngine.getNumTracks(); ++i)
+            if (audioEngine.getTrack(i) == &track)
+                audioEngine.setTrackChannelLayout(i, layout);
+    }
+
+    auto audioPath = trackState.getProperty("file").toString();
+    if (juce::File::isAbsolutePath(audioPath) && juce::File(audioPath) != track.getAudioFile())
+    {
+        if (juce::File(audioPath).existsAsFile())
+            track.loadAudioFile(juce::File(audioPath));
+        else
+            juce::Logger::writeToLog("Missing audio file: " + audioPath);
+    }
+
+    // Frozen tracks render again on load; the render cache is per session
+    bool shouldBeFrozen = trackState.getProperty("frozen", false);
+    if (shouldBeFrozen && !track.isFrozen() && !track.isFreezing())
+        track.freeze();
+    else if (!shouldBeFrozen && track.isFrozen())
+        track.unfreeze();
+}
+
+void ProjectManager::applyEffectParameter(EffectsProcessor& effects, const juce::Identifier& parameter, const juce::var& value)
+{
+    for (const auto& p : effectParameterSetters)
+    {
+        if (parameter == juce::Identifier(p.id))
+        {
+            (effects.*p.setter)(static_cast<float>(value));
+            return;
+        }
+    }
+
+    for (const auto& e : effectEnableSetters)
+    {
+        if (parameter == juce::Identifier(e.id))
+        {
+            (effects.*e.setter)(static_cast<bool>(value));
+            return;
+        }
+    }
+}
+
+void ProjectManager::setUndoHistoryBudget(juce::int64 maxBytes)
+{
+    // ValueTree actions report sizeof() as their size, which says nothing
+    // about the data they hold, so each step's size is estimated here as it
+    // is performed
+    undoBudgetBytes = juce::jmax<juce::int64>(0, maxBytes);
+    trimUndoHistory();
+}
+
+void ProjectManager::setState(const juce::ValueTree& newState)
+{
+    // Assigning redirects the model (listeners stay registered), then the
+    // engine is rebuilt to match it in one pass
+    projectState = newState;
+    undoManager.clearUndoHistory();
+    undoStepBytes.clear();
+    undoHistoryBytes = 0;
+    nextUndoStep = 0;
+    undoStepPending = false;
+    endGesture();
+
+    while (audioEngine.getNumTracks() > 0)
+        audioEngine.removeTrack(0);
+
+    auto tracks = getTracksState();
+    for (int i = 0; i < tracks.getNumChildren(); ++i)
+    {
+        auto trackState = tracks.getChild(i);
+        if (!trackState.hasType("Track"))
+            continue;
+
+        auto trackIndex = audioEngine.addTrack(trackState.getProperty("name", "Track"));
+        if (auto* track = audioEngine.getTrack(trackIndex))
+            applyTrackState(*track, trackState);
+    }
+}
+
 juce::ValueTree ProjectManager::createProjectXML()
 {
+    // The model is the project; hand out a copy so callers can't edit it
+    // behind the listeners' backs
+    if (projectState.isValid())
+        return projectState.createCopy();
+
     juce::ValueTree project("SignalForgeProject");
     project.setProperty("version", "1.0", nullptr);
-    project.setProperty("name", projectName, nullptr);
+    project.setProperty("name", "Untitled Project", nullptr);
     
-    // Save tracks
+    // Adopt whatever tracks the engine already has
     juce::ValueTree tracks("Tracks");
     for (int i = 0; i < audioEngine.getNumTracks(); ++i)
     {
@@ -84,8 +843,12 @@ juce::ValueTree ProjectManager::createProjectXML()
             juce::ValueTree trackXML("Track");
             trackXML.setProperty("name", track->getName(), nullptr);
             trackXML.setProperty("gain", track->getGain(), nullptr);
+            trackXML.setProperty("pan", track->getPanner().getPan(), nullptr);
+            trackXML.setProperty("layout", track->getChannelLayout().getSpeakerArrangementAsString(), nullptr);
             trackXML.setProperty("muted", track->isMuted(), nullptr);
             trackXML.setProperty("solo", track->isSolo(), nullptr);
+            trackXML.setProperty("armed", track->isRecordArmed(), nullptr);
+            trackXML.setProperty("monitoring", track->isMonitoring(), nullptr);
             
             tracks.appendChild(trackXML, nullptr);
         }
@@ -99,35 +862,24 @@ bool ProjectManager::parseProjectXML(const juce::ValueTree& xml)
 {
     if (!xml.hasType("SignalForgeProject"))
         return false;
-    
-    // Clear existing tracks
-    while (audioEngine.getNumTracks() > 0)
-        audioEngine.removeTrack(0);
-    
-    // Load project info
-    projectName = xml.getProperty("name", "Untitled Project");
-    
-    // Load tracks
-    auto tracksXML = xml.getChildWithName("Tracks");
-    if (tracksXML.isValid())
+
+    auto project = xml.createCopy();
+    if (!project.hasProperty("name"))
+        project.setProperty("name", "Untitled Project", nullptr);
+    if (!project.getChildWithName("Tracks").isValid())
+        project.appendChild(juce::ValueTree("Tracks"), nullptr);
+
+    // Plugin slots are captured from the engine at save time rather than
+    // kept in the model, so they are split off here and loaded separately
+    juce::Array<juce::ValueTree> pluginStates;
+    for (auto trackState : project.getChildWithName("Tracks"))
     {
-        for (int i = 0; i < tracksXML.getNumChildren(); ++i)
-        {
-            auto trackXML = tracksXML.getChild(i);
-            if (trackXML.hasType("Track"))
-            {
-                auto trackName = trackXML.getProperty("name", "Track");
-                int trackIndex = audioEngine.addTrack(trackName);
-                
-                if (auto* track = audioEngine.getTrack(trackIndex))
-                {
-                    track->setGain(trackXML.getProperty("gain", 1.0f));
-                    track->setMuted(trackXML.getProperty("muted", false));
-                    track->setSolo(trackXML.getProperty("solo", false));
-                }
-            }
-        }
+        auto plugins = trackState.getChildWithName("Plugins");
+        trackState.removeChild(plugins, nullptr);
+        pluginStates.add(plugins);
     }
-    
+
+    setState(project);
+    restorePlugins(pluginStates);
     return true;
 }
@@ -1,19 +1,63 @@
 #pragma once
 #include <JuceHeader.h>
+#include <deque>
 
 class AudioEngine;
+class Track;
+class EffectsProcessor;
+class ProjectFileReader;
+class ProjectJournal;
 
-class ProjectManager
+// Owns the live project model. Edits go through the ValueTree (directly or via
+// the helpers below); the manager applies them to the engine and the journal
+// records them for crash recovery. Edits made through the helpers are undoable.
+class ProjectManager : private juce::ValueTree::Listener,
+                       private juce::Timer
 {
 public:
     ProjectManager(AudioEngine& engine);
-    ~ProjectManager();
+    ~ProjectManager() override;
 
     // Project operations
     bool saveProject(const juce::File& file);
     bool loadProject(const juce::File& file);
     bool newProject();
 
+    // XML remains available for interchange; loadProject accepts both formats
+    bool exportProjectXML(const juce::File& file);
+
+    // Lazily loaded sections of the open binary project (e.g. plugin state)
+    bool readProjectChunk(const juce::String& chunkName, juce::MemoryBlock& destData) const;
+
+    // Live model
+    juce::ValueTree& getState() { return projectState; }
+    int addTrack(const juce::String& name = "Track");
+    void removeTrack(int trackIndex);
+    void moveTrack(int fromIndex, int toIndex);
+    // Each call is an undo step of its own, except that repeated changes to
+    // the same property (a slider drag) merge into one until something else
+    // is edited or they pause
+    void setTrackProperty(int trackIndex, const juce::Identifier& property, const juce::var& value);
+    void setTrackAudioFile(int trackIndex, const juce::File& file);
+    void setEffectParameter(int trackIndex, const juce::Identifier& parameter, const juce::var& value);
+
+    // Undo history. ValueTree actions only hold the changed property values or
+    // a reference to the removed subtree, so a step costs O(changed nodes).
+    // Each step's size is estimated as it is performed, and the oldest steps
+    // are dropped while the history is over its byte budget.
+    void beginNewTransaction(const juce::String& actionName = {});
+    bool undo();
+    bool redo();
+    bool canUndo() const { return undoManager.canUndo(); }
+    bool canRedo() const { return undoManager.canRedo(); }
+    void setUndoHistoryBudget(juce::int64 maxBytes);
+    juce::int64 getUndoHistoryBytes() const { return undoHistoryBytes; }
+
+    // Crash recovery from the background autosave
+    bool hasRecoveryData() const;
+    bool recoverAutosave();
+    void discardRecoveryData();
+
     // Project state
     void setProjectFile(const juce::File& file) { currentProjectFile = file; }
     juce::File getProjectFile() const { return currentProjectFile; }
@@ -22,17 +66,72 @@ public:
     void markAsSaved() { unsavedChanges = false; }
 
     // Project info
-    void setProjectName(const juce::String& name) { projectName = name; }
-    juce::String getProjectName() const { return projectName; }
+    void setProjectName(const juce::String& name);
+    juce::String getProjectName() const { return projectState.getProperty("name", "Untitled Project"); }
 
 private:
     AudioEngine& audioEngine;
     juce::File currentProjectFile;
-    juce::String projectName = "Untitled Project";
     bool unsavedChanges = false;
 
+    juce::ValueTree projectState;
+    juce::UndoManager undoManager;
+    std::unique_ptr<ProjectFileReader> projectReader;
+    std::unique_ptr<ProjectJournal> journal;
+    juce::ThreadPool stateCapturePool { 4 };   // sandboxed plugin state requests
+
+    // ValueTree::Listener
+    void valueTreePropertyChanged(juce::ValueTree& tree, const juce::Identifier& property) override;
+    void valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex) override;
+
+    // Hands the journal fresh plugin state while there are unsaved edits
+    void timerCallback() override;
+    void autosavePluginStates();
+
+    static constexpr int pluginAutosaveIntervalMs = 30 * 1000;
+    static constexpr juce::int64 defaultUndoBudgetBytes = 32 * 1024 * 1024;
+
+    // Starts an undo step for a property edit unless it continues the last
+    // one; returns true if it continues, so the change coalesces
+    bool beginGesture(const juce::ValueTree& target, const juce::Identifier& property, const juce::String& actionName);
+    void endGesture() { gestureTarget = juce::ValueTree(); }
+    void setTrackPropertyInTransaction(int trackIndex, const juce::Identifier& property, const juce::var& value);
+
+    juce::ValueTree gestureTarget;
+    juce::Identifier gestureProperty;
+    juce::uint32 lastGestureTime = 0;
+    static constexpr juce::uint32 gestureTimeoutMs = 500;
+
+    // Estimated size of each step the manager holds, oldest first, including
+    // the ones that can be redone; nextUndoStep counts those that can be undone
+    void recordUndoBytes(juce::int64 bytes);
+    void trimUndoHistory();
+
+    std::deque<juce::int64> undoStepBytes;
+    juce::int64 undoHistoryBytes = 0;
+    juce::int64 undoBudgetBytes = defaultUndoBudgetBytes;
+    int nextUndoStep = 0;
+    bool undoStepPending = false;
+
+    juce::ValueTree getTracksState() const { return projectState.getChildWithName("Tracks"); }
+    void applyTrackState(Track& track, const juce::ValueTree& trackState);
+    void applyTrackProperties(Track& track, const juce::ValueTree& trackState);
+    static void applyEffectParameter(EffectsProcessor& effects, const juce::Identifier& parameter, const juce::var& value);
+    void setState(const juce::ValueTree& newState);
+
+    // Plugin slots aren't part of the model; this captures a "Plugins" tree
+    // per track, in track order, and the state chunks they refer to.
+    // Sandboxed plugins are asked for their state all at once.
+    void capturePluginStates(juce::Array<juce::ValueTree>& pluginSlots,
+                             std::map<juce::String, juce::MemoryBlock>& stateChunks);
+    void restorePlugins(const juce::Array<juce::ValueTree>& pluginStates);
+
     juce::ValueTree createProjectXML();
     bool parseProjectXML(const juce::ValueTree& xml);
+    bool loadBinaryProject(const juce::File& file);
+    bool loadXMLProject(const juce::File& file);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProjectManager)
 };
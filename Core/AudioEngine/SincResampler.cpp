@@ -0,0 +1,349 @@
+#include "SincResampler.h"
+
+namespace
+{
+    struct QualitySettings
+    {
+        int numTaps;
+        double rolloff;     // passband edge as a fraction of the lower Nyquist
+        double kaiserBeta;
+    };
+
+    QualitySettings getSettings(SincResampler::Quality quality)
+    {
+        switch (quality)
+        {
+            case SincResampler::Quality::draft:     return { 16, 0.90, 6.0 };
+            case SincResampler::Quality::high:      return { 64, 0.96, 9.5 };
+            case SincResampler::Quality::mastering: return { 96, 0.97, 10.5 };
+            case SincResampler::Quality::standard:
+            default:                                return { 32, 0.94, 8.0 };
+        }
+    }
+
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    double sinc(double x)
+    {
+        if (std::abs(x) < 1.0e-9)
+            return 1.0;
+
+        auto px = juce::MathConstants<double>::pi * x;
+        return std::sin(px) / px;
+    }
+}
+
+SincResampler::SincResampler()
+{
+}
+
+SincResampler::~SincResampler()
+{
+}
+
+int SincResampler::getNumTapsFor(Quality qualityToUse)
+{
+    return getSettings(qualityToUse).numTaps;
+}
+
+void SincResampler::prepare(double inputSampleRate, double outputSampleRate, Quality newQuality)
+{
+    auto settings = getSettings(newQuality);
+
+    quality = newQuality;
+    numTaps = settings.numTaps;
+    step = outputSampleRate > 0.0 ? inputSampleRate / outputSampleRate : 1.0;
+    passThrough = inputSampleRate <= 0.0 || outputSampleRate <= 0.0
+                  || std::abs(inputSampleRate - outputSampleRate) < 1.0e-6;
+
+    if (passThrough)
+        return;
+
+    auto halfTaps = numTaps / 2;
+    auto cutoff = juce::jmin(1.0, outputSampleRate / inputSampleRate) * settings.rolloff;
+    auto windowNorm = besselI0(settings.kaiserBeta);
+
+    kernel.allocate(static_cast<size_t>((numPhases + 1) * numTaps), true);
+
+    for (int phase = 0; phase <= numPhases; ++phase)
+    {
+        auto fraction = static_cast<double>(phase) / numPhases;
+        auto* row = kernel.get() + phase * numTaps;
+        double sum = 0.0;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            // Distance from this tap to the output instant, in input samples
+            auto distance = (halfTaps - 1 - tap) + fraction;
+            auto x = juce::jlimit(-1.0, 1.0, distance / halfTaps);
+            auto window = besselI0(settings.kaiserBeta * std::sqrt(1.0 - x * x)) / windowNorm;
+            auto value = cutoff * sinc(cutoff * distance) * window;
+
+            row[tap] = static_cast<float>(value);
+            sum += value;
+        }
+
+        // Unity gain at DC for every phase
+        if (sum != 0.0)
+            for (int tap = 0; tap < numTaps; ++tap)
+                row[tap] = static_cast<float>(row[tap] / sum);
+    }
+}
+
+float SincResampler::interpolate(const float* window, double fraction) const noexcept
+{
+    auto phasePosition = fraction * numPhases;
+    auto phase = juce::jlimit(0, numPhases - 1, static_cast<int>(phasePosition));
+    auto phaseFraction = static_cast<float>(phasePosition - phase);
+
+    const auto* h0 = kernel.get() + phase * numTaps;
+    const auto* h1 = h0 + numTaps;
+
+    // Independent partial sums in groups of four (numTaps is always a
+    // multiple of 4) so the compiler can keep them in vector registers
+    float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+    float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f, b3 = 0.0f;
+
+    for (int tap = 0; tap < numTaps; tap += 4)
+    {
+        a0 += window[tap]     * h0[tap];
+        a1 += window[tap + 1] * h0[tap + 1];
+        a2 += window[tap + 2] * h0[tap + 2];
+        a3 += window[tap + 3] * h0[tap + 3];
+
+        b0 += window[tap]     * h1[tap];
+        b1 += window[tap + 1] * h1[tap + 1];
+        b2 += window[tap + 2] * h1[tap + 2];
+        b3 += window[tap + 3] * h1[tap + 3];
+    }
+
+    auto a = (a0 + a1) + (a2 + a3);
+    auto b = (b0 + b1) + (b2 + b3);
+    return a + phaseFraction * (b - a);
+}
+
+//==============================================================================
+SincResamplingSource::SincResamplingSource(juce::PositionableAudioSource* inputSource, double inputSampleRate,
+                                           int numChannels)
+    : input(inputSource), inputRate(inputSampleRate), resampler(std::make_unique<SincResampler>())
+{
+    jassert(input != nullptr);
+    history.setSize(juce::jmax(1, numChannels), 0);
+}
+
+SincResamplingSource::~SincResamplingSource()
+{
+    delete untag(handoff.exchange(0));
+}
+
+void SincResamplingSource::setQuality(SincResampler::Quality newQuality)
+{
+    quality = newQuality;
+
+    double rate = 0.0;
+    {
+        const juce::SpinLock::ScopedLockType sl(resamplerLock);
+        rate = outputRate;
+    }
+
+    if (rate <= 0.0)
+        return;
+
+    auto next = std::make_unique<SincResampler>();
+    next->prepare(inputRate, rate, newQuality);
+
+    // Whatever was in the slot is either a replaced resampler or a new one
+    // the audio thread never took; neither is in use
+    delete untag(handoff.exchange(reinterpret_cast<std::uintptr_t>(next.release()) | freshTag));
+}
+
+void SincResamplingSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+    const juce::SpinLock::ScopedLockType sl(resamplerLock);
+
+    outputRate = sampleRate;
+    maxBlockSize = juce::jmax(1, samplesPerBlockExpected);
+
+    // Built for the current quality anyway
+    delete untag(handoff.exchange(0));
+    rebuild();
+}
+
+void SincResamplingSource::rebuild()
+{
+    resampler->prepare(inputRate, outputRate, quality.load());
+
+    // Room for one block's worth of input plus the widest window on either
+    // side, so a quality change never has to grow it
+    auto maxTaps = SincResampler::getNumTapsFor(SincResampler::Quality::mastering);
+    auto capacity = maxTaps + static_cast<int>(std::ceil(maxBlockSize * resampler->getStep())) + 4;
+    history.setSize(history.getNumChannels(), capacity);
+    resetHistory();
+}
+
+void SincResamplingSource::applyPendingResampler()
+{
+    auto slot = handoff.load();
+    if ((slot & freshTag) == 0)
+        return;
+
+    // Fails if setQuality has just replaced it; the newer one is taken next block
+    if (!handoff.compare_exchange_strong(slot, reinterpret_cast<std::uintptr_t>(resampler.get())))
+        return;
+
+    resampler.release();
+    resampler.reset(untag(slot));
+
+    // The buffered input stays where it is; a longer window needs more of it
+    // before the read position, which is made up with silence
+    auto needed = resampler->getNumTaps() / 2 - 1;
+    auto shift = juce::jmin(needed - static_cast<int>(readPosition), history.getNumSamples() - numBuffered);
+
+    if (shift > 0)
+    {
+        for (int channel = 0; channel < history.getNumChannels(); ++channel)
+        {
+            auto* data = history.getWritePointer(channel);
+            std::memmove(data + shift, data, static_cast<size_t>(numBuffered) * sizeof(float));
+            juce::FloatVectorOperations::clear(data, shift);
+        }
+
+        numBuffered += shift;
+        readPosition += shift;
+    }
+}
+
+void SincResamplingSource::releaseResources()
+{
+    input->releaseResources();
+}
+
+void SincResamplingSource::resetHistory()
+{
+    // Zero pre-roll so the first output is centred on the first input sample
+    auto halfTaps = resampler->getNumTaps() / 2;
+    history.clear();
+    numBuffered = juce::jmax(0, halfTaps - 1);
+    readPosition = numBuffered;
+}
+
+void SincResamplingSource::setNextReadPosition(juce::int64 newPosition)
+{
+    const juce::SpinLock::ScopedLockType sl(resamplerLock);
+
+    outputPosition = newPosition;
+    input->setNextReadPosition(resampler->isPassThrough()
+                                   ? newPosition
+                                   : static_cast<juce::int64>(static_cast<double>(newPosition) * resampler->getStep()));
+    resetHistory();
+}
+
+juce::int64 SincResamplingSource::getTotalLength() const
+{
+    if (resampler->isPassThrough())
+        return input->getTotalLength();
+
+    return static_cast<juce::int64>(static_cast<double>(input->getTotalLength()) / resampler->getStep());
+}
+
+void SincResamplingSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    const juce::SpinLock::ScopedTryLockType sl(resamplerLock);
+
+    // The position is being changed right now; drop this block
+    if (!sl.isLocked())
+    {
+        bufferToFill.clearActiveBufferRegion();
+        outputPosition += bufferToFill.numSamples;
+        return;
+    }
+
+    // A quality change lands between blocks
+    applyPendingResampler();
+
+    if (resampler->isPassThrough())
+    {
+        input->getNextAudioBlock(bufferToFill);
+    }
+    else
+    {
+        for (int done = 0; done < bufferToFill.numSamples;)
+        {
+            auto numSamples = juce::jmin(maxBlockSize, bufferToFill.numSamples - done);
+            render(*bufferToFill.buffer, bufferToFill.startSample + done, numSamples);
+            done += numSamples;
+        }
+    }
+
+    outputPosition += bufferToFill.numSamples;
+}
+
+void SincResamplingSource::render(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto halfTaps = resampler->getNumTaps() / 2;
+    auto step = resampler->getStep();
+
+    // Discard input the window has moved past
+    auto consumed = static_cast<int>(readPosition) - (halfTaps - 1);
+    if (consumed > 0)
+    {
+        for (int channel = 0; channel < history.getNumChannels(); ++channel)
+        {
+            auto* data = history.getWritePointer(channel);
+            std::memmove(data, data + consumed, static_cast<size_t>(numBuffered - consumed) * sizeof(float));
+        }
+
+        numBuffered -= consumed;
+        readPosition -= consumed;
+    }
+
+    // Pull exactly the input this chunk's last window reaches
+    auto lastNeeded = static_cast<int>(readPosition + (numSamples - 1) * step) + halfTaps;
+    auto numToRead = juce::jmin(lastNeeded + 1, history.getNumSamples()) - numBuffered;
+
+    if (numToRead > 0)
+    {
+        juce::AudioSourceChannelInfo info(&history, numBuffered, numToRead);
+        input->getNextAudioBlock(info);
+        numBuffered += numToRead;
+    }
+
+    auto numOutputChannels = buffer.getNumChannels();
+    auto endPosition = readPosition;
+
+    for (int channel = 0; channel < numOutputChannels; ++channel)
+    {
+        auto* out = buffer.getWritePointer(channel, startSample);
+
+        if (channel >= history.getNumChannels())
+        {
+            juce::FloatVectorOperations::clear(out, numSamples);
+            continue;
+        }
+
+        const auto* in = history.getReadPointer(channel);
+        auto position = readPosition;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            auto index = static_cast<int>(position);
+            out[i] = resampler->interpolate(in + index - (halfTaps - 1), position - index);
+            position += step;
+        }
+
+        endPosition = position;
+    }
+
+    readPosition = endPosition;
+}
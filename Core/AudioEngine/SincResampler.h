@@ -0,0 +1,110 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Polyphase windowed-sinc interpolator.
+//
+// The kernel is tabulated at a fixed number of sub-sample phases; each output
+// sample is a dot product of the input window with the kernel, interpolated
+// linearly between the two nearest phases. When downsampling the cutoff moves
+// down with the ratio so that content above the new Nyquist is removed rather
+// than folded back.
+class SincResampler
+{
+public:
+    enum class Quality
+    {
+        draft = 0,   // 16 taps, for previews and weak machines
+        standard,    // 32 taps
+        high,        // 64 taps
+        mastering    // 96 taps, offline rendering
+    };
+
+    SincResampler();
+    ~SincResampler();
+
+    // Builds the kernel table; call from a non-realtime thread
+    void prepare(double inputSampleRate, double outputSampleRate, Quality newQuality);
+
+    bool isPassThrough() const { return passThrough; }
+    Quality getQuality() const { return quality; }
+    int getNumTaps() const { return numTaps; }
+
+    // Input samples consumed per output sample
+    double getStep() const { return step; }
+
+    // One output sample. window points at numTaps input samples, centred so
+    // that the output lies `fraction` of a sample after window[numTaps / 2 - 1].
+    float interpolate(const float* window, double fraction) const noexcept;
+
+    static int getNumTapsFor(Quality quality);
+
+private:
+    static constexpr int numPhases = 256;
+
+    juce::HeapBlock<float> kernel;  // (numPhases + 1) rows of numTaps
+    Quality quality = Quality::standard;
+    int numTaps = 0;
+    double step = 1.0;
+    bool passThrough = true;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SincResampler)
+};
+
+//==============================================================================
+// Streams a PositionableAudioSource through a SincResampler, keeping per-source
+// history so block boundaries are seamless. Positions and lengths are reported
+// at the output rate, so an AudioTransportSource on top needs no resampling
+// of its own (pass 0 as its source sample rate).
+class SincResamplingSource : public juce::PositionableAudioSource
+{
+public:
+    SincResamplingSource(juce::PositionableAudioSource* input, double inputSampleRate, int numChannels = 2);
+    ~SincResamplingSource() override;
+
+    // Message thread. The new kernel is built here and swapped in by the
+    // audio thread at the start of its next block, keeping the buffered input
+    void setQuality(SincResampler::Quality newQuality);
+    SincResampler::Quality getQuality() const { return quality.load(); }
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(juce::int64 newPosition) override;
+    juce::int64 getNextReadPosition() const override { return outputPosition; }
+    juce::int64 getTotalLength() const override;
+    bool isLooping() const override { return input->isLooping(); }
+    void setLooping(bool shouldLoop) override { input->setLooping(shouldLoop); }
+
+private:
+    void rebuild();
+    void resetHistory();
+    void applyPendingResampler();
+    void render(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    juce::PositionableAudioSource* input;
+    double inputRate;
+    double outputRate = 0.0;
+    int maxBlockSize = 0;
+
+    std::unique_ptr<SincResampler> resampler;
+    std::atomic<SincResampler::Quality> quality { SincResampler::Quality::standard };
+    juce::SpinLock resamplerLock;
+
+    // One slot passes resamplers both ways, so the audio thread never
+    // allocates or frees: setQuality leaves a new one tagged as fresh, the
+    // audio thread swaps in the one it replaces, which setQuality frees next
+    std::atomic<std::uintptr_t> handoff { 0 };
+    static constexpr std::uintptr_t freshTag = 1;
+
+    static SincResampler* untag(std::uintptr_t slot) { return reinterpret_cast<SincResampler*>(slot & ~freshTag); }
+
+    // Input samples still needed by the window, starting at index 0
+    juce::AudioBuffer<float> history;
+    int numBuffered = 0;
+    double readPosition = 0.0;   // position of the next output within history
+
+    std::atomic<juce::int64> outputPosition { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SincResamplingSource)
+};
@@ -0,0 +1,213 @@
+#include "SpectrumAnalyser.h"
+#include <numeric>
+
+SpectrumAnalyser::SpectrumAnalyser()
+    : juce::Thread("Spectrum Analyser")
+{
+}
+
+SpectrumAnalyser::~SpectrumAnalyser()
+{
+    stop();
+}
+
+void SpectrumAnalyser::prepare(double sampleRate)
+{
+    currentSampleRate.store(sampleRate, std::memory_order_relaxed);
+}
+
+void SpectrumAnalyser::setSettings(const Settings& newSettings)
+{
+    const juce::ScopedLock sl(settingsLock);
+    settings = newSettings;
+    settings.fftOrder = juce::jlimit(minFftOrder, maxFftOrder, settings.fftOrder);
+    settings.overlap = juce::jlimit(1, 16, settings.overlap);
+    settings.numBands = juce::jmax(1, settings.numBands);
+}
+
+SpectrumAnalyser::Settings SpectrumAnalyser::getSettings() const
+{
+    const juce::ScopedLock sl(settingsLock);
+    return settings;
+}
+
+void SpectrumAnalyser::start()
+{
+    if (running.load())
+        return;
+
+    // The FIFO is sized for the largest FFT once and then kept, so the
+    // audio thread can never see it reallocated
+    if (fifoBuffer.getNumSamples() == 0)
+        fifoBuffer.setSize(fifoChannels, fifoSize);
+
+    activeSettings = getSettings();
+    analysisSampleRate = currentSampleRate.load(std::memory_order_relaxed);
+
+    auto fftSize = 1 << activeSettings.fftOrder;
+    fft = std::make_unique<juce::dsp::FFT>(activeSettings.fftOrder);
+    window = std::make_unique<juce::dsp::WindowingFunction<float>>(static_cast<size_t>(fftSize),
+                                                                   juce::dsp::WindowingFunction<float>::hann,
+                                                                   false);
+
+    // Amplitude of a full-scale sine reads 0 dB: 2 / sum of the window
+    std::vector<float> ones(static_cast<size_t>(fftSize), 1.0f);
+    window->multiplyWithWindowingTable(ones.data(), static_cast<size_t>(fftSize));
+    auto windowSum = std::accumulate(ones.begin(), ones.end(), 0.0f);
+    magnitudeScale = windowSum > 0.0f ? 2.0f / windowSum : 1.0f;
+
+    history.assign(static_cast<size_t>(fftSize), 0.0f);
+    fftData.assign(static_cast<size_t>(fftSize * 2), 0.0f);
+    pendingBands.assign(static_cast<size_t>(activeSettings.numBands), -120.0f);
+    samplesInHistory = 0;
+    pendingValid = false;
+    buildBands();
+
+    running.store(true, std::memory_order_release);
+    startThread();
+}
+
+void SpectrumAnalyser::stop()
+{
+    running.store(false, std::memory_order_release);
+    stopThread(1000);
+}
+
+void SpectrumAnalyser::pushSamples(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    if (!running.load(std::memory_order_acquire) || buffer.getNumChannels() == 0)
+        return;
+
+    // A full FIFO means the analyser has fallen behind; drop what won't fit
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    for (int channel = 0; channel < fifoChannels; ++channel)
+    {
+        auto source = juce::jmin(channel, buffer.getNumChannels() - 1);
+
+        if (size1 > 0)
+            fifoBuffer.copyFrom(channel, start1, buffer, source, startSample, size1);
+        if (size2 > 0)
+            fifoBuffer.copyFrom(channel, start2, buffer, source, startSample + size1, size2);
+    }
+
+    fifo.finishedWrite(size1 + size2);
+}
+
+void SpectrumAnalyser::run()
+{
+    auto fftSize = 1 << activeSettings.fftOrder;
+    auto hop = juce::jmax(1, fftSize / activeSettings.overlap);
+
+    // Whatever was left over from a previous run is stale
+    fifo.finishedRead(fifo.getNumReady());
+
+    while (!threadShouldExit())
+    {
+        if (fifo.getNumReady() < hop)
+        {
+            wait(5);
+            continue;
+        }
+
+        // Slide the history along by one hop and append the mono sum
+        std::memmove(history.data(), history.data() + hop, static_cast<size_t>(fftSize - hop) * sizeof(float));
+        auto* tail = history.data() + (fftSize - hop);
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(hop, start1, size1, start2, size2);
+
+        auto mixDown = [this, tail](int fifoStart, int count, int offset)
+        {
+            const auto* left = fifoBuffer.getReadPointer(0, fifoStart);
+            const auto* right = fifoBuffer.getReadPointer(1, fifoStart);
+
+            for (int i = 0; i < count; ++i)
+                tail[offset + i] = 0.5f * (left[i] + right[i]);
+        };
+
+        mixDown(start1, size1, 0);
+        mixDown(start2, size2, size1);
+        fifo.finishedRead(size1 + size2);
+
+        samplesInHistory = juce::jmin(fftSize, samplesInHistory + hop);
+
+        if (samplesInHistory == fftSize)
+            analyse();
+    }
+}
+
+void SpectrumAnalyser::analyse()
+{
+    auto fftSize = 1 << activeSettings.fftOrder;
+
+    std::copy(history.begin(), history.end(), fftData.begin());
+    std::fill(fftData.begin() + fftSize, fftData.end(), 0.0f);
+    window->multiplyWithWindowingTable(fftData.data(), static_cast<size_t>(fftSize));
+    fft->performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+    for (int band = 0; band < activeSettings.numBands; ++band)
+    {
+        auto first = bandStartBins[static_cast<size_t>(band)];
+        auto last = juce::jmax(first + 1, bandStartBins[static_cast<size_t>(band + 1)]);
+
+        float magnitude = 0.0f;
+        for (int bin = first; bin < last; ++bin)
+            magnitude = juce::jmax(magnitude, fftData[static_cast<size_t>(bin)]);
+
+        auto db = juce::Decibels::gainToDecibels(magnitude * magnitudeScale, -120.0f);
+        auto& pending = pendingBands[static_cast<size_t>(band)];
+        pending = pendingValid ? juce::jmax(pending, db) : db;
+    }
+
+    pendingValid = true;
+
+    // Decimate to the GUI's pace; the frames in between were max-held above
+    auto now = juce::Time::getMillisecondCounterHiRes();
+    if (now - lastPublishTime < activeSettings.publishIntervalMs)
+        return;
+
+    lastPublishTime = now;
+    pendingValid = false;
+
+    {
+        const juce::ScopedLock sl(frameLock);
+        latestFrame = pendingBands;
+    }
+
+    framesPublished.fetch_add(1, std::memory_order_release);
+}
+
+void SpectrumAnalyser::buildBands()
+{
+    auto fftSize = 1 << activeSettings.fftOrder;
+    auto nyquist = analysisSampleRate * 0.5;
+    auto minFrequency = juce::jlimit(1.0, nyquist * 0.5, activeSettings.minFrequency);
+
+    bandStartBins.resize(static_cast<size_t>(activeSettings.numBands + 1));
+
+    for (int edge = 0; edge <= activeSettings.numBands; ++edge)
+    {
+        auto frequency = minFrequency * std::pow(nyquist / minFrequency, static_cast<double>(edge) / activeSettings.numBands);
+        auto bin = juce::roundToInt(frequency * fftSize / analysisSampleRate);
+        bandStartBins[static_cast<size_t>(edge)] = juce::jlimit(1, fftSize / 2, bin);
+    }
+}
+
+void SpectrumAnalyser::copyLatestFrame(std::vector<float>& destination) const
+{
+    const juce::ScopedLock sl(frameLock);
+    destination = latestFrame;
+}
+
+double SpectrumAnalyser::getBandFrequency(int band) const
+{
+    auto current = getSettings();
+    auto nyquist = currentSampleRate.load(std::memory_order_relaxed) * 0.5;
+    auto minFrequency = juce::jlimit(1.0, nyquist * 0.5, current.minFrequency);
+    auto ratio = nyquist / minFrequency;
+
+    // Geometric centre of the band's edges
+    return minFrequency * std::pow(ratio, (band + 0.5) / current.numBands);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+
+// Spectrum analyser tap for a track or the master.
+//
+// The audio thread only copies the block into a lock-free FIFO, and only
+// while the analyser is running. A background thread pulls hop-sized chunks,
+// runs a Hann-windowed FFT over the last fftSize samples (mono sum), folds
+// the bins into log-spaced bands and publishes a frame of band levels in dB,
+// at most once per publish interval (frames in between are max-held).
+class SpectrumAnalyser : private juce::Thread
+{
+public:
+    struct Settings
+    {
+        int fftOrder = 11;          // 2048 points
+        int overlap = 4;            // hop = fftSize / overlap
+        int numBands = 96;
+        double minFrequency = 20.0;
+        int publishIntervalMs = 16;
+    };
+
+    SpectrumAnalyser();
+    ~SpectrumAnalyser() override;
+
+    void prepare(double sampleRate);
+
+    // Message thread. Settings apply from the next start().
+    void setSettings(const Settings& newSettings);
+    Settings getSettings() const;
+
+    void start();
+    void stop();
+    bool isRunning() const { return running.load(std::memory_order_relaxed); }
+
+    // Audio thread: a copy into the FIFO, nothing else
+    void pushSamples(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // Any thread. Bands run from minFrequency to Nyquist, in dB.
+    juce::int64 getNumFramesPublished() const { return framesPublished.load(std::memory_order_acquire); }
+    void copyLatestFrame(std::vector<float>& destination) const;
+
+    // Centre frequency of a band for the current settings
+    double getBandFrequency(int band) const;
+
+    static constexpr int minFftOrder = 8;
+    static constexpr int maxFftOrder = 14;
+
+private:
+    void run() override;
+    void analyse();
+    void buildBands();
+
+    static constexpr int fifoChannels = 2;
+    static constexpr int fifoSize = 4 << maxFftOrder;
+
+    juce::AbstractFifo fifo { fifoSize };
+    juce::AudioBuffer<float> fifoBuffer;
+    std::atomic<bool> running { false };
+    std::atomic<double> currentSampleRate { 44100.0 };
+
+    Settings settings;
+    mutable juce::CriticalSection settingsLock;
+
+    // Analysis thread only (set up by start() before the thread runs)
+    Settings activeSettings;
+    double analysisSampleRate = 44100.0;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    std::vector<float> history, fftData, pendingBands;
+    std::vector<int> bandStartBins;
+    int samplesInHistory = 0;
+    bool pendingValid = false;
+    double lastPublishTime = 0.0;
+    float magnitudeScale = 1.0f;
+
+    mutable juce::CriticalSection frameLock;
+    std::vector<float> latestFrame;
+    std::atomic<juce::int64> framesPublished { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumAnalyser)
+};
@@ -1,31 +1,252 @@
 #include "Track.h"
 #include "EffectsProcessor.h"
-#include "PluginHost.h"
+#include "PluginChain.h"
+#include "PluginSandbox.h"
+
+//==============================================================================
+// Offline render of the track's file through its effects and plugins. Holds
+// the chain lock throughout, so the live callback leaves the chain alone.
+class Track::FreezeJob : public juce::Thread
+{
+public:
+    FreezeJob(Track& owner, std::unique_ptr<MediaPool::Source> sourceToRender,
+              const juce::File& fileToWrite, std::function<void(bool)> callback)
+        : juce::Thread("Track freeze"),
+          track(owner),
+          source(std::move(sourceToRender)),
+          renderFile(fileToWrite),
+          sampleRate(owner.currentSampleRate),
+          numChannels(owner.numChannels),
+          precision(owner.precision),
+          quality(owner.resamplingQuality),
+          onComplete(std::move(callback))
+    {
+    }
+
+    ~FreezeJob() override
+    {
+        stopThread(10000);
+    }
+
+    void run() override
+    {
+        auto success = render();
+
+        if (!success || threadShouldExit())
+        {
+            renderFile.deleteFile();
+
+            // Cancelled by the track, which has already moved on
+            if (threadShouldExit())
+                return;
+        }
+
+        juce::WeakReference<Track> weakTrack(&track);
+        auto* job = this;
+        auto file = renderFile;
+        auto callback = onComplete;
+
+        juce::MessageManager::callAsync([weakTrack, job, success, file, callback]
+        {
+            if (auto* owner = weakTrack.get())
+                owner->finishFreeze(job, success, file, callback);
+            else
+                file.deleteFile();
+        });
+    }
+
+private:
+    bool render()
+    {
+        // Reverb and delay tails carry on past the end of the file
+        constexpr double tailSeconds = 2.0;
+
+        SincResamplingSource resampled(source.get(), source->getMedia().getSampleRate(), numChannels);
+        resampled.setQuality(quality);
+        resampled.prepareToPlay(blockSize, sampleRate);
+        resampled.setNextReadPosition(0);
+
+        const juce::SpinLock::ScopedLockType lock(track.chainLock);
+
+        // The chain runs in the track's precision, as it does live; the
+        // track's double buffer is free while the lock is held
+        auto useDouble = precision == juce::AudioProcessor::doublePrecision;
+        track.doubleBuffer.setSize(useDouble ? numChannels : 0, useDouble ? blockSize : 0);
+
+        track.effectsProcessor->prepareToPlay(sampleRate, blockSize, numChannels);
+        track.pluginChain->prepareToPlay(sampleRate, blockSize);
+
+        // The chain's latency is trimmed off the front, so the render lines
+        // up with the timeline without compensation
+        auto latency = static_cast<juce::int64>(track.pluginChain->getLatencySamples());
+        auto length = resampled.getTotalLength();
+        auto total = length + static_cast<juce::int64>(sampleRate * tailSeconds) + latency;
+
+        renderFile.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp(renderFile);
+        juce::WavAudioFormat wav;
+
+        {
+            std::unique_ptr<juce::OutputStream> stream(temp.getFile().createOutputStream());
+            if (stream == nullptr)
+                return false;
+
+            std::unique_ptr<juce::AudioFormatWriter> writer(
+                wav.createWriterFor(stream.get(), sampleRate, static_cast<unsigned int>(numChannels), 32, {}, 0));
+            if (writer == nullptr)
+                return false;
+
+            stream.release();
+
+            juce::AudioBuffer<float> block(numChannels, blockSize);
+
+            for (juce::int64 position = 0; position < total; position += blockSize)
+            {
+                if (threadShouldExit())
+                    return false;
+
+                auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(blockSize), total - position));
+                block.setSize(numChannels, numSamples, false, false, true);
+                block.clear();
+
+                if (position < length)
+                {
+                    auto numToRead = static_cast<int>(juce::jmin(static_cast<juce::int64>(numSamples), length - position));
+                    juce::AudioSourceChannelInfo info(&block, 0, numToRead);
+                    resampled.getNextAudioBlock(info);
+                }
+
+                if (useDouble)
+                {
+                    juce::AudioBuffer<double> doubleBlock(track.doubleBuffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+                    for (int channel = 0; channel < numChannels; ++channel)
+                        std::copy_n(block.getReadPointer(channel), numSamples, doubleBlock.getWritePointer(channel));
+
+                    track.processChain(doubleBlock);
+
+                    for (int channel = 0; channel < numChannels; ++channel)
+                        std::copy_n(doubleBlock.getReadPointer(channel), numSamples, block.getWritePointer(channel));
+                }
+                else
+                {
+                    track.processChain(block);
+                }
+
+                auto skip = static_cast<int>(juce::jlimit(static_cast<juce::int64>(0),
+                                                          static_cast<juce::int64>(numSamples),
+                                                          latency - position));
+
+                if (!writer->writeFromAudioSampleBuffer(block, skip, numSamples - skip))
+                    return false;
+            }
+        }
+
+        return temp.overwriteTargetFileWithTemporary();
+    }
+
+    static constexpr int blockSize = 4096;
+
+    Track& track;
+    std::unique_ptr<MediaPool::Source> source;
+    juce::File renderFile;
+    double sampleRate;
+    int numChannels;
+    juce::AudioProcessor::ProcessingPrecision precision;
+    SincResampler::Quality quality;
+    std::function<void(bool)> onComplete;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FreezeJob)
+};
+
+//==============================================================================
 
 Track::Track(const juce::String& name) 
     : trackName(name), 
       effectsProcessor(std::make_unique<EffectsProcessor>()),
-      pluginHost(std::make_unique<PluginHost>())
+      pluginChain(std::make_unique<PluginChain>())
 {
 }
 
 Track::~Track()
 {
+    freezeJob.reset();
     releaseResources();
+    frozenFile.deleteFile();
 }
 
 void Track::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
+    auto rateChanged = sampleRate != currentSampleRate;
+    currentSampleRate = sampleRate;
+    currentBlockSize = samplesPerBlockExpected;
+
+    auto layoutChannels = juce::jlimit(1, Panner::maxChannels, channelLayout.size());
+    if (layoutChannels != numChannels)
+    {
+        numChannels = layoutChannels;
+        rebuildResamplers();
+    }
+
+    pluginChain->setChannelLayout(channelLayout);
+    panner.prepare(channelLayout, busLayout);
+
+    // A render for the old device rate is no use any more
+    if (rateChanged && renderedSource != nullptr && resamplingSource != nullptr)
+    {
+        if (!frozen)
+            transportSource.setSource(resamplingSource.get(), 0, nullptr, 0.0);
+        renderedSource.reset();
+    }
+
     transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    effectsProcessor->prepareToPlay(sampleRate, samplesPerBlockExpected, 2); // Stereo
-    pluginHost->prepareToPlay(sampleRate, samplesPerBlockExpected);
+
+    // Room for whatever a sandboxed plugin sends back, so the audio thread
+    // never grows this buffer
+    midiBuffer.ensureSize(PluginSandbox::maxMidiBytes);
+
+    // A frozen track has no use for its chain, and a freezing one is busy
+    if (!frozen && freezeJob == nullptr)
+        prepareChain();
+
+    compensationDelay.prepare(numChannels, static_cast<int>(sampleRate * maxCompensationSeconds));
+    meter.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    loudnessMeter.prepare(sampleRate, channelLayout);
+    spectrumAnalyser.prepare(sampleRate);
+
+    if (rateChanged)
+        requestPreRender();
 }
 
 void Track::releaseResources()
 {
     transportSource.releaseResources();
-    effectsProcessor->reset();
-    pluginHost->releaseResources();
+    compensationDelay.reset();
+
+    const juce::SpinLock::ScopedTryLockType lock(chainLock);
+    if (lock.isLocked())
+    {
+        effectsProcessor->reset();
+        pluginChain->releaseResources();
+    }
+}
+
+void Track::setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision newPrecision)
+{
+    precision = newPrecision;
+    effectsProcessor->setProcessingPrecision(newPrecision);
+    pluginChain->setProcessingPrecision(newPrecision);
+}
+
+void Track::prepareChain()
+{
+    if (precision == juce::AudioProcessor::doublePrecision)
+        doubleBuffer.setSize(numChannels, currentBlockSize);
+    else
+        doubleBuffer.setSize(0, 0);
+
+    effectsProcessor->prepareToPlay(currentSampleRate, currentBlockSize, numChannels);
+    pluginChain->prepareToPlay(currentSampleRate, currentBlockSize);
 }
 
 void Track::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
@@ -33,18 +254,75 @@ void Track::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
     if (muted)
     {
         bufferToFill.clearActiveBufferRegion();
+        meter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        loudnessMeter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        skipBlock();
         return;
     }
 
+    renderBlock(bufferToFill);
+    finishBlock(bufferToFill);
+}
+
+void Track::renderBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
     transportSource.getNextAudioBlock(bufferToFill);
-    
+
+    // A frozen track's file already has the chain rendered into it
+    if (!frozen)
+    {
+        const juce::SpinLock::ScopedTryLockType lock(chainLock);
+
+        if (lock.isLocked() && precision == juce::AudioProcessor::doublePrecision)
+        {
+            auto numChannels = juce::jmin(bufferToFill.buffer->getNumChannels(), doubleBuffer.getNumChannels());
+            auto numSamples = juce::jmin(bufferToFill.numSamples, doubleBuffer.getNumSamples());
+            juce::AudioBuffer<double> block(doubleBuffer.getArrayOfWritePointers(), numChannels, numSamples);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                std::copy_n(bufferToFill.buffer->getReadPointer(channel, bufferToFill.startSample), numSamples,
+                            block.getWritePointer(channel));
+
+            processChain(block);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                std::copy_n(block.getReadPointer(channel), numSamples,
+                            bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample));
+        }
+        else if (lock.isLocked())
+        {
+            processChain(*bufferToFill.buffer);
+        }
+        else
+        {
+            // Being frozen; the render owns the chain
+            bufferToFill.clearActiveBufferRegion();
+        }
+    }
+
+    // Align with the slowest path in the mix
+    if (compensationStale)
+    {
+        compensationDelay.reset();
+        compensationStale = false;
+    }
+
+    compensationDelay.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+}
+
+template <typename SampleType>
+void Track::processChain(juce::AudioBuffer<SampleType>& buffer)
+{
     // Apply built-in effects
-    effectsProcessor->processBlock(*bufferToFill.buffer);
-    
-    // Process through plugin
+    effectsProcessor->processBlock(buffer);
+
+    // Process through the plugin insert chain
     midiBuffer.clear();
-    pluginHost->processBlock(*bufferToFill.buffer, midiBuffer);
-    
+    pluginChain->processBlock(buffer, midiBuffer);
+}
+
+void Track::finishBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
     // Apply gain
     if (gain != 1.0f)
     {
@@ -54,19 +332,245 @@ void Track::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
                                          bufferToFill.numSamples, gain);
         }
     }
+
+    meter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+    loudnessMeter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+    spectrumAnalyser.pushSamples(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
 }
 
 void Track::loadAudioFile(const juce::File& file)
 {
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-    
-    auto reader = formatManager.createReaderFor(file);
-    if (reader != nullptr)
+    // A freeze is of the old file
+    cancelFreeze();
+    unfreeze();
+
+    // Tracks playing the same audio share one reader and decoded cache
+    auto source = MediaPool::getInstance().createSource(file);
+    if (source == nullptr)
+        return;
+
+    auto resampler = createResampler(*source);
+
+    // Positions are already at the device rate, so the transport itself
+    // does no resampling
+    transportSource.setSource(resampler.get(), 0, nullptr, 0.0);
+
+    // The transport has let go of the old sources, so they can go now
+    renderedSource.reset();
+    resamplingSource = std::move(resampler);
+    mediaSource = std::move(source);
+    audioFile = file;
+
+    requestPreRender();
+}
+
+void Track::setResamplingQuality(SincResampler::Quality quality)
+{
+    resamplingQuality = quality;
+
+    if (resamplingSource != nullptr)
+        resamplingSource->setQuality(quality);
+
+    if (frozenResampler != nullptr)
+        frozenResampler->setQuality(quality);
+}
+
+void Track::setChannelLayout(const juce::AudioChannelSet& newLayout)
+{
+    if (newLayout.isDisabled() || newLayout.size() > Panner::maxChannels)
+    {
+        juce::Logger::writeToLog("Track: unsupported channel layout " + newLayout.getDescription());
+        return;
+    }
+
+    channelLayout = newLayout;
+}
+
+std::unique_ptr<SincResamplingSource> Track::createResampler(MediaPool::Source& source) const
+{
+    auto resampler = std::make_unique<SincResamplingSource>(&source, source.getMedia().getSampleRate(), numChannels);
+    resampler->setQuality(resamplingQuality);
+    return resampler;
+}
+
+void Track::rebuildResamplers()
+{
+    // The resamplers keep per-channel state, so they are remade for a new
+    // channel count; the one playing is swapped in place
+    if (mediaSource != nullptr)
+    {
+        auto resampler = createResampler(*mediaSource);
+        if (!frozen && renderedSource == nullptr)
+            setTransportInput(resampler.get());
+        resamplingSource = std::move(resampler);
+    }
+
+    if (frozenSource != nullptr)
+    {
+        auto resampler = createResampler(*frozenSource);
+        if (frozen)
+            setTransportInput(resampler.get());
+        frozenResampler = std::move(resampler);
+    }
+}
+
+void Track::requestPreRender()
+{
+    auto& pool = MediaPool::getInstance();
+
+    if (!pool.isPreRenderResampling() || mediaSource == nullptr || currentSampleRate <= 0.0
+        || mediaSource->getMedia().getSampleRate() == currentSampleRate)
+        return;
+
+    juce::WeakReference<Track> weakThis(this);
+    auto requestedFile = audioFile;
+    auto requestedRate = currentSampleRate;
+
+    pool.renderResampledAsync(audioFile, currentSampleRate, resamplingQuality,
+        [weakThis, requestedFile, requestedRate](std::unique_ptr<MediaPool::Source> rendered)
+        {
+            auto* track = weakThis.get();
+
+            // The track, its file or the device rate changed while rendering
+            if (track == nullptr || rendered == nullptr
+                || track->audioFile != requestedFile || track->currentSampleRate != requestedRate)
+                return;
+
+            track->switchToRendered(std::move(rendered));
+        });
+}
+
+void Track::switchToRendered(std::unique_ptr<MediaPool::Source> rendered)
+{
+    // A frozen track picks the render up when it is unfrozen
+    if (!frozen)
+        setTransportInput(rendered.get());
+
+    renderedSource = std::move(rendered);
+}
+
+void Track::setTransportInput(juce::PositionableAudioSource* input)
+{
+    auto position = transportSource.getNextReadPosition();
+    auto wasPlaying = transportSource.isPlaying();
+
+    transportSource.setSource(input, 0, nullptr, 0.0);
+    transportSource.setNextReadPosition(position);
+
+    if (wasPlaying)
+        transportSource.start();
+}
+
+void Track::freeze(std::function<void(bool)> onComplete)
+{
+    if (frozen || freezeJob != nullptr || currentSampleRate <= 0.0 || audioFile == juce::File())
+    {
+        if (onComplete != nullptr)
+            onComplete(frozen);
+        return;
+    }
+
+    // The render gets its own cursor so playback position is left alone
+    auto source = MediaPool::getInstance().createSource(audioFile);
+    if (source == nullptr)
+    {
+        if (onComplete != nullptr)
+            onComplete(false);
+        return;
+    }
+
+    // Rendered off the audio thread, so it can wait for every block
+    source->setNonRealtime(true);
+
+    auto renderFile = MediaPool::getInstance().getCacheDirectory()
+                          .getChildFile("Frozen")
+                          .getNonexistentChildFile(audioFile.getFileNameWithoutExtension() + "-frozen", ".wav");
+
+    freezeJob = std::make_unique<FreezeJob>(*this, std::move(source), renderFile, std::move(onComplete));
+    freezeJob->startThread();
+}
+
+void Track::cancelFreeze()
+{
+    if (freezeJob == nullptr)
+        return;
+
+    freezeJob.reset();
+
+    const juce::SpinLock::ScopedLockType lock(chainLock);
+    prepareChain();
+}
+
+void Track::finishFreeze(FreezeJob* job, bool success, const juce::File& renderFile,
+                         std::function<void(bool)> onComplete)
+{
+    // Cancelled, and maybe restarted, since this render was posted
+    if (freezeJob.get() != job)
     {
-        readerSource = std::make_unique<juce::AudioFormatReaderSource>(reader, true);
-        transportSource.setSource(readerSource.get(), 0, nullptr, reader->sampleRate);
+        renderFile.deleteFile();
+        return;
+    }
+
+    freezeJob.reset();
+
+    std::unique_ptr<MediaPool::Source> source;
+    if (success)
+        source = MediaPool::getInstance().createSource(renderFile);
+
+    if (source == nullptr)
+    {
+        juce::Logger::writeToLog("Track: freezing " + trackName + " failed");
+        renderFile.deleteFile();
+
+        const juce::SpinLock::ScopedLockType lock(chainLock);
+        prepareChain();
     }
+    else
+    {
+        // Rendered at the device rate, but kept playable if that changes
+        auto resampler = createResampler(*source);
+
+        setTransportInput(resampler.get());
+        frozen = true;
+        freezeLatencyChanged = true;
+
+        frozenResampler = std::move(resampler);
+        frozenSource = std::move(source);
+        frozenFile.deleteFile();
+        frozenFile = renderFile;
+
+        // Nothing runs the chain now, so let it drop its buffers
+        const juce::SpinLock::ScopedLockType lock(chainLock);
+        effectsProcessor->reset();
+        pluginChain->releaseResources();
+    }
+
+    if (onComplete != nullptr)
+        onComplete(source != nullptr);
+}
+
+void Track::unfreeze()
+{
+    if (!frozen)
+        return;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(chainLock);
+        prepareChain();
+    }
+
+    juce::PositionableAudioSource* live = renderedSource.get();
+    if (live == nullptr)
+        live = resamplingSource.get();
+
+    setTransportInput(live);
+    frozen = false;
+    freezeLatencyChanged = true;
+
+    frozenResampler.reset();
+    frozenSource.reset();
+    frozenFile.deleteFile();
+    frozenFile = juce::File();
 }
 
 void Track::setGain(float newGain)
@@ -84,15 +588,41 @@ void Track::setSolo(bool shouldSolo)
     solo = shouldSolo;
 }
 
+void Track::setRecordArmed(bool armed)
+{
+    recordArmed.store(armed);
+}
+
+void Track::setMonitoring(bool shouldMonitor)
+{
+    monitoring.store(shouldMonitor);
+}
+
 void Track::setPosition(double positionInSeconds)
 {
     transportSource.setPosition(positionInSeconds);
 }
 
+int Track::getLatencySamples() const
+{
+    // The freeze render has the chain's latency trimmed off
+    return frozen ? 0 : pluginChain->getLatencySamples();
+}
+
+bool Track::checkAndClearLatencyChanged()
+{
+    auto changed = pluginChain->checkAndClearLatencyChanged();
+    return freezeLatencyChanged.exchange(false) || changed;
+}
+
+void Track::setCompensationDelay(int delayInSamples)
+{
+    compensationDelay.setDelay(delayInSamples);
+}
+
 double Track::getLength() const
 {
-    if (readerSource && readerSource->getAudioFormatReader())
-        return readerSource->getAudioFormatReader()->lengthInSamples / 
-               readerSource->getAudioFormatReader()->sampleRate;
+    if (mediaSource != nullptr && mediaSource->getMedia().getSampleRate() > 0.0)
+        return static_cast<double>(mediaSource->getTotalLength()) / mediaSource->getMedia().getSampleRate();
     return 0.0;
 }
@@ -1,8 +1,15 @@
 #pragma once
 #include <JuceHeader.h>
+#include "CompensationDelay.h"
+#include "Meter.h"
+#include "LoudnessMeter.h"
+#include "SpectrumAnalyser.h"
+#include "MediaPool.h"
+#include "Panner.h"
+#include "SincResampler.h"
 
 class EffectsProcessor;
-class PluginHost;
+class PluginChain;
 
 class Track : public juce::AudioSource
 {
@@ -15,18 +22,83 @@ public:
     void releaseResources() override;
     void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
 
+    // getNextAudioBlock in two halves, so the first can run ahead of the
+    // playhead: the source through the chain and compensation, then gain and
+    // metering when the block is actually played
+    void renderBlock(const juce::AudioSourceChannelInfo& bufferToFill);
+    void finishBlock(const juce::AudioSourceChannelInfo& bufferToFill);
+
     // Track controls
     void loadAudioFile(const juce::File& file);
+    const juce::File& getAudioFile() const { return audioFile; }
+
+    // Conversion from the file's sample rate to the device rate
+    void setResamplingQuality(SincResampler::Quality quality);
+    SincResampler::Quality getResamplingQuality() const { return resamplingQuality; }
     void setGain(float gain);
     void setMuted(bool muted);
     void setSolo(bool solo);
     void setPosition(double positionInSeconds);
+    juce::int64 getNextReadPosition() const { return transportSource.getNextReadPosition(); }
+    void setNextReadPosition(juce::int64 position) { transportSource.setNextReadPosition(position); }
+
+    // Armed or monitoring tracks are processed in the audio callback; the
+    // rest may be rendered ahead of the playhead. Read from any thread.
+    void setRecordArmed(bool armed);
+    void setMonitoring(bool shouldMonitor);
+    bool isRecordArmed() const { return recordArmed.load(); }
+    bool isMonitoring() const { return monitoring.load(); }
+    bool isLive() const { return isRecordArmed() || isMonitoring(); }
     
+    // Precision of the effects and plugins; takes effect from the next
+    // prepareToPlay. Double runs the chain on a converted copy of the block.
+    void setProcessingPrecision(juce::AudioProcessor::ProcessingPrecision newPrecision);
+    juce::AudioProcessor::ProcessingPrecision getProcessingPrecision() const { return precision; }
+
+    // Layout of the track's audio, effects and plugins, and of the bus it is
+    // panned onto; both take effect from the next prepareToPlay. A mono
+    // track runs everything on one channel.
+    void setChannelLayout(const juce::AudioChannelSet& newLayout);
+    const juce::AudioChannelSet& getChannelLayout() const { return channelLayout; }
+    void setBusLayout(const juce::AudioChannelSet& newLayout) { busLayout = newLayout; }
+
+    // Channels the track is prepared with; blocks passed in must have this many
+    int getNumChannels() const { return numChannels; }
+
+    // Places the finished block on the bus
+    Panner& getPanner() { return panner; }
+
     // Effects and plugins
     EffectsProcessor& getEffectsProcessor() { return *effectsProcessor; }
-    PluginHost& getPluginHost() { return *pluginHost; }
+    PluginChain& getPluginChain() { return *pluginChain; }
+
+    // Freezing renders the file through the effects and plugins, offline and
+    // in the background, to the media cache and then plays that render
+    // instead of running the chain. The track is silent while rendering.
+    // onComplete is called on the message thread.
+    void freeze(std::function<void(bool success)> onComplete = nullptr);
+    void unfreeze();
+    bool isFrozen() const { return frozen.load(); }
+    bool isFreezing() const { return freezeJob != nullptr; }
+
+    // Post-fader level of this track
+    Meter& getMeter() { return meter; }
+    LoudnessMeter& getLoudnessMeter() { return loudnessMeter; }
+    SpectrumAnalyser& getSpectrumAnalyser() { return spectrumAnalyser; }
+
+    // Plugin delay compensation
+    int getLatencySamples() const;
+    bool checkAndClearLatencyChanged();
+    void setCompensationDelay(int delayInSamples);
+    int getCompensationDelay() const { return compensationDelay.getDelay(); }
+
+    // For a block the mixer leaves out (muted, or not soloed): the delay
+    // line is cleared before the track is heard again, so it doesn't replay
+    // what it held when it went quiet
+    void skipBlock() { compensationStale = true; }
     
     // Getters
+    void setName(const juce::String& name) { trackName = name; }
     const juce::String& getName() const { return trackName; }
     float getGain() const { return gain; }
     bool isMuted() const { return muted; }
@@ -34,15 +106,71 @@ public:
     double getLength() const;
 
 private:
+    class FreezeJob;
+
+    void requestPreRender();
+    void switchToRendered(std::unique_ptr<MediaPool::Source> rendered);
+    void setTransportInput(juce::PositionableAudioSource* input);
+    void prepareChain();
+    std::unique_ptr<SincResamplingSource> createResampler(MediaPool::Source& source) const;
+    void rebuildResamplers();
+
+    template <typename SampleType>
+    void processChain(juce::AudioBuffer<SampleType>& buffer);
+
+    void cancelFreeze();
+    void finishFreeze(FreezeJob* job, bool success, const juce::File& renderFile,
+                      std::function<void(bool)> onComplete);
+
     juce::String trackName;
-    std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
+    juce::File audioFile;
+
+    // transportSource plays resamplingSource (which reads mediaSource), or
+    // renderedSource once a copy at the device rate is ready
+    std::unique_ptr<MediaPool::Source> mediaSource;
+    std::unique_ptr<SincResamplingSource> resamplingSource;
+    std::unique_ptr<MediaPool::Source> renderedSource;
+    SincResampler::Quality resamplingQuality = SincResampler::Quality::standard;
+    double currentSampleRate = 0.0;
+    int currentBlockSize = 0;
     juce::AudioTransportSource transportSource;
     std::unique_ptr<EffectsProcessor> effectsProcessor;
-    std::unique_ptr<PluginHost> pluginHost;
+    std::unique_ptr<PluginChain> pluginChain;
+
+    // Held by a freeze render for as long as it uses the chain; the audio
+    // thread only tries it and outputs silence if it is taken
+    juce::SpinLock chainLock;
+
+    // While frozen, transportSource plays frozenResampler over frozenSource
+    std::unique_ptr<FreezeJob> freezeJob;
+    std::unique_ptr<MediaPool::Source> frozenSource;
+    std::unique_ptr<SincResamplingSource> frozenResampler;
+    juce::File frozenFile;
+    std::atomic<bool> frozen { false };
+    std::atomic<bool> freezeLatencyChanged { false };
     
+    juce::AudioProcessor::ProcessingPrecision precision = juce::AudioProcessor::singlePrecision;
+    juce::AudioBuffer<double> doubleBuffer;   // the block in double precision
+
+    juce::AudioChannelSet channelLayout = juce::AudioChannelSet::stereo();
+    juce::AudioChannelSet busLayout = juce::AudioChannelSet::stereo();
+    int numChannels = 2;
+    Panner panner;
+
     juce::MidiBuffer midiBuffer; // For plugin MIDI
+    CompensationDelay compensationDelay;
+    bool compensationStale = false;
+    Meter meter;
+    LoudnessMeter loudnessMeter;
+    SpectrumAnalyser spectrumAnalyser;   // idle until started
+
+    static constexpr double maxCompensationSeconds = 1.0;
     
     float gain = 1.0f;
     bool muted = false;
     bool solo = false;
+    std::atomic<bool> recordArmed { false };
+    std::atomic<bool> monitoring { false };
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(Track)
 };
@@ -0,0 +1,166 @@
+#include "TruePeakDetector.h"
+
+#if JUCE_USE_SSE_INTRINSICS
+ #include <emmintrin.h>
+#elif JUCE_USE_ARM_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace
+{
+    double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+}
+
+TruePeakDetector::TruePeakDetector()
+{
+    // Kaiser-windowed sinc with its cutoff at the input Nyquist frequency.
+    // Centring it on a tap makes phase 0 reproduce the input exactly, so the
+    // true peak can never read below the sample peak.
+    constexpr int length = tapsPerPhase * numPhases;
+    constexpr double beta = 6.0;
+    const double centre = length / 2;
+    const double windowNorm = besselI0(beta);
+
+    double prototype[length];
+
+    for (int n = 0; n < length; ++n)
+    {
+        auto t = (n - centre) / numPhases;
+        auto x = (n - centre) / centre;
+        auto sinc = std::abs(t) < 1.0e-9 ? 1.0 : std::sin(juce::MathConstants<double>::pi * t) / (juce::MathConstants<double>::pi * t);
+
+        prototype[n] = sinc * besselI0(beta * std::sqrt(juce::jmax(0.0, 1.0 - x * x))) / windowNorm;
+    }
+
+    // Split into phases; tap 0 multiplies the oldest sample in the window
+    for (int phase = 0; phase < numPhases; ++phase)
+    {
+        double sum = 0.0;
+        for (int k = 0; k < tapsPerPhase; ++k)
+            sum += prototype[k * numPhases + phase];
+
+        for (int k = 0; k < tapsPerPhase; ++k)
+            coefficients[tapsPerPhase - 1 - k][phase] = static_cast<float>(prototype[k * numPhases + phase] / sum);
+    }
+}
+
+TruePeakDetector::~TruePeakDetector()
+{
+}
+
+void TruePeakDetector::prepare(double sampleRate, const juce::AudioChannelSet& layout)
+{
+    juce::ignoreUnused(sampleRate);
+
+    numChannelsPrepared = layout.getAmbisonicOrder() >= 0 ? 1 : juce::jmax(1, layout.size());
+    history.allocate(static_cast<size_t>(numChannelsPrepared * 2 * tapsPerPhase), true);
+    reset();
+}
+
+void TruePeakDetector::reset()
+{
+    if (history != nullptr)
+        history.clear(static_cast<size_t>(numChannelsPrepared * 2 * tapsPerPhase));
+
+    historyPosition = 0;
+    truePeak = 0.0f;
+    maxTruePeak = 0.0f;
+}
+
+void TruePeakDetector::process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    if (history == nullptr || numSamples <= 0)
+        return;
+
+    auto numChannels = juce::jmin(buffer.getNumChannels(), numChannelsPrepared);
+    float blockPeak = 0.0f;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        blockPeak = juce::jmax(blockPeak, processChannel(channel, buffer.getReadPointer(channel, startSample), numSamples));
+
+    historyPosition = (historyPosition + numSamples) % tapsPerPhase;
+
+    // Only this thread raises the values; readers just reset the first one
+    if (blockPeak > truePeak.load(std::memory_order_relaxed))
+        truePeak.store(blockPeak, std::memory_order_relaxed);
+
+    if (blockPeak > maxTruePeak.load(std::memory_order_relaxed))
+        maxTruePeak.store(blockPeak, std::memory_order_relaxed);
+}
+
+float TruePeakDetector::processChannel(int channel, const float* data, int numSamples) noexcept
+{
+    auto* window = history.get() + channel * 2 * tapsPerPhase;
+    auto position = historyPosition;
+
+   #if JUCE_USE_SSE_INTRINSICS
+    const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    auto peak = _mm_setzero_ps();
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        window[position] = window[position + tapsPerPhase] = data[i];
+        position = position + 1 == tapsPerPhase ? 0 : position + 1;
+
+        // All four phases at once: one broadcast multiply-add per tap
+        const auto* w = window + position;
+        auto acc = _mm_mul_ps(_mm_set1_ps(w[0]), _mm_load_ps(coefficients[0]));
+
+        for (int tap = 1; tap < tapsPerPhase; ++tap)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[tap]), _mm_load_ps(coefficients[tap])));
+
+        peak = _mm_max_ps(peak, _mm_and_ps(acc, absMask));
+    }
+
+    alignas(16) float peaks[numPhases];
+    _mm_store_ps(peaks, peak);
+   #elif JUCE_USE_ARM_NEON
+    auto peak = vdupq_n_f32(0.0f);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        window[position] = window[position + tapsPerPhase] = data[i];
+        position = position + 1 == tapsPerPhase ? 0 : position + 1;
+
+        const auto* w = window + position;
+        auto acc = vmulq_n_f32(vld1q_f32(coefficients[0]), w[0]);
+
+        for (int tap = 1; tap < tapsPerPhase; ++tap)
+            acc = vmlaq_n_f32(acc, vld1q_f32(coefficients[tap]), w[tap]);
+
+        peak = vmaxq_f32(peak, vabsq_f32(acc));
+    }
+
+    float peaks[numPhases];
+    vst1q_f32(peaks, peak);
+   #else
+    float peaks[numPhases] {};
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        window[position] = window[position + tapsPerPhase] = data[i];
+        position = position + 1 == tapsPerPhase ? 0 : position + 1;
+
+        const auto* w = window + position;
+        float acc[numPhases] {};
+
+        for (int tap = 0; tap < tapsPerPhase; ++tap)
+            for (int phase = 0; phase < numPhases; ++phase)
+                acc[phase] += w[tap] * coefficients[tap][phase];
+
+        for (int phase = 0; phase < numPhases; ++phase)
+            peaks[phase] = juce::jmax(peaks[phase], std::abs(acc[phase]));
+    }
+   #endif
+
+    return juce::jmax(peaks[0], peaks[1], peaks[2], peaks[3]);
+}
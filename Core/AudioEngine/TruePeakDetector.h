@@ -0,0 +1,53 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+
+// BS.1770-4 (Annex 2) true-peak meter.
+//
+// Each channel is oversampled by a 48-tap polyphase low-pass (12 taps for
+// each of the four phases) and the largest magnitude of the oversampled
+// signal is kept. The coefficients are stored tap-major, four phases side by
+// side, so one input sample produces all four interpolated outputs with 12
+// vector multiply-adds.
+//
+// Every speaker channel is measured; an ambisonic layout only on its W
+// channel, since the other components are not signals that reach a speaker.
+class TruePeakDetector
+{
+public:
+    TruePeakDetector();
+    ~TruePeakDetector();
+
+    void prepare(double sampleRate, const juce::AudioChannelSet& layout);
+    void reset();
+
+    // Audio thread
+    void process(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // Linear true peak since the last call, across all channels
+    float getAndResetTruePeak() { return truePeak.exchange(0.0f, std::memory_order_relaxed); }
+
+    // Highest true peak since reset(), for delivery checks
+    float getMaxTruePeak() const { return maxTruePeak.load(std::memory_order_relaxed); }
+    float getMaxTruePeakDb() const { return juce::Decibels::gainToDecibels(getMaxTruePeak(), -100.0f); }
+
+    static constexpr int numPhases = 4;
+    static constexpr int tapsPerPhase = 12;
+
+private:
+    float processChannel(int channel, const float* data, int numSamples) noexcept;
+
+    // coefficients[tap][phase], tap 0 being the oldest input sample
+    alignas(16) float coefficients[tapsPerPhase][numPhases] {};
+
+    // Per channel: the last tapsPerPhase inputs, written twice so the
+    // window is always contiguous
+    juce::HeapBlock<float> history;
+    int numChannelsPrepared = 0;
+    int historyPosition = 0;
+
+    std::atomic<float> truePeak { 0.0f };
+    std::atomic<float> maxTruePeak { 0.0f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TruePeakDetector)
+};
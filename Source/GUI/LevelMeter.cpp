@@ -0,0 +1,127 @@
+#include "LevelMeter.h"
+#include "OpenGLRenderLayer.h"
+
+LevelMeter::LevelMeter(Meter& meterToShow)
+    : reader(meterToShow)
+{
+    setSize(24, 200);
+    RefreshScheduler::getInstance().addClient(this);
+}
+
+LevelMeter::~LevelMeter()
+{
+    RefreshScheduler::getInstance().removeClient(this);
+
+   #if SIGNALFORGE_OPENGL
+    if (auto* layer = OpenGLRenderLayer::findFor(*this))
+        layer->removeClient(*this);
+   #endif
+}
+
+float LevelMeter::levelToProportion(float gain) const
+{
+    auto db = juce::Decibels::gainToDecibels(gain, minimumDb);
+    return juce::jlimit(0.0f, 1.0f, (db - minimumDb) / (maximumDb - minimumDb));
+}
+
+juce::Rectangle<float> LevelMeter::getBarArea(int channel, float proportion) const
+{
+    auto area = getLocalBounds().toFloat().reduced(2.0f);
+    auto barWidth = area.getWidth() / numChannels;
+    auto bar = area.withX(area.getX() + barWidth * channel).withWidth(barWidth - 1.0f);
+
+    return bar.withTop(bar.getBottom() - bar.getHeight() * proportion);
+}
+
+juce::Rectangle<float> LevelMeter::getHoldArea(int channel, float proportion) const
+{
+    auto bar = getBarArea(channel, proportion);
+    return bar.withHeight(2.0f).translated(0.0f, -1.0f);
+}
+
+void LevelMeter::paint(juce::Graphics& g)
+{
+    auto background = juce::Colour(0xff1d1d1d);
+    auto rmsColour = juce::Colour(0xff007cba);
+    auto peakColour = juce::Colours::lightblue;
+    auto holdColour = juce::Colours::white;
+
+   #if SIGNALFORGE_OPENGL
+    if (auto* layer = OpenGLRenderLayer::findFor(*this))
+    {
+        OpenGLRenderLayer::Geometry geometry;
+        OpenGLRenderLayer::addRectangle(geometry, getLocalBounds().toFloat(), background);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            OpenGLRenderLayer::addRectangle(geometry, getBarArea(channel, levelToProportion(peakLevels[channel])), peakColour);
+            OpenGLRenderLayer::addRectangle(geometry, getBarArea(channel, levelToProportion(rmsLevels[channel])), rmsColour);
+
+            if (holdLevels[channel] > 0.0f)
+                OpenGLRenderLayer::addRectangle(geometry, getHoldArea(channel, levelToProportion(holdLevels[channel])), holdColour);
+        }
+
+        layer->setGeometry(*this, std::move(geometry));
+        return;
+    }
+   #endif
+
+    g.fillAll(background);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        g.setColour(peakColour);
+        g.fillRect(getBarArea(channel, levelToProportion(peakLevels[channel])));
+        g.setColour(rmsColour);
+        g.fillRect(getBarArea(channel, levelToProportion(rmsLevels[channel])));
+
+        if (holdLevels[channel] > 0.0f)
+        {
+            g.setColour(holdColour);
+            g.fillRect(getHoldArea(channel, levelToProportion(holdLevels[channel])));
+        }
+    }
+}
+
+void LevelMeter::refreshFrame(double secondsSinceLastFrame)
+{
+    reader.update(secondsSinceLastFrame);
+
+    // Bars fall back at the meter's release rate so short transients stay visible
+    auto peakDecay = juce::Decibels::decibelsToGain(-Meter::Reader::releaseDbPerSecond
+                                                    * static_cast<float>(secondsSinceLastFrame));
+    juce::Rectangle<float> dirtyArea;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto peak = juce::jmax(reader.getPeak(channel), peakLevels[channel] * peakDecay);
+        auto rms = reader.getRMS(channel);
+        auto hold = reader.getPeakHold(channel);
+
+        auto oldTops = { levelToProportion(peakLevels[channel]), levelToProportion(rmsLevels[channel]),
+                         levelToProportion(holdLevels[channel]) };
+        auto newTops = { levelToProportion(peak), levelToProportion(rms), levelToProportion(hold) };
+
+        peakLevels[channel] = peak;
+        rmsLevels[channel] = rms;
+        holdLevels[channel] = hold;
+
+        bool moved = false;
+        for (auto oldIt = oldTops.begin(), newIt = newTops.begin(); oldIt != oldTops.end(); ++oldIt, ++newIt)
+            moved = moved || std::abs(*newIt - *oldIt) > 0.002f;
+
+        // Only the span between the lowest and highest of the old and new
+        // tops needs redrawing
+        if (moved)
+        {
+            auto lowest = juce::jmin(std::min(oldTops), std::min(newTops));
+            auto highest = juce::jmax(std::max(oldTops), std::max(newTops));
+            auto channelArea = getHoldArea(channel, highest).getUnion(getBarArea(channel, highest));
+
+            dirtyArea = dirtyArea.getUnion(channelArea.withBottom(getBarArea(channel, lowest).getY() + 1.0f));
+        }
+    }
+
+    if (!dirtyArea.isEmpty())
+        repaint(dirtyArea.getSmallestIntegerContainer().expanded(1));
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <JuceHeader.h>
+#include "AudioEngine/Meter.h"
+#include "RefreshScheduler.h"
+
+// Vertical peak/RMS bars with a peak-hold line for one engine Meter. The
+// meter's frame ring is read once per display frame and only the bars that
+// moved are repainted.
+class LevelMeter : public juce::Component,
+                   private RefreshScheduler::Client
+{
+public:
+    explicit LevelMeter(Meter& meterToShow);
+    ~LevelMeter() override;
+
+    void paint(juce::Graphics& g) override;
+
+private:
+    void refreshFrame(double secondsSinceLastFrame) override;
+
+    static constexpr int numChannels = 2;
+    static constexpr float minimumDb = -60.0f;
+    static constexpr float maximumDb = 6.0f;
+
+    float levelToProportion(float gain) const;
+    juce::Rectangle<float> getBarArea(int channel, float proportion) const;
+    juce::Rectangle<float> getHoldArea(int channel, float proportion) const;
+
+    Meter::Reader reader;
+    std::array<float, numChannels> peakLevels {};
+    std::array<float, numChannels> rmsLevels {};
+    std::array<float, numChannels> holdLevels {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LevelMeter)
+};
@@ -0,0 +1,298 @@
+#include "OpenGLRenderLayer.h"
+
+#if SIGNALFORGE_OPENGL
+
+using namespace juce::gl;
+
+namespace
+{
+    // Attached layers (message thread only)
+    juce::Array<OpenGLRenderLayer*>& getAttachedLayers()
+    {
+        static juce::Array<OpenGLRenderLayer*> layers;
+        return layers;
+    }
+
+    const char* vertexShaderSource = R"(
+        attribute vec2 position;
+        attribute vec4 colour;
+        uniform vec2 viewSize;
+        uniform vec2 origin;
+        varying vec4 fragmentColour;
+
+        void main()
+        {
+            vec2 target = position + origin;
+            fragmentColour = colour;
+            gl_Position = vec4(target.x * 2.0 / viewSize.x - 1.0,
+                               1.0 - target.y * 2.0 / viewSize.y,
+                               0.0, 1.0);
+        }
+    )";
+
+    const char* fragmentShaderSource = R"(
+        varying JUCE_MEDIUMP vec4 fragmentColour;
+
+        void main()
+        {
+            gl_FragColor = fragmentColour;
+        }
+    )";
+}
+
+OpenGLRenderLayer::OpenGLRenderLayer()
+{
+    context.setRenderer(this);
+    context.setComponentPaintingEnabled(true);
+    context.setContinuousRepainting(false);
+}
+
+OpenGLRenderLayer::~OpenGLRenderLayer()
+{
+    detach();
+}
+
+void OpenGLRenderLayer::attachTo(juce::Component& target)
+{
+    detach();
+
+    targetComponent = &target;
+    context.attachTo(target);
+    getAttachedLayers().add(this);
+}
+
+void OpenGLRenderLayer::detach()
+{
+    if (targetComponent == nullptr)
+        return;
+
+    getAttachedLayers().removeFirstMatchingValue(this);
+    context.detach();
+    targetComponent = nullptr;
+
+    const juce::ScopedLock sl(clientLock);
+    clients.clear();
+}
+
+OpenGLRenderLayer* OpenGLRenderLayer::findFor(const juce::Component& component)
+{
+    for (auto* layer : getAttachedLayers())
+        if (layer->targetComponent == &component || layer->targetComponent->isParentOf(&component))
+            return layer;
+
+    return nullptr;
+}
+
+void OpenGLRenderLayer::setGeometry(const juce::Component& client, Geometry&& vertices, int part)
+{
+    if (targetComponent == nullptr)
+        return;
+
+    auto bounds = targetComponent->getLocalArea(&client, client.getLocalBounds());
+    juce::Rectangle<int> previousBounds;
+
+    {
+        const juce::ScopedLock sl(clientLock);
+
+        auto& entry = clients[{ &client, part }];
+        previousBounds = entry.bounds;
+        entry.vertices = std::move(vertices);
+        entry.changed = true;
+
+        // A move only changes the origin uniform, for every part
+        for (auto it = clients.lower_bound({ &client, std::numeric_limits<int>::min() });
+             it != clients.end() && it->first.first == &client; ++it)
+        {
+            it->second.bounds = bounds;
+            it->second.origin = bounds.getPosition().toFloat();
+        }
+
+        viewBounds = targetComponent->getLocalBounds();
+    }
+
+    // Ancestors have to repaint around the client's new position
+    if (previousBounds != bounds)
+        targetComponent->repaint(previousBounds.getUnion(bounds));
+
+    context.triggerRepaint();
+}
+
+bool OpenGLRenderLayer::hasGeometry(const juce::Component& client, int part) const
+{
+    const juce::ScopedLock sl(clientLock);
+    return clients.find({ &client, part }) != clients.end();
+}
+
+void OpenGLRenderLayer::removeClient(const juce::Component& client)
+{
+    juce::Rectangle<int> bounds;
+
+    {
+        const juce::ScopedLock sl(clientLock);
+
+        auto it = clients.lower_bound({ &client, std::numeric_limits<int>::min() });
+        if (it == clients.end() || it->first.first != &client)
+            return;
+
+        bounds = it->second.bounds;
+
+        while (it != clients.end() && it->first.first == &client)
+        {
+            if (it->second.buffer != 0)
+                buffersToDelete.push_back(it->second.buffer);
+
+            it = clients.erase(it);
+        }
+    }
+
+    if (targetComponent != nullptr)
+    {
+        targetComponent->repaint(bounds);
+        context.triggerRepaint();
+    }
+}
+
+void OpenGLRenderLayer::excludeClientAreas(juce::Graphics& g, const juce::Component& painter) const
+{
+    if (targetComponent == nullptr)
+        return;
+
+    const juce::ScopedLock sl(clientLock);
+
+    for (const auto& [key, entry] : clients)
+        if (painter.isParentOf(key.first))
+            g.excludeClipRegion(painter.getLocalArea(targetComponent, entry.bounds));
+}
+
+void OpenGLRenderLayer::addRectangle(Geometry& geometry, juce::Rectangle<float> area, juce::Colour colour)
+{
+    auto r = colour.getFloatRed();
+    auto g = colour.getFloatGreen();
+    auto b = colour.getFloatBlue();
+    auto a = colour.getFloatAlpha();
+
+    auto left = area.getX(), right = area.getRight();
+    auto top = area.getY(), bottom = area.getBottom();
+
+    geometry.push_back({ left,  top,    r, g, b, a });
+    geometry.push_back({ right, top,    r, g, b, a });
+    geometry.push_back({ left,  bottom, r, g, b, a });
+    geometry.push_back({ right, top,    r, g, b, a });
+    geometry.push_back({ right, bottom, r, g, b, a });
+    geometry.push_back({ left,  bottom, r, g, b, a });
+}
+
+void OpenGLRenderLayer::newOpenGLContextCreated()
+{
+    shader = std::make_unique<juce::OpenGLShaderProgram>(context);
+
+    if (!shader->addVertexShader(juce::OpenGLHelpers::translateVertexShaderToV3(vertexShaderSource))
+        || !shader->addFragmentShader(juce::OpenGLHelpers::translateFragmentShaderToV3(fragmentShaderSource))
+        || !shader->link())
+    {
+        juce::Logger::writeToLog("OpenGLRenderLayer: shader failed to compile: " + shader->getLastError());
+        shader.reset();
+        return;
+    }
+
+    // Everything is uploaded afresh into the new context
+    const juce::ScopedLock sl(clientLock);
+    buffersToDelete.clear();
+
+    for (auto& [key, entry] : clients)
+    {
+        entry.buffer = 0;
+        entry.numVertices = 0;
+        entry.changed = true;
+    }
+}
+
+void OpenGLRenderLayer::renderOpenGL()
+{
+    juce::OpenGLHelpers::clear(juce::Colours::black);
+
+    if (shader == nullptr)
+        return;
+
+    const juce::ScopedLock sl(clientLock);
+
+    if (!buffersToDelete.empty())
+    {
+        glDeleteBuffers(static_cast<GLsizei>(buffersToDelete.size()), buffersToDelete.data());
+        buffersToDelete.clear();
+    }
+
+    if (viewBounds.isEmpty())
+        return;
+
+    auto scale = context.getRenderingScale();
+    glViewport(0, 0, juce::roundToInt(scale * viewBounds.getWidth()), juce::roundToInt(scale * viewBounds.getHeight()));
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    shader->use();
+    shader->setUniform("viewSize", static_cast<GLfloat>(viewBounds.getWidth()), static_cast<GLfloat>(viewBounds.getHeight()));
+
+    auto programID = shader->getProgramID();
+    auto position = static_cast<GLuint>(glGetAttribLocation(programID, "position"));
+    auto colour = static_cast<GLuint>(glGetAttribLocation(programID, "colour"));
+    glEnableVertexAttribArray(position);
+    glEnableVertexAttribArray(colour);
+
+    for (auto& [key, entry] : clients)
+    {
+        // Only parts set since the last frame go to the GPU
+        if (entry.changed)
+        {
+            if (entry.buffer == 0)
+                glGenBuffers(1, &entry.buffer);
+
+            glBindBuffer(GL_ARRAY_BUFFER, entry.buffer);
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(entry.vertices.size() * sizeof(Vertex)),
+                         entry.vertices.data(), GL_DYNAMIC_DRAW);
+
+            entry.numVertices = static_cast<int>(entry.vertices.size());
+            entry.changed = false;
+        }
+
+        if (entry.numVertices == 0)
+            continue;
+
+        shader->setUniform("origin", entry.origin.x, entry.origin.y);
+
+        glBindBuffer(GL_ARRAY_BUFFER, entry.buffer);
+        glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), nullptr);
+        glVertexAttribPointer(colour, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                              reinterpret_cast<const void*>(offsetof(Vertex, r)));
+        glDrawArrays(GL_TRIANGLES, 0, entry.numVertices);
+    }
+
+    glDisableVertexAttribArray(position);
+    glDisableVertexAttribArray(colour);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OpenGLRenderLayer::openGLContextClosing()
+{
+    shader.reset();
+
+    const juce::ScopedLock sl(clientLock);
+
+    for (auto& [key, entry] : clients)
+    {
+        if (entry.buffer != 0)
+            glDeleteBuffers(1, &entry.buffer);
+
+        entry.buffer = 0;
+        entry.numVertices = 0;
+        entry.changed = true;
+    }
+
+    if (!buffersToDelete.empty())
+        glDeleteBuffers(static_cast<GLsizei>(buffersToDelete.size()), buffersToDelete.data());
+
+    buffersToDelete.clear();
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+#include <JuceHeader.h>
+
+#if SIGNALFORGE_OPENGL
+
+// GPU path for the parts of the window that redraw every frame.
+//
+// Attaching the layer puts an OpenGLContext behind the target component, so
+// ordinary painting is rasterised on the GPU as well. Waveforms and meters go
+// further: each client hands over its geometry as coloured triangles, in one
+// or more parts. Every part keeps its own vertex buffer, uploaded only when
+// that part changes, and is drawn at the client's position through a uniform,
+// so a frame in which only a playhead moves uploads six vertices.
+//
+// The context draws this geometry underneath the painted components, so any
+// ancestor that fills its background must leave the clients' areas alone
+// (see excludeClientAreas).
+class OpenGLRenderLayer : private juce::OpenGLRenderer
+{
+public:
+    struct Vertex
+    {
+        float x, y;         // logical pixels, relative to the target component
+        float r, g, b, a;
+    };
+
+    using Geometry = std::vector<Vertex>;
+
+    OpenGLRenderLayer();
+    ~OpenGLRenderLayer() override;
+
+    void attachTo(juce::Component& target);
+    void detach();
+
+    // The layer attached to the window containing this component, if any
+    static OpenGLRenderLayer* findFor(const juce::Component& component);
+
+    // Message thread. Replaces one part of the client's geometry, given in
+    // its own coordinates, and schedules a GPU frame. Parts are drawn in
+    // order, so later ones go on top; geometry that rarely changes belongs
+    // in a part of its own.
+    void setGeometry(const juce::Component& client, Geometry&& vertices, int part = 0);
+    bool hasGeometry(const juce::Component& client, int part = 0) const;
+    void removeClient(const juce::Component& client);
+
+    // Clips the clients' areas out of a painter's Graphics context
+    void excludeClientAreas(juce::Graphics& g, const juce::Component& painter) const;
+
+    static void addRectangle(Geometry& geometry, juce::Rectangle<float> area, juce::Colour colour);
+
+private:
+    using ClientKey = std::pair<const juce::Component*, int>;   // client, part
+
+    struct Client
+    {
+        juce::Rectangle<int> bounds;   // in target coordinates
+        juce::Point<float> origin;
+        Geometry vertices;
+        bool changed = true;           // not uploaded since it was set
+
+        // GL thread
+        GLuint buffer = 0;
+        int numVertices = 0;
+    };
+
+    void newOpenGLContextCreated() override;
+    void renderOpenGL() override;
+    void openGLContextClosing() override;
+
+    juce::OpenGLContext context;
+    juce::Component* targetComponent = nullptr;
+
+    // Written on the message thread, read by the GL thread, which also
+    // uploads under the lock (only what changed)
+    juce::CriticalSection clientLock;
+    std::map<ClientKey, Client> clients;
+    std::vector<GLuint> buffersToDelete;   // of removed clients
+    juce::Rectangle<int> viewBounds;
+
+    // GL thread only
+    std::unique_ptr<juce::OpenGLShaderProgram> shader;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OpenGLRenderLayer)
+};
+
+#endif
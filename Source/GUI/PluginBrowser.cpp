@@ -1,5 +1,5 @@
 #include "PluginBrowser.h"
-#include "AudioEngine/PluginHost.h"
+#include "AudioEngine/PluginScanner.h"
 
 PluginBrowser::PluginBrowser()
 {
@@ -10,12 +10,12 @@ PluginBrowser::PluginBrowser()
     scanButton.setButtonText("Scan Plugins");
     addAndMakeVisible(scanButton);
     scanButton.onClick = [this]() {
-        if (pluginHost)
+        if (pluginScanner && !pluginScanner->isScanning())
         {
+            // Runs in worker processes; the list refreshes when it finishes
             statusLabel.setText("Scanning plugins...", juce::dontSendNotification);
-            pluginHost->scanForPlugins();
-            refreshPluginList();
-            statusLabel.setText("Scan complete", juce::dontSendNotification);
+            scanButton.setEnabled(false);
+            pluginScanner->startScan();
         }
     };
 
@@ -37,6 +37,8 @@ PluginBrowser::PluginBrowser()
 
 PluginBrowser::~PluginBrowser()
 {
+    if (pluginScanner)
+        pluginScanner->onScanFinished = nullptr;
 }
 
 void PluginBrowser::paint(juce::Graphics& g)
@@ -94,9 +96,21 @@ void PluginBrowser::listBoxItemDoubleClicked(int row, const juce::MouseEvent& e)
     }
 }
 
-void PluginBrowser::setPluginHost(PluginHost* host)
+void PluginBrowser::setPluginScanner(PluginScanner* scanner)
 {
-    pluginHost = host;
+    if (pluginScanner)
+        pluginScanner->onScanFinished = nullptr;
+
+    pluginScanner = scanner;
+
+    if (pluginScanner)
+    {
+        pluginScanner->onScanFinished = [this]() {
+            scanButton.setEnabled(true);
+            refreshPluginList();
+        };
+    }
+
     refreshPluginList();
 }
 
@@ -105,9 +119,9 @@ void PluginBrowser::refreshPluginList()
     availablePlugins.clear();
     selectedPluginIndex = -1;
     
-    if (pluginHost)
+    if (pluginScanner)
     {
-        const auto& pluginList = pluginHost->getPluginList();
+        const auto& pluginList = pluginScanner->getKnownPluginList();
         for (const auto& type : pluginList.getTypes())
         {
             availablePlugins.add(type);
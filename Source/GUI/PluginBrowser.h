@@ -1,7 +1,7 @@
 #pragma once
 #include <JuceHeader.h>
 
-class PluginHost;
+class PluginScanner;
 
 class PluginBrowser : public juce::Component,
                       public juce::ListBoxModel
@@ -18,14 +18,14 @@ public:
     void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
     void listBoxItemDoubleClicked(int row, const juce::MouseEvent& e) override;
 
-    void setPluginHost(PluginHost* host);
+    void setPluginScanner(PluginScanner* scanner);
     void refreshPluginList();
 
     // Callbacks
     std::function<void(const juce::PluginDescription&)> onPluginSelected;
 
 private:
-    PluginHost* pluginHost = nullptr;
+    PluginScanner* pluginScanner = nullptr;
     juce::ListBox pluginListBox;
     juce::TextButton scanButton;
     juce::TextButton loadButton;
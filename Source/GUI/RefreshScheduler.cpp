@@ -0,0 +1,49 @@
+#include "RefreshScheduler.h"
+
+RefreshScheduler& RefreshScheduler::getInstance()
+{
+    static RefreshScheduler instance;
+    return instance;
+}
+
+RefreshScheduler::RefreshScheduler()
+{
+}
+
+RefreshScheduler::~RefreshScheduler()
+{
+}
+
+void RefreshScheduler::attachTo(juce::Component& component)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    lastFrameTime = 0.0;
+    vBlankAttachment = std::make_unique<juce::VBlankAttachment>(&component, [this] { onVBlank(); });
+}
+
+void RefreshScheduler::detach()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    vBlankAttachment = nullptr;
+}
+
+void RefreshScheduler::addClient(Client* client)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    clients.add(client);
+}
+
+void RefreshScheduler::removeClient(Client* client)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    clients.remove(client);
+}
+
+void RefreshScheduler::onVBlank()
+{
+    auto now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+    auto elapsed = lastFrameTime > 0.0 ? now - lastFrameTime : 0.0;
+    lastFrameTime = now;
+
+    clients.call([elapsed](Client& client) { client.refreshFrame(elapsed); });
+}
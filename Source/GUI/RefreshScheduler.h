@@ -0,0 +1,42 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Drives every periodic GUI update from the display's vertical blank.
+//
+// Components that show engine state (meters, playhead, clock) register as
+// clients instead of running their own timers. Once per frame each client
+// polls what it displays and repaints only the parts that changed, so an
+// idle window does no painting at all.
+class RefreshScheduler
+{
+public:
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        // Message thread, once per displayed frame
+        virtual void refreshFrame(double secondsSinceLastFrame) = 0;
+    };
+
+    static RefreshScheduler& getInstance();
+
+    // Frames are paced by the display showing this component
+    void attachTo(juce::Component& component);
+    void detach();
+
+    void addClient(Client* client);
+    void removeClient(Client* client);
+
+private:
+    RefreshScheduler();
+    ~RefreshScheduler();
+
+    void onVBlank();
+
+    std::unique_ptr<juce::VBlankAttachment> vBlankAttachment;
+    juce::ListenerList<Client> clients;
+    double lastFrameTime = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RefreshScheduler)
+};
@@ -41,14 +41,10 @@ SignalForgeDAW::SignalForgeDAW()
     // Set window properties
     setSize(1400, 900);
     setWantsKeyboardFocus(true);
-    
-    // Start timer for UI updates
-    startTimer(50); // 20 FPS
 }
 
 SignalForgeDAW::~SignalForgeDAW()
 {
-    stopTimer();
 }
 
 void SignalForgeDAW::paint(juce::Graphics& g)
@@ -99,9 +95,3 @@ void SignalForgeDAW::resized()
     verticalDivider->setBounds(leftPanel.getRight() - 2, leftPanel.getY(), 4, leftPanel.getHeight());
     horizontalDivider->setBounds(area.getRight() - 2, area.getY(), 4, area.getHeight());
 }
-
-void SignalForgeDAW::timerCallback()
-{
-    // Update UI elements that need regular refresh
-    repaint();
-}
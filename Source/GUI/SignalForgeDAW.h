@@ -9,8 +9,7 @@ class MixerPanelComponent;
 class BrowserPanelComponent;
 class StatusBarComponent;
 
-class SignalForgeDAW : public juce::Component,
-                       public juce::Timer
+class SignalForgeDAW : public juce::Component
 {
 public:
     SignalForgeDAW();
@@ -18,7 +17,6 @@ public:
 
     void paint(juce::Graphics& g) override;
     void resized() override;
-    void timerCallback() override;
 
 private:
     // Main layout areas
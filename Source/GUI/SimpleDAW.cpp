@@ -1,6 +1,7 @@
 #include "SimpleDAW.h"
 #include "../Utils/SignalForgeIcon.h"
 #include "../../Core/API/Base44Client.h"
+#include "OpenGLRenderLayer.h"
 
 SimpleDAW::SimpleDAW() : isPlaying(false)
 {
@@ -116,7 +117,6 @@ SimpleDAW::SimpleDAW() : isPlaying(false)
     addAndMakeVisible(*statusLabel);
     
     setSize(800, 600);
-    startTimer(100);
     
     // Set application icon
     SignalForgeIcon::setApplicationIcon();
@@ -124,12 +124,15 @@ SimpleDAW::SimpleDAW() : isPlaying(false)
 
 SimpleDAW::~SimpleDAW()
 {
-    stopTimer();
 }
 
 void SimpleDAW::paint(juce::Graphics& g)
 {
-    // Professional dark background
+    // Professional dark background, leaving GPU-drawn children uncovered
+   #if SIGNALFORGE_OPENGL
+    if (auto* layer = OpenGLRenderLayer::findFor(*this))
+        layer->excludeClientAreas(g, *this);
+   #endif
     g.fillAll(juce::Colour(0xff2d2d2d));
     
     // Draw subtle grid pattern
@@ -200,9 +203,3 @@ void SimpleDAW::resized()
     // Status at bottom
     statusLabel->setBounds(area.removeFromBottom(30));
 }
-
-void SimpleDAW::timerCallback()
-{
-    // Update any real-time displays
-    repaint();
-}
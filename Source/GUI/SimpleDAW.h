@@ -3,8 +3,7 @@
 
 class Base44Client;
 
-class SimpleDAW : public juce::Component,
-                  public juce::Timer
+class SimpleDAW : public juce::Component
 {
 public:
     SimpleDAW();
@@ -12,7 +11,6 @@ public:
 
     void paint(juce::Graphics& g) override;
     void resized() override;
-    void timerCallback() override;
 
 private:
     // Simple UI elements
@@ -48,6 +48,7 @@ TransportBarComponent::TransportBarComponent()
     tempoSlider->setRange(60.0, 200.0, 0.1);
     tempoSlider->setValue(120.0);
     tempoSlider->setColour(juce::Slider::thumbColourId, juce::Colour(0xff007cba));
+    tempoSlider->onValueChange = [this] { bpm = tempoSlider->getValue(); };
     
     tempoDisplay = std::make_unique<juce::Label>("tempo", "BPM");
     tempoDisplay->setColour(juce::Label::textColourId, juce::Colours::white);
@@ -98,13 +99,13 @@ TransportBarComponent::TransportBarComponent()
     addAndMakeVisible(*aiMixingButton);
     addAndMakeVisible(*aiMasteringButton);
     
-    // Start timer for time updates
-    startTimer(100); // 10 FPS
+    // The clock advances once per display frame
+    RefreshScheduler::getInstance().addClient(this);
 }
 
 TransportBarComponent::~TransportBarComponent()
 {
-    stopTimer();
+    RefreshScheduler::getInstance().removeClient(this);
 }
 
 void TransportBarComponent::paint(juce::Graphics& g)
@@ -175,6 +176,7 @@ void TransportBarComponent::buttonClicked(juce::Button* button)
         isPlaying = false;
         isRecording = false;
         currentTime = 0.0;
+        updateTimeDisplay();
         playButton->setButtonText("▶️");
         playButton->setToggleState(false, juce::dontSendNotification);
         recordButton->setToggleState(false, juce::dontSendNotification);
@@ -214,21 +216,22 @@ void TransportBarComponent::buttonClicked(juce::Button* button)
     }
 }
 
-void TransportBarComponent::timerCallback()
+void TransportBarComponent::refreshFrame(double secondsSinceLastFrame)
 {
     if (isPlaying)
     {
-        currentTime += 0.1; // Increment by 100ms
-        
-        // Update time display
-        int minutes = (int)(currentTime / 60.0);
-        int seconds = (int)currentTime % 60;
-        int milliseconds = (int)((currentTime - (int)currentTime) * 1000);
-        
-        juce::String timeString = juce::String::formatted("%02d:%02d:%03d", minutes, seconds, milliseconds);
-        timeDisplay->setText(timeString, juce::dontSendNotification);
+        currentTime += secondsSinceLastFrame;
+        updateTimeDisplay();
     }
+}
+
+void TransportBarComponent::updateTimeDisplay()
+{
+    int minutes = (int)(currentTime / 60.0);
+    int seconds = (int)currentTime % 60;
+    int milliseconds = (int)((currentTime - (int)currentTime) * 1000);
     
-    // Update BPM from slider
-    bpm = tempoSlider->getValue();
+    // Label::setText only repaints the label, and only if the text differs
+    juce::String timeString = juce::String::formatted("%02d:%02d:%03d", minutes, seconds, milliseconds);
+    timeDisplay->setText(timeString, juce::dontSendNotification);
 }
@@ -1,9 +1,10 @@
 #pragma once
 #include <JuceHeader.h>
+#include "RefreshScheduler.h"
 
 class TransportBarComponent : public juce::Component,
                              public juce::Button::Listener,
-                             public juce::Timer
+                             private RefreshScheduler::Client
 {
 public:
     TransportBarComponent();
@@ -12,9 +13,11 @@ public:
     void paint(juce::Graphics& g) override;
     void resized() override;
     void buttonClicked(juce::Button* button) override;
-    void timerCallback() override;
 
 private:
+    void refreshFrame(double secondsSinceLastFrame) override;
+    void updateTimeDisplay();
+
     // Transport buttons
     std::unique_ptr<juce::TextButton> playButton;
     std::unique_ptr<juce::TextButton> stopButton;
@@ -1,69 +1,186 @@
 #include "WaveformDisplay.h"
+#include "OpenGLRenderLayer.h"
 
 WaveformDisplay::WaveformDisplay() 
-    : thumbnailCache(5),
-      thumbnail(512, formatManager, thumbnailCache)
 {
-    formatManager.registerBasicFormats();
-    thumbnail.addChangeListener(this);
     setSize(400, 100);
 }
 
 WaveformDisplay::~WaveformDisplay()
 {
-    thumbnail.removeChangeListener(this);
+   #if SIGNALFORGE_OPENGL
+    if (auto* layer = OpenGLRenderLayer::findFor(*this))
+        layer->removeClient(*this);
+   #endif
 }
 
 void WaveformDisplay::paint(juce::Graphics& g)
 {
-    g.fillAll(juce::Colours::black);
-    g.setColour(juce::Colours::white);
-    g.drawRect(getLocalBounds(), 1);
+    auto hasPeaks = fileLoaded && peaks != nullptr && peaks->getLengthInSamples() > 0;
+
+   #if SIGNALFORGE_OPENGL
+    // With the GPU layer the waveform body goes out as vertices; only the
+    // border and captions are painted. A repaint for the playhead alone
+    // sends just its six vertices.
+    if (auto* layer = OpenGLRenderLayer::findFor(*this))
+    {
+        if (!waveformGeometryValid || !layer->hasGeometry(*this, waveformPart))
+        {
+            OpenGLRenderLayer::Geometry geometry;
+            OpenGLRenderLayer::addRectangle(geometry, getLocalBounds().toFloat(), juce::Colours::black);
+
+            if (hasPeaks)
+            {
+                addPeakColumns([&geometry](int x, float top, float bottom, juce::Colour colour)
+                {
+                    OpenGLRenderLayer::addRectangle(geometry, { static_cast<float>(x), top, 1.0f, bottom - top }, colour);
+                });
+            }
 
-    if (fileLoaded)
+            layer->setGeometry(*this, std::move(geometry), waveformPart);
+            waveformGeometryValid = true;
+        }
+
+        setPlayheadGeometry(*layer, hasPeaks);
+    }
+    else
+   #endif
     {
-        g.setColour(juce::Colours::lightblue);
-        thumbnail.drawChannels(g, getLocalBounds().reduced(2), 0.0, thumbnail.getTotalLength(), 1.0f);
-        
-        // Draw playhead
-        if (thumbnail.getTotalLength() > 0.0)
+        g.fillAll(juce::Colours::black);
+
+        if (hasPeaks)
         {
+            addPeakColumns([&g](int x, float top, float bottom, juce::Colour colour)
+            {
+                g.setColour(colour);
+                g.drawVerticalLine(x, top, bottom);
+            });
+
+            // Draw playhead
             auto playheadX = static_cast<float>(currentPosition * getWidth());
             g.setColour(juce::Colours::red);
             g.drawVerticalLine(static_cast<int>(playheadX), 0.0f, static_cast<float>(getHeight()));
         }
     }
-    else
+
+    g.setColour(juce::Colours::white);
+    g.drawRect(getLocalBounds(), 1);
+
+    if (!hasPeaks)
     {
         g.setColour(juce::Colours::grey);
         g.setFont(14.0f);
-        g.drawText("No audio file loaded", getLocalBounds(), juce::Justification::centred);
+        g.drawText(fileLoaded ? "Building waveform..." : "No audio file loaded",
+                   getLocalBounds(), juce::Justification::centred);
+    }
+}
+
+#if SIGNALFORGE_OPENGL
+void WaveformDisplay::setPlayheadGeometry(OpenGLRenderLayer& layer, bool hasPeaks)
+{
+    OpenGLRenderLayer::Geometry playhead;
+
+    if (hasPeaks)
+        OpenGLRenderLayer::addRectangle(playhead, { static_cast<float>(currentPosition * getWidth()), 0.0f,
+                                                    1.0f, static_cast<float>(getHeight()) },
+                                        juce::Colours::red);
+
+    layer.setGeometry(*this, std::move(playhead), playheadPart);
+}
+#endif
+
+void WaveformDisplay::addPeakColumns(const std::function<void(int, float, float, juce::Colour)>& addColumn)
+{
+    auto area = getLocalBounds().reduced(2);
+    auto numColumns = area.getWidth();
+    auto sampleRate = peaks->getSampleRate();
+
+    auto range = visibleRange.isEmpty()
+                     ? juce::Range<double>(0.0, static_cast<double>(peaks->getLengthInSamples()) / sampleRate)
+                     : visibleRange;
+    auto startSample = static_cast<juce::int64>(range.getStart() * sampleRate);
+    auto endSample = static_cast<juce::int64>(range.getEnd() * sampleRate);
+
+    columnPeaks.resize(static_cast<size_t>(juce::jmax(0, numColumns)));
+    auto laneHeight = static_cast<float>(area.getHeight()) / static_cast<float>(peaks->getNumChannels());
+
+    for (int channel = 0; channel < peaks->getNumChannels(); ++channel)
+    {
+        peaks->getPeaks(channel, startSample, endSample, columnPeaks.data(), numColumns);
+
+        auto centre = static_cast<float>(area.getY()) + laneHeight * (static_cast<float>(channel) + 0.5f);
+        auto scale = laneHeight * 0.5f;
+
+        for (int column = 0; column < numColumns; ++column)
+        {
+            const auto& peak = columnPeaks[static_cast<size_t>(column)];
+            auto x = area.getX() + column;
+
+            addColumn(x, centre - peak.max * scale, centre - peak.min * scale + 1.0f, juce::Colours::lightblue);
+            addColumn(x, centre - peak.rms * scale, centre + peak.rms * scale + 1.0f, juce::Colours::steelblue);
+        }
     }
 }
 
 void WaveformDisplay::resized()
 {
-    // Component resized
+    waveformGeometryValid = false;
 }
 
 void WaveformDisplay::loadAudioFile(const juce::File& file)
 {
-    thumbnail.setSource(new juce::FileInputSource(file));
+    currentFile = file;
+    peaks.reset();
     fileLoaded = true;
+    waveformGeometryValid = false;
     repaint();
+
+    // Opens the existing peak file straight away, or builds it in the background
+    juce::Component::SafePointer<WaveformDisplay> safeThis(this);
+    PeakCache::getInstance().getPeaksAsync(file, [safeThis, file](std::shared_ptr<PeakFile> loadedPeaks)
+    {
+        if (safeThis != nullptr && safeThis->currentFile == file)
+        {
+            safeThis->peaks = std::move(loadedPeaks);
+            safeThis->waveformGeometryValid = false;
+            safeThis->repaint();
+        }
+    });
 }
 
 void WaveformDisplay::setPositionRelative(double position)
 {
     if (currentPosition != position)
     {
+        auto oldX = static_cast<int>(currentPosition * getWidth());
+        auto newX = static_cast<int>(position * getWidth());
         currentPosition = position;
-        repaint();
+
+        if (oldX == newX)
+            return;
+
+       #if SIGNALFORGE_OPENGL
+        // On the GPU layer the playhead is its own part: nothing is painted,
+        // and the frame uploads only its vertices
+        if (auto* layer = OpenGLRenderLayer::findFor(*this); layer != nullptr && waveformGeometryValid)
+        {
+            setPlayheadGeometry(*layer, fileLoaded && peaks != nullptr && peaks->getLengthInSamples() > 0);
+            return;
+        }
+       #endif
+
+        // Only the columns under the old and new playhead need redrawing
+        repaint(oldX - 1, 0, 3, getHeight());
+        repaint(newX - 1, 0, 3, getHeight());
     }
 }
 
-void WaveformDisplay::changeListenerCallback(juce::ChangeBroadcaster* source)
+void WaveformDisplay::setVisibleRange(juce::Range<double> newRangeInSeconds)
 {
-    if (source == &thumbnail)
+    if (visibleRange != newRangeInSeconds)
+    {
+        visibleRange = newRangeInSeconds;
+        waveformGeometryValid = false;
         repaint();
+    }
 }
@@ -1,8 +1,10 @@
 #pragma once
 #include <JuceHeader.h>
+#include "AudioEngine/PeakCache.h"
 
-class WaveformDisplay : public juce::Component,
-                        public juce::ChangeListener
+class OpenGLRenderLayer;
+
+class WaveformDisplay : public juce::Component
 {
 public:
     WaveformDisplay();
@@ -13,13 +15,29 @@ public:
 
     void loadAudioFile(const juce::File& file);
     void setPositionRelative(double position);
-    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+
+    // Zoom: the part of the file shown, in seconds (empty shows all of it)
+    void setVisibleRange(juce::Range<double> newRangeInSeconds);
 
 private:
-    juce::AudioFormatManager formatManager;
-    std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
-    juce::AudioThumbnailCache thumbnailCache;
-    juce::AudioThumbnail thumbnail;
+    // Calls addColumn(x, top, bottom, colour) for each drawn column segment
+    void addPeakColumns(const std::function<void(int, float, float, juce::Colour)>& addColumn);
+
+    // With the GPU layer the waveform is rebuilt only when the peaks, zoom or
+    // size change; the playhead is a part of its own
+    enum GeometryPart { waveformPart, playheadPart };
+    bool waveformGeometryValid = false;
+
+   #if SIGNALFORGE_OPENGL
+    void setPlayheadGeometry(OpenGLRenderLayer& layer, bool hasPeaks);
+   #endif
+
+    // Peaks come from the memory-mapped peak file, so drawing reads a few
+    // peaks per pixel column regardless of file length or zoom
+    std::shared_ptr<PeakFile> peaks;
+    std::vector<PeakFile::Peak> columnPeaks;
+    juce::File currentFile;
+    juce::Range<double> visibleRange;
     
     double currentPosition = 0.0;
     bool fileLoaded = false;
@@ -3,6 +3,8 @@
 
 #include "MainComponent.h"
 #include "Utils/Logger.h"
+#include "AudioEngine/PluginScanner.h"
+#include "AudioEngine/PluginSandbox.h"
 #include "Version.h"
 
 class SignalForgeApplication;
@@ -17,8 +19,29 @@ public:
     const juce::String getApplicationVersion() override    { return SIGNALFORGE_VERSION_STRING; }
     bool moreThanOneInstanceAllowed() override             { return true; }
 
-    void initialise(const juce::String&) override
+    void initialise(const juce::String& commandLine) override
     {
+        // Plugin scan worker: probe one file and exit without any UI
+        if (PluginScanner::isWorkerCommandLine(commandLine))
+        {
+            setApplicationReturnValue(PluginScanner::runWorker(getCommandLineParameterArray()));
+            quit();
+            return;
+        }
+
+        // Sandboxed plugin helper: serve one plugin to the host process
+        if (PluginSandbox::isHelperCommandLine(commandLine))
+        {
+            sandboxHelper = std::make_unique<PluginSandboxHelper>();
+
+            if (!sandboxHelper->initialise(getCommandLineParameterArray()))
+            {
+                setApplicationReturnValue(1);
+                quit();
+            }
+            return;
+        }
+
         SignalForgeLogger::init();
         mainWindow.reset(new MainWindow(getApplicationName()));
     }
@@ -26,6 +49,7 @@ public:
     void shutdown() override
     {
         mainWindow = nullptr;
+        sandboxHelper = nullptr;
         SignalForgeLogger::shutdown();
     }
 
@@ -153,6 +177,7 @@ private:
     };
 
     std::unique_ptr<MainWindow> mainWindow;
+    std::unique_ptr<PluginSandboxHelper> sandboxHelper;
     juce::ApplicationCommandManager commandManager;
 };
 
@@ -2,12 +2,22 @@
 #include "../Core/API/APIManager.h"
 #include "../Core/Auth/ProtocolHandler.h"
 #include "GUI/SimpleDAW.h"
+#include "GUI/LevelMeter.h"
+#include "GUI/RefreshScheduler.h"
 
 MainComponent::MainComponent()
 {
     // Create the main DAW interface
     signalForgeDAW = std::make_unique<SimpleDAW>();
     addAndMakeVisible(*signalForgeDAW);
+
+    masterMeter = std::make_unique<LevelMeter>(audioEngine.getMeter());
+    addAndMakeVisible(*masterMeter);
+
+   #if SIGNALFORGE_OPENGL
+    // Everything below this component is drawn through the GPU
+    renderLayer.attachTo(*this);
+   #endif
     
     // Initialize API
     auto& apiManager = APIManager::getInstance();
@@ -23,31 +33,42 @@ MainComponent::MainComponent()
     ProtocolHandler::registerProtocol();
     
     setSize(1400, 900);
-    startTimer(100);
+
+    // Meters, playhead and clock are polled once per display frame
+    RefreshScheduler::getInstance().attachTo(*this);
 }
 
 MainComponent::~MainComponent()
 {
-    stopTimer();
+    RefreshScheduler::getInstance().detach();
+
+   #if SIGNALFORGE_OPENGL
+    // Meters and waveforms unregister while the context is still attached
+    masterMeter = nullptr;
+    signalForgeDAW = nullptr;
+    renderLayer.detach();
+   #endif
 }
 
 void MainComponent::paint(juce::Graphics& g)
 {
     // The SignalForgeDAW component handles all painting
+   #if SIGNALFORGE_OPENGL
+    renderLayer.excludeClientAreas(g, *this);
+   #endif
     g.fillAll(juce::Colour(0xff2d2d2d));
 }
 
 void MainComponent::resized()
 {
-    // Fill entire window with the DAW interface
-    if (signalForgeDAW)
-        signalForgeDAW->setBounds(getLocalBounds());
-}
+    auto area = getLocalBounds();
 
-void MainComponent::timerCallback()
-{
-    // Update any global state if needed
-    repaint();
+    if (masterMeter)
+        masterMeter->setBounds(area.removeFromRight(24));
+
+    // Fill the rest of the window with the DAW interface
+    if (signalForgeDAW)
+        signalForgeDAW->setBounds(area);
 }
 
 void MainComponent::handleAuthStateChanged(bool authenticated)
@@ -2,12 +2,13 @@
 
 #include <JuceHeader.h>
 #include "AudioEngine/AudioEngine.h"
+#include "GUI/OpenGLRenderLayer.h"
 
 // Forward declarations
 class SimpleDAW;
+class LevelMeter;
 
-class MainComponent final : public juce::Component,
-                            public juce::Timer
+class MainComponent final : public juce::Component
 {
 public:
     MainComponent();
@@ -15,7 +16,6 @@ public:
 
     void paint(juce::Graphics& g) override;
     void resized() override;
-    void timerCallback() override;
 
 private:
     // API callbacks
@@ -26,6 +26,11 @@ private:
     
     // Main DAW Interface
     std::unique_ptr<SimpleDAW> signalForgeDAW;
+    std::unique_ptr<LevelMeter> masterMeter;
+
+   #if SIGNALFORGE_OPENGL
+    OpenGLRenderLayer renderLayer;
+   #endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
\ No newline at end of file